@@ -6,7 +6,99 @@
 #ifndef U3_PROGS_H
 #define U3_PROGS_H 1
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* flags for u3_rev(), by default every byte is reversed
+ */
+
+#define U3_REV_UTF8      0x01  /* keep utf-8 code points intact, like -u */
+#define U3_REV_GRAPHEME  0x02  /* keep grapheme clusters intact, like -g */
+
+/* buffer passed to u3_seq_fill() must have room for at least that
+ * many bytes, which is the longest number with sign and new line
+ */
+
+#define U3_SEQ_NUM_MAX   21
+
+/* size of seq iterator state, it is big enough, so that iterator never
+ * allocates any memory
+ */
+
+#define U3_SEQ_SIZE      (72 * 1024)
+
+/* iterator for u3_seq_init() and u3_seq_fill(), fields are private,
+ * only size of the object is public, so it can live on stack or be
+ * embedded in caller's structures
+ */
+
+struct u3_seq
+{
+    union
+    {
+        long double    align;              /* alignment for any field */
+        void          *ptr;                /* alignment for pointers */
+        unsigned char  data[U3_SEQ_SIZE];  /* private state */
+    } priv;
+};
+
+/* sizes of timer wheel and of single timer, big enough so that timers
+ * never allocate any memory
+ */
+
+#define U3_TIMERS_SIZE   4096
+#define U3_TIMER_SIZE    64
+
+/* timer wheel for u3_timers_*() functions, it keeps any number of
+ * pending timers, and exposes single file descriptor to poll, fields
+ * are private
+ */
+
+struct u3_timers
+{
+    union
+    {
+        long double    align;              /* alignment for any field */
+        void          *ptr;                /* alignment for pointers */
+        unsigned char  data[U3_TIMERS_SIZE]; /* private state */
+    } priv;
+};
+
+/* single timer, it's owned by caller and linked into wheel while it's
+ * pending, fields are private. It must be initialized with
+ * u3_timer_init() before it's added for the first time.
+ */
+
+struct u3_timer
+{
+    union
+    {
+        long double    align;              /* alignment for any field */
+        void          *ptr;                /* alignment for pointers */
+        unsigned char  data[U3_TIMER_SIZE]; /* private state */
+    } priv;
+};
+
+/* called from u3_timers_run() when 'timer' expires, with 'arg' passed
+ * to u3_timer_add()
+ */
+
+typedef void (*u3_timer_fn)(struct u3_timer *timer, void *arg);
+
 int u3_rev_main(int argc, char *argv[]);
+int u3_rev(const void *in, size_t len, void *out, int flags);
 int u3_seq_main(int argc, char *argv[]);
+int u3_seq_init(struct u3_seq *seq, long first, long inc, long last);
+ssize_t u3_seq_fill(struct u3_seq *seq, void *buf, size_t size);
+int u3_sleep_parse(const char *duration, struct timespec *ts);
+int u3_timers_init(struct u3_timers *timers);
+int u3_timers_fd(struct u3_timers *timers);
+int u3_timers_run(struct u3_timers *timers);
+void u3_timers_cleanup(struct u3_timers *timers);
+void u3_timer_init(struct u3_timer *timer);
+int u3_timer_add(struct u3_timers *timers, struct u3_timer *timer,
+    const struct timespec *delay, u3_timer_fn fn, void *arg);
+int u3_timer_cancel(struct u3_timers *timers, struct u3_timer *timer);
 
 #endif /* U3_PROGS_H */
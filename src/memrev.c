@@ -0,0 +1,499 @@
+/* ==========================================================================
+    Licensed under BSD 2clause license See LICENSE file for more information
+    Author: Michał Łyszczek <michal.lyszczek@bofc.pl>
+   ==========================================================================
+
+    Reverses order of bytes in memory. There are couple of kernels that do
+    the job, from plain byte-by-byte loop to AVX2, best one supported by
+    the cpu is chosen at runtime, on first call to u3u_memrev().
+
+    All kernels work from both ends of the buffer towards the middle and
+    load data before storing it, so 'dst' may be exactly the same pointer
+    as 'src' (in place reverse), otherwise buffers must not overlap.
+
+    There is also u3u_memascii() here, which quickly checks whether data
+    contains only 7bit ascii characters, so callers can know when it is
+    safe to reverse bytes instead of multibyte characters.
+   ==========================================================================
+                   _               __            __
+                  (_)____   _____ / /__  __ ____/ /___   _____
+                 / // __ \ / ___// // / / // __  // _ \ / ___/
+                / // / / // /__ / // /_/ // /_/ //  __/(__  )
+               /_//_/ /_/ \___//_/ \__,_/ \__,_/ \___//____/
+
+   ========================================================================== */
+
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "memrev.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define MEMREV_X86 1
+#   define MEMREV_TARGET(t) __attribute__((target(t)))
+#   include <immintrin.h>
+#else
+#   define MEMREV_X86 0
+#endif
+
+/* chosen kernel is stored in a pointer that threads may read and write
+ * concurrently. Only the pointer itself is shared, nothing is published
+ * through it, so relaxed atomic access is enough.
+ */
+
+#if defined(__GNUC__)
+#   define MEMREV_LOAD(p) __atomic_load_n(&(p), __ATOMIC_RELAXED)
+#   define MEMREV_STORE(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELAXED)
+#else
+#   define MEMREV_LOAD(p) (p)
+#   define MEMREV_STORE(p, v) ((p) = (v))
+#endif
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ==========================================================================
+                                   _                __
+                     ____   _____ (_)_   __ ____ _ / /_ ___
+                    / __ \ / ___// /| | / // __ `// __// _ \
+                   / /_/ // /   / / | |/ // /_/ // /_ /  __/
+                  / .___//_/   /_/  |___/ \__,_/ \__/ \___/
+                 /_/
+   ========================================================================== */
+
+
+/* ==========================================================================
+    Reference kernel, swaps byte by byte. Every other kernel uses it to
+    reverse what is left in the middle of the buffer.
+   ========================================================================== */
+
+
+static void memrev_byte
+(
+    void                 *dst,  /* reversed data will be stored here */
+    const void           *src,  /* data to reverse */
+    size_t                n     /* number of bytes to reverse */
+)
+{
+    unsigned char        *d;    /* dst as bytes */
+    const unsigned char  *s;    /* src as bytes */
+    unsigned char         a;    /* byte from the beginning of src */
+    unsigned char         b;    /* byte from the end of src */
+    size_t                lo;   /* index from the beginning */
+    size_t                hi;   /* index one past the byte from the end */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = dst;
+    s = src;
+
+    for (lo = 0, hi = n; hi - lo >= 2; ++lo, --hi)
+    {
+        a = s[lo];
+        b = s[hi - 1];
+        d[lo] = b;
+        d[hi - 1] = a;
+    }
+
+    if (lo != hi)
+    {
+        /* odd number of bytes, middle one stays where it is
+         */
+
+        d[lo] = s[lo];
+    }
+}
+
+
+/* ==========================================================================
+    Reverses bytes in 64bit word
+   ========================================================================== */
+
+
+static uint64_t memrev_bswap64
+(
+    uint64_t  v  /* word to swap */
+)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap64(v);
+#else
+    v = ((v & 0x00ff00ff00ff00ffull) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffull);
+    v = ((v & 0x0000ffff0000ffffull) << 16) |
+        ((v >> 16) & 0x0000ffff0000ffffull);
+    return (v << 32) | (v >> 32);
+#endif
+}
+
+
+/* ==========================================================================
+    Portable kernel, reverses 8 bytes at a time. It does not matter what
+    endianness cpu is, reversing bytes in loaded word always reverses them
+    in memory too. memcpy() is used, so it works on unaligned data on cpus
+    that don't like unaligned access, compilers turn it into single load
+    anyway where it's possible.
+   ========================================================================== */
+
+
+static void memrev_word
+(
+    void                 *dst,  /* reversed data will be stored here */
+    const void           *src,  /* data to reverse */
+    size_t                n     /* number of bytes to reverse */
+)
+{
+    unsigned char        *d;    /* dst as bytes */
+    const unsigned char  *s;    /* src as bytes */
+    uint64_t              a;    /* word from the beginning of src */
+    uint64_t              b;    /* word from the end of src */
+    size_t                lo;   /* index from the beginning */
+    size_t                hi;   /* index one past the word from the end */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = dst;
+    s = src;
+
+    for (lo = 0, hi = n; hi - lo >= 2 * sizeof(a);
+        lo += sizeof(a), hi -= sizeof(a))
+    {
+        memcpy(&a, s + lo, sizeof(a));
+        memcpy(&b, s + hi - sizeof(b), sizeof(b));
+        a = memrev_bswap64(a);
+        b = memrev_bswap64(b);
+        memcpy(d + lo, &b, sizeof(b));
+        memcpy(d + hi - sizeof(a), &a, sizeof(a));
+    }
+
+    memrev_byte(d + lo, s + lo, hi - lo);
+}
+
+
+#if MEMREV_X86
+
+/* ==========================================================================
+    SSE2 has no byte shuffle, so 16 bytes are reversed in 3 steps: swap
+    bytes in every 16bit word, reverse words in both 64bit halves and at
+    the end swap the halves.
+   ========================================================================== */
+
+
+MEMREV_TARGET("sse2")
+static void memrev_sse2
+(
+    void                 *dst,  /* reversed data will be stored here */
+    const void           *src,  /* data to reverse */
+    size_t                n     /* number of bytes to reverse */
+)
+{
+    unsigned char        *d;    /* dst as bytes */
+    const unsigned char  *s;    /* src as bytes */
+    __m128i               v[2]; /* vector from beginning and end of src */
+    size_t                lo;   /* index from the beginning */
+    size_t                hi;   /* index one past the vector from the end */
+    int                   i;    /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = dst;
+    s = src;
+
+    for (lo = 0, hi = n; hi - lo >= 2 * 16; lo += 16, hi -= 16)
+    {
+        v[0] = _mm_loadu_si128((const __m128i *)(s + lo));
+        v[1] = _mm_loadu_si128((const __m128i *)(s + hi - 16));
+
+        for (i = 0; i != 2; ++i)
+        {
+            v[i] = _mm_or_si128(_mm_slli_epi16(v[i], 8),
+                _mm_srli_epi16(v[i], 8));
+            v[i] = _mm_shufflelo_epi16(v[i], _MM_SHUFFLE(0, 1, 2, 3));
+            v[i] = _mm_shufflehi_epi16(v[i], _MM_SHUFFLE(0, 1, 2, 3));
+            v[i] = _mm_shuffle_epi32(v[i], _MM_SHUFFLE(1, 0, 3, 2));
+        }
+
+        _mm_storeu_si128((__m128i *)(d + lo), v[1]);
+        _mm_storeu_si128((__m128i *)(d + hi - 16), v[0]);
+    }
+
+    memrev_word(d + lo, s + lo, hi - lo);
+}
+
+
+/* ==========================================================================
+    SSSE3 kernel, pshufb reverses 16 bytes with single instruction
+   ========================================================================== */
+
+
+MEMREV_TARGET("ssse3")
+static void memrev_ssse3
+(
+    void                 *dst,  /* reversed data will be stored here */
+    const void           *src,  /* data to reverse */
+    size_t                n     /* number of bytes to reverse */
+)
+{
+    unsigned char        *d;    /* dst as bytes */
+    const unsigned char  *s;    /* src as bytes */
+    __m128i               mask; /* pshufb mask that reverses bytes */
+    __m128i               a;    /* vector from the beginning of src */
+    __m128i               b;    /* vector from the end of src */
+    size_t                lo;   /* index from the beginning */
+    size_t                hi;   /* index one past the vector from the end */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = dst;
+    s = src;
+    mask = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (lo = 0, hi = n; hi - lo >= 2 * 16; lo += 16, hi -= 16)
+    {
+        a = _mm_loadu_si128((const __m128i *)(s + lo));
+        b = _mm_loadu_si128((const __m128i *)(s + hi - 16));
+        a = _mm_shuffle_epi8(a, mask);
+        b = _mm_shuffle_epi8(b, mask);
+        _mm_storeu_si128((__m128i *)(d + lo), b);
+        _mm_storeu_si128((__m128i *)(d + hi - 16), a);
+    }
+
+    memrev_word(d + lo, s + lo, hi - lo);
+}
+
+
+/* ==========================================================================
+    AVX2 kernel, vpshufb works only within 128bit lanes, so after bytes
+    are reversed in each lane, lanes are swapped with vpermq.
+   ========================================================================== */
+
+
+MEMREV_TARGET("avx2")
+static void memrev_avx2
+(
+    void                 *dst,  /* reversed data will be stored here */
+    const void           *src,  /* data to reverse */
+    size_t                n     /* number of bytes to reverse */
+)
+{
+    unsigned char        *d;    /* dst as bytes */
+    const unsigned char  *s;    /* src as bytes */
+    __m256i               mask; /* vpshufb mask that reverses bytes */
+    __m256i               a;    /* vector from the beginning of src */
+    __m256i               b;    /* vector from the end of src */
+    size_t                lo;   /* index from the beginning */
+    size_t                hi;   /* index one past the vector from the end */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = dst;
+    s = src;
+    mask = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (lo = 0, hi = n; hi - lo >= 2 * 32; lo += 32, hi -= 32)
+    {
+        a = _mm256_loadu_si256((const __m256i *)(s + lo));
+        b = _mm256_loadu_si256((const __m256i *)(s + hi - 32));
+        a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, mask), 0x4e);
+        b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, mask), 0x4e);
+        _mm256_storeu_si256((__m256i *)(d + lo), b);
+        _mm256_storeu_si256((__m256i *)(d + hi - 32), a);
+    }
+
+    memrev_word(d + lo, s + lo, hi - lo);
+}
+
+
+/* ==========================================================================
+    Functions that check whether cpu supports given kernel
+   ========================================================================== */
+
+
+static int memrev_has_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int memrev_has_ssse3(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+static int memrev_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* MEMREV_X86 */
+
+
+/* ==========================================================================
+    Portable kernels work everywhere
+   ========================================================================== */
+
+
+static int memrev_has_always(void)
+{
+    return 1;
+}
+
+
+/* ==========================================================================
+    Picks best kernel supported by cpu, and replaces itself with it, so
+    next calls to u3u_memrev() go straight to chosen kernel. Threads that
+    call it at the same time all pick the same kernel, so it does not
+    matter which of them stores it last.
+   ========================================================================== */
+
+
+static void memrev_resolve(void *dst, const void *src, size_t n);
+static u3u_memrev_fn memrev_impl = memrev_resolve;
+
+static void memrev_resolve
+(
+    void                            *dst,  /* reversed data goes here */
+    const void                      *src,  /* data to reverse */
+    size_t                           n     /* number of bytes to reverse */
+)
+{
+    const struct u3u_memrev_kernel  *k;    /* kernel to check */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* kernels are sorted from the fastest one, and the last one
+     * is always supported
+     */
+
+    for (k = u3u_memrev_kernels; k->supported() == 0; ++k);
+
+    MEMREV_STORE(memrev_impl, k->fn);
+    k->fn(dst, src, n);
+}
+
+
+/* ==========================================================================
+                       __     __ _          ____
+        ____   __  __ / /_   / /(_)_____   / __/__  __ ____   _____ _____
+       / __ \ / / / // __ \ / // // ___/  / /_ / / / // __ \ / ___// ___/
+      / /_/ // /_/ // /_/ // // // /__   / __// /_/ // / / // /__ (__  )
+     / .___/ \__,_//_.___//_//_/ \___/  /_/   \__,_//_/ /_/ \___//____/
+    /_/
+   ========================================================================== */
+
+
+/* ==========================================================================
+    List of all kernels, from the fastest one to the slowest. It is
+    terminated with element with NULL name.
+   ========================================================================== */
+
+
+const struct u3u_memrev_kernel u3u_memrev_kernels[] =
+{
+#if MEMREV_X86
+    { "avx2",  memrev_avx2,  memrev_has_avx2 },
+    { "ssse3", memrev_ssse3, memrev_has_ssse3 },
+    { "sse2",  memrev_sse2,  memrev_has_sse2 },
+#endif
+    { "word",  memrev_word,  memrev_has_always },
+    { "byte",  memrev_byte,  memrev_has_always },
+    { NULL,    NULL,         NULL }
+};
+
+
+/* ==========================================================================
+    Stores 'n' bytes of 'src' in reversed order in 'dst'. 'dst' and 'src'
+    may point to the same memory, but they cannot partially overlap.
+   ========================================================================== */
+
+
+void u3u_memrev
+(
+    void        *dst,  /* reversed data will be stored here */
+    const void  *src,  /* data to reverse */
+    size_t       n     /* number of bytes to reverse */
+)
+{
+    MEMREV_LOAD(memrev_impl)(dst, src, n);
+}
+
+
+/* ==========================================================================
+    Checks if 'n' bytes of 'p' are all 7bit ascii characters. Returns 1 if
+    so, or 0 when there is at least one byte with most significant bit set.
+    On x86 it checks 64 bytes per round with SSE2 (which every x86_64 cpu
+    has), elsewhere it checks 8 bytes at a time.
+   ========================================================================== */
+
+
+int u3u_memascii
+(
+    const void           *p,    /* memory to check */
+    size_t                n     /* number of bytes to check */
+)
+{
+    const unsigned char  *s;    /* p as bytes */
+    uint64_t              w;    /* word loaded from s */
+    size_t                i;    /* index in s */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    s = p;
+    i = 0;
+
+#if MEMREV_X86 && defined(__SSE2__)
+
+    for (; n - i >= 64; i += 64)
+    {
+        __m128i  v;  /* all four vectors or'ed together */
+        /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+        v = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)(s + i)),
+                _mm_loadu_si128((const __m128i *)(s + i + 16))),
+            _mm_or_si128(_mm_loadu_si128((const __m128i *)(s + i + 32)),
+                _mm_loadu_si128((const __m128i *)(s + i + 48))));
+
+        if (_mm_movemask_epi8(v))
+        {
+            return 0;
+        }
+    }
+
+#endif /* MEMREV_X86 && __SSE2__ */
+
+    for (; n - i >= sizeof(w); i += sizeof(w))
+    {
+        memcpy(&w, s + i, sizeof(w));
+
+        if (w & 0x8080808080808080ull)
+        {
+            return 0;
+        }
+    }
+
+    for (; i != n; ++i)
+    {
+        if (s[i] & 0x80)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,25 @@
+/* ==========================================================================
+    Licensed under BSD 2clause license See LICENSE file for more information
+    Author: Michał Łyszczek <michal.lyszczek@bofc.pl>
+   ========================================================================== */
+
+#ifndef U3_MEMREV_H
+#define U3_MEMREV_H 1
+
+#include <stddef.h>
+
+typedef void (*u3u_memrev_fn)(void *dst, const void *src, size_t n);
+
+struct u3u_memrev_kernel
+{
+    const char     *name;
+    u3u_memrev_fn   fn;
+    int           (*supported)(void);
+};
+
+extern const struct u3u_memrev_kernel u3u_memrev_kernels[];
+
+void u3u_memrev(void *dst, const void *src, size_t n);
+int u3u_memascii(const void *p, size_t n);
+
+#endif /* U3_MEMREV_H */
@@ -21,37 +21,3086 @@
 #   include "config.h"
 #endif
 
+#if HAVE_LINUX_LIMITS_H
+#   include <linux/limits.h>
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if HAVE_MMAP
+#   include <sys/mman.h>
+#endif
+
+/* gather output keeps a ring of page aligned blocks, which are mapped
+ * anonymous memory, so it needs mmap() too
+ */
+
+#if HAVE_MMAP
+#   define REV_GATHER 1
+#   include <sys/uio.h>
+#else
+#   define REV_GATHER 0
+#endif
+
+/* multiple threads work on mapped file, and each of them needs its own
+ * buffer for reversed data
+ */
+
+#if HAVE_MMAP && ENABLE_THREADS && ENABLE_MALLOC
+#   define REV_JOBS 1
+#   include <pthread.h>
+#else
+#   define REV_JOBS 0
+#endif
+
+#include "memrev.h"
+#include "u3.h"
+#include "u3defs.h"
+#include "utils.h"
+
+
+/* ==========================================================================
+                          __
+                         / /_ __  __ ____   ___   _____
+                        / __// / / // __ \ / _ \ / ___/
+                       / /_ / /_/ // /_/ //  __/(__  )
+                       \__/ \__, // .___/ \___//____/
+                           /____//_/
+   ========================================================================== */
+
+
+/* what is considered to be a single character when reversing line
+ */
+
+enum rev_mode
+{
+    REV_MODE_BYTE,       /* every byte is reversed, default */
+    REV_MODE_CODEPOINT,  /* utf-8 code points are kept intact */
+    REV_MODE_GRAPHEME    /* code points plus combining marks are kept */
+};
+
+
+/* in utf-8 modes, that many bytes at the start of block are left for
+ * the next block, when line is reversed out of core
+ */
+
+#define REV_OOC_MARGIN 64
+
+
+#if REV_GATHER
+
+/* number of blocks in gather ring, half of them is sent in one go
+ */
+
+#define REV_GATHER_BLOCKS 16
+
+
+/* output that bypasses stdio, filled blocks are queued and sent with
+ * single writev() call, or with vmsplice() when stdout is a pipe, so
+ * pages are moved into the pipe without copying them. Spliced pages
+ * are gifted to the pipe, and fresh ones are mapped in their place.
+ */
+
+struct rev_gather
+{
+    int            fd;          /* file descriptor to write data to */
+    int            pipe;        /* fd is a pipe, use vmsplice() */
+    char          *ring;        /* page aligned blocks, mapped memory */
+    size_t         page;        /* size of memory page */
+    size_t         bsize;       /* size of single block in ring */
+    size_t         next;        /* index of the next block to fill */
+    size_t         niov;        /* number of queued blocks in iov */
+    struct iovec   iov[REV_GATHER_BLOCKS / 2];   /* queued blocks */
+    size_t         blk[REV_GATHER_BLOCKS / 2];   /* ring index of iov */
+};
+
+#endif /* REV_GATHER */
+
+
+/* output buffer, reversed lines are gathered here and then sent to
+ * stdout in big chunks instead of one libc call per line
+ */
+
+struct rev_out
+{
+    char          *buf;     /* buffer with reversed data */
+    size_t         size;    /* size of the buf */
+    size_t         pos;     /* number of bytes stored in buf */
+    enum rev_mode  mode;    /* how to reverse lines */
+
+#if REV_GATHER
+    struct rev_gather *gather;  /* NULL means output goes through stdio */
+#endif
+};
+
+
+/* header of in place journal, it is followed by original data of the
+ * window that is being reversed
+ */
+
+#define REV_JOURNAL_MAGIC "u3revj1"
+#define REV_JOURNAL_SUM 14695981039346656037ULL
+
+struct rev_journal
+{
+    char      magic[8];  /* REV_JOURNAL_MAGIC */
+    uint64_t  off;       /* file before this offset is already reversed */
+    uint64_t  len;       /* length of saved window at off, 0 if none */
+    uint64_t  sum;       /* checksum of saved window */
+    uint32_t  mode;      /* enum rev_mode file is reversed with */
+    uint32_t  reserved;  /* padding, always 0 */
+};
+
+
+#if REV_JOBS
+
+/* single chunk of input file, that is reversed by one of the threads
+ */
+
+struct rev_chunk
+{
+    const char      *data;  /* chunk of input to reverse */
+    size_t           len;   /* length of the chunk */
+    struct rev_out   out;   /* reversed chunk */
+    int              giant; /* single line too long for chunk buffer */
+    int              done;  /* chunk is reversed and can be written */
+};
+
+
+/* pool of threads reversing chunks of file, chunks are queued and
+ * written in order, and there are never more than 'nchunks' of them
+ * in memory
+ */
+
+struct rev_pool
+{
+    pthread_mutex_t    lock;     /* protects everything below */
+    pthread_cond_t     work;     /* signaled when chunk is queued */
+    pthread_cond_t     done;     /* signaled when chunk is reversed */
+    struct rev_chunk  *chunks;   /* ring of chunks in flight */
+    size_t             nchunks;  /* number of elements in chunks */
+    size_t             queued;   /* number of chunks queued so far */
+    size_t             taken;    /* number of chunks taken by threads */
+    int                stop;     /* no more chunks, threads should exit */
+};
+
+#endif /* REV_JOBS */
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ========================================================================== */
+
+
+static void print_help(void)
+{
+    fprintf(stderr,
+        "usage: rev [ -v | -h | <file> ]\n"
+        "       rev [ -u | -g ] [ -z ] [ -j <jobs> ] [ <file> ... ]\n"
+        "       rev -i [ -u | -g ] <file> ...\n"
+        "\n"
+        "  -h       print this help and exit\n"
+        "  -v       print version information and exit\n"
+        "  -u       input is utf-8, reverse characters instead of bytes\n"
+        "  -g       like -u, but keep combining marks with their base\n"
+        "  -j       number of threads to reverse <file> with\n"
+        "  -z       write with writev() or vmsplice(), bypassing stdio\n"
+        "  -i       reverse <file> in place, if interrupted run it again,\n"
+        "           lines are saved to <file>.rev-journal first, so twice\n"
+        "           the size of <file> is written\n"
+        "  <file>   files to reverse one after another, '-' means stdin\n"
+        "\n"
+        "if <file> is passed, program revers data in given file\n"
+        "else it uses piped data from another program\n"
+        "else data is read from stdin\n");
+}
+
+
+#if REV_GATHER
+
+/* ==========================================================================
+    Writes all 'n' elements of 'iov' to gather output with as few writev()
+    calls as possible. Data is copied by the kernel, so buffers can be
+    reused as soon as this returns. 'iov' is modified on partial writes.
+   ========================================================================== */
+
+
+static int rev_gather_writev
+(
+    struct rev_gather  *g,     /* gather output to write to */
+    struct iovec       *iov,   /* buffers to write */
+    size_t              n      /* number of elements in iov */
+)
+{
+    ssize_t             w;     /* return value from writev() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while (n)
+    {
+        w = writev(g->fd, iov, n);
+
+        if (w == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("e/writev()");
+            return -1;
+        }
+
+        /* skip buffers that were fully written, and move start of
+         * the one that was written partially
+         */
+
+        while (n && (size_t)w >= iov->iov_len)
+        {
+            w -= iov->iov_len;
+            ++iov;
+            --n;
+        }
+
+        if (n)
+        {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Sends all queued blocks of gather output. When output is a pipe, pages
+    of the blocks are spliced into it. Pipe reader may hold on to them for
+    as long as it wants, or even splice and tee them further, so we never
+    write to these pages again, and fresh ones are mapped in place of
+    every sent block instead.
+   ========================================================================== */
+
+
+static int rev_gather_submit
+(
+    struct rev_gather  *g      /* gather output to send blocks of */
+)
+{
+    size_t              i;     /* index of first not fully sent block */
+    size_t              n;     /* number of queued blocks */
+    ssize_t             w;     /* return value from vmsplice() */
+    unsigned int        flags; /* flags for vmsplice() */
+    void               *p;     /* fresh pages of sent block */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    n = g->niov;
+    g->niov = 0;
+
+    if (g->pipe == 0)
+    {
+        return rev_gather_writev(g, g->iov, n);
+    }
+
+#if HAVE_VMSPLICE
+
+    /* pages can be gifted only when they are spliced whole, only last
+     * block of output is usually shorter than that
+     */
+
+    flags = SPLICE_F_GIFT;
+
+    for (i = 0; i != n; ++i)
+    {
+        if (g->iov[i].iov_len % g->page)
+        {
+            flags = 0;
+        }
+    }
+
+    i = 0;
+
+    while (i != n)
+    {
+        w = vmsplice(g->fd, g->iov + i, n - i, flags);
+
+        if (w == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("e/vmsplice()");
+            return -1;
+        }
+
+        while (i != n && (size_t)w >= g->iov[i].iov_len)
+        {
+            w -= g->iov[i].iov_len;
+            ++i;
+        }
+
+        if (i != n)
+        {
+            /* rest of the block is no longer page aligned
+             */
+
+            g->iov[i].iov_base = (char *)g->iov[i].iov_base + w;
+            g->iov[i].iov_len -= w;
+            flags = 0;
+        }
+    }
+
+    for (i = 0; i != n; ++i)
+    {
+        p = mmap(g->ring + g->blk[i] * g->bsize, g->bsize,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+            -1, 0);
+
+        if (p == MAP_FAILED)
+        {
+            perror("e/mmap()");
+            return -1;
+        }
+    }
+
+#else /* HAVE_VMSPLICE */
+
+    (void)i;
+    (void)w;
+    (void)flags;
+    (void)p;
+
+#endif /* HAVE_VMSPLICE */
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Makes next block of the ring current output buffer of 'out'. Blocks
+    that were sent are already backed by fresh pages, so any block can be
+    reused right away.
+   ========================================================================== */
+
+
+static void rev_gather_next
+(
+    struct rev_out     *out    /* output to switch block of */
+)
+{
+    struct rev_gather  *g;     /* gather output of out */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    g = out->gather;
+    out->buf = g->ring + g->next * g->bsize;
+    out->size = g->bsize;
+    out->pos = 0;
+    g->next = (g->next + 1) % REV_GATHER_BLOCKS;
+}
+
+
+/* ==========================================================================
+    Prepares gather output writing to 'fd' and attaches it to 'out'. If
+    fd is a pipe, we try to make it big enough to hold half of the ring,
+    so reader has plenty of data while we fill the other half.
+   ========================================================================== */
+
+
+static int rev_gather_init
+(
+    struct rev_gather  *g,     /* gather output to initialize */
+    struct rev_out     *out,   /* output to attach g to */
+    int                 fd     /* file descriptor to write data to */
+)
+{
+    struct stat         st;    /* information about fd */
+    long                page;  /* size of memory page */
+    int                 psize; /* size of the pipe */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    memset(g, 0, sizeof(*g));
+    page = sysconf(_SC_PAGESIZE);
+    page = page > 0 ? page : 4096;
+    g->fd = fd;
+    g->page = page;
+    g->bsize = (U3_REV_BUF_SIZE + page - 1) / page * page;
+
+#if HAVE_VMSPLICE
+
+    if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode))
+    {
+        g->pipe = 1;
+
+#   if defined(F_GETPIPE_SZ) && defined(F_SETPIPE_SZ)
+
+        psize = fcntl(fd, F_GETPIPE_SZ);
+
+        if (psize > 0 && (size_t)psize < g->bsize * REV_GATHER_BLOCKS / 2)
+        {
+            /* it's fine if this fails, it's only an optimization
+             */
+
+            fcntl(fd, F_SETPIPE_SZ, (int)(g->bsize * REV_GATHER_BLOCKS / 2));
+        }
+
+#   endif
+    }
+
+#endif /* HAVE_VMSPLICE */
+
+    (void)st;
+    (void)psize;
+
+    g->ring = mmap(NULL, g->bsize * REV_GATHER_BLOCKS,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (g->ring == MAP_FAILED)
+    {
+        perror("e/mmap()");
+        return -1;
+    }
+
+    out->gather = g;
+    rev_gather_next(out);
+    return 0;
+}
+
+#endif /* REV_GATHER */
+
+
+/* ==========================================================================
+    Writes all data gathered in 'out' buffer to stdout. With gather output
+    buffer is only queued and 'out' gets next free block of the ring.
+   ========================================================================== */
+
+
+static int rev_flush
+(
+    struct rev_out     *out    /* output buffer to flush */
+)
+{
+#if REV_GATHER
+    struct rev_gather  *g;     /* gather output of out */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#endif
+
+
+    if (out->pos == 0)
+    {
+        return 0;
+    }
+
+#if REV_GATHER
+
+    if (out->gather)
+    {
+        g = out->gather;
+        g->iov[g->niov].iov_base = out->buf;
+        g->iov[g->niov].iov_len = out->pos;
+        g->blk[g->niov] = (out->buf - g->ring) / g->bsize;
+
+        if (++g->niov == REV_GATHER_BLOCKS / 2)
+        {
+            if (rev_gather_submit(g) != 0)
+            {
+                return -1;
+            }
+        }
+
+        rev_gather_next(out);
+        return 0;
+    }
+
+#endif /* REV_GATHER */
+
+    if (fwrite(out->buf, 1, out->pos, stdout) != out->pos)
+    {
+        perror("e/fwrite()");
+        return -1;
+    }
+
+    out->pos = 0;
+    return 0;
+}
+
+
+/* ==========================================================================
+    Like rev_flush() but also makes sure everything queued has been sent.
+   ========================================================================== */
+
+
+static int rev_sync
+(
+    struct rev_out  *out   /* output buffer to sync */
+)
+{
+    if (rev_flush(out) != 0)
+    {
+        return -1;
+    }
+
+#if REV_GATHER
+
+    if (out->gather)
+    {
+        return rev_gather_submit(out->gather);
+    }
+
+#endif /* REV_GATHER */
+
+    return 0;
+}
+
+
+#if REV_JOBS
+
+/* ==========================================================================
+    Writes 'len' bytes of 'data' to the same place 'out' writes to, after
+    everything that is buffered in 'out'.
+   ========================================================================== */
+
+
+static int rev_write
+(
+    struct rev_out  *out,  /* output to write through */
+    const char      *data, /* data to write */
+    size_t           len   /* length of the data */
+)
+{
+#if REV_GATHER
+    struct iovec     iov;  /* data as iovec for writev() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#endif
+
+
+    /* giant line reversed by rev_lines() may still sit in 'out'
+     */
+
+    if (rev_sync(out) != 0)
+    {
+        return -1;
+    }
+
+#if REV_GATHER
+
+    if (out->gather)
+    {
+        /* data is not ours to keep, so it's copied with writev()
+         * even when output is a pipe
+         */
+
+        iov.iov_base = (void *)data;
+        iov.iov_len = len;
+        return rev_gather_writev(out->gather, &iov, 1);
+    }
+
+#endif /* REV_GATHER */
+
+    if (fwrite(data, 1, len, stdout) != len)
+    {
+        perror("e/fwrite()");
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif /* REV_JOBS */
+
+
+/* ==========================================================================
+    Stores 'len' bytes of 'line' in reversed order in 'out' buffer. If 'nl'
+    is set, new line character is added after reversed data. When line is
+    bigger than output buffer, it is reversed in pieces, starting from the
+    end of the line, so there is no limit on how long line can be.
+   ========================================================================== */
+
+
+static int rev_line_bytes
+(
+    struct rev_out  *out,  /* output buffer to store reversed line in */
+    const char      *line, /* line to reverse, without new line */
+    size_t           len,  /* length of the line */
+    int              nl    /* add new line after reversed line or not */
+)
+{
+    size_t           n;    /* number of bytes to reverse in one go */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while (len)
+    {
+        if (out->pos == out->size)
+        {
+            if (rev_flush(out) != 0)
+            {
+                return -1;
+            }
+        }
+
+        n = out->size - out->pos;
+        n = n < len ? n : len;
+
+        /* take last 'n' bytes of what is left of the line, they
+         * will be first bytes of the reversed line
+         */
+
+        len -= n;
+        u3u_memrev(out->buf + out->pos, line + len, n);
+        out->pos += n;
+    }
+
+    if (nl)
+    {
+        if (out->pos == out->size)
+        {
+            if (rev_flush(out) != 0)
+            {
+                return -1;
+            }
+        }
+
+        out->buf[out->pos++] = '\n';
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Copies 'len' bytes of 'data' into 'out' buffer without reversing them.
+   ========================================================================== */
+
+
+static int rev_copy
+(
+    struct rev_out  *out,  /* output buffer to copy data to */
+    const char      *data, /* data to copy */
+    size_t           len   /* length of the data */
+)
+{
+    size_t           n;    /* number of bytes to copy in one go */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while (len)
+    {
+        if (out->pos == out->size)
+        {
+            if (rev_flush(out) != 0)
+            {
+                return -1;
+            }
+        }
+
+        n = out->size - out->pos;
+        n = n < len ? n : len;
+        memcpy(out->buf + out->pos, data, n);
+        out->pos += n;
+        data += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Decodes utf-8 code point that ends just before 'end'. Returns number of
+    bytes code point takes and stores it in 'cp'. Bytes that are not valid
+    utf-8 sequence are treated as separate characters, 'cp' is set to
+    0xfffd for them.
+   ========================================================================== */
+
+
+static size_t rev_utf8_prev
+(
+    const unsigned char  *start,  /* start of the line */
+    const unsigned char  *end,    /* one byte past the code point */
+    unsigned long        *cp      /* decoded code point */
+)
+{
+    const unsigned char  *lead;   /* first byte of the code point */
+    size_t                n;      /* number of bytes in sequence */
+    size_t                i;      /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (end[-1] < 0x80)
+    {
+        *cp = end[-1];
+        return 1;
+    }
+
+    /* go back over continuation bytes (10xxxxxx), there can be at
+     * most 3 of them
+     */
+
+    for (n = 1; n < 4 && end - n > start && (end[-n] & 0xc0) == 0x80; ++n);
+
+    lead = end - n;
+
+    if (n == 2 && (*lead & 0xe0) == 0xc0)
+    {
+        *cp = *lead & 0x1f;
+    }
+    else if (n == 3 && (*lead & 0xf0) == 0xe0)
+    {
+        *cp = *lead & 0x0f;
+    }
+    else if (n == 4 && (*lead & 0xf8) == 0xf0)
+    {
+        *cp = *lead & 0x07;
+    }
+    else
+    {
+        /* invalid sequence, treat last byte as a character
+         */
+
+        *cp = 0xfffd;
+        return 1;
+    }
+
+    for (i = 1; i != n; ++i)
+    {
+        *cp = (*cp << 6) | (lead[i] & 0x3f);
+    }
+
+    return n;
+}
+
+
+/* ==========================================================================
+    Checks if code point 'cp' extends grapheme cluster, so it must stay
+    with previous character. This is not full unicode segmentation, only
+    most common marks are covered: combining diacritics, marks of popular
+    scripts, variation selectors, emoji modifiers and tags.
+   ========================================================================== */
+
+
+static int rev_is_extend
+(
+    unsigned long  cp  /* code point to check */
+)
+{
+    static const unsigned long extend[][2] =
+    {
+        { 0x0300, 0x036f }, { 0x0483, 0x0489 }, { 0x0591, 0x05bd },
+        { 0x05bf, 0x05bf }, { 0x05c1, 0x05c2 }, { 0x05c4, 0x05c5 },
+        { 0x05c7, 0x05c7 }, { 0x0610, 0x061a }, { 0x064b, 0x065f },
+        { 0x0670, 0x0670 }, { 0x06d6, 0x06dc }, { 0x06df, 0x06e4 },
+        { 0x06e7, 0x06e8 }, { 0x06ea, 0x06ed }, { 0x0900, 0x0903 },
+        { 0x093a, 0x094f }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 },
+        { 0x0981, 0x0983 }, { 0x09bc, 0x09d7 }, { 0x0e31, 0x0e31 },
+        { 0x0e34, 0x0e3a }, { 0x0e47, 0x0e4e }, { 0x1160, 0x11ff },
+        { 0x1ab0, 0x1aff }, { 0x1dc0, 0x1dff }, { 0x200c, 0x200d },
+        { 0x20d0, 0x20ff }, { 0x302a, 0x302f }, { 0x3099, 0x309a },
+        { 0xfe00, 0xfe0f }, { 0xfe20, 0xfe2f }, { 0x1f3fb, 0x1f3ff },
+        { 0xe0020, 0xe007f }, { 0xe0100, 0xe01ef }
+    };
+
+    size_t  i;  /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (cp < extend[0][0])
+    {
+        return 0;
+    }
+
+    for (i = 0; i != sizeof(extend) / sizeof(*extend); ++i)
+    {
+        if (cp < extend[i][0])
+        {
+            return 0;
+        }
+
+        if (cp <= extend[i][1])
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Checks if code point is regional indicator (half of a flag)
+   ========================================================================== */
+
+
+static int rev_is_ri
+(
+    unsigned long  cp  /* code point to check */
+)
+{
+    return cp >= 0x1f1e6 && cp <= 0x1f1ff;
+}
+
+
+/* ==========================================================================
+    Finds start of grapheme cluster that ends just before 'end' and whose
+    last code point is 'cp' taking 'n' bytes. Returns pointer to first byte
+    of the cluster.
+   ========================================================================== */
+
+
+static const unsigned char *rev_grapheme_start
+(
+    const unsigned char  *start,  /* start of the line */
+    const unsigned char  *end,    /* one byte past the cluster */
+    unsigned long         cp,     /* last code point of the cluster */
+    size_t                n       /* length of the last code point */
+)
+{
+    const unsigned char  *p;      /* start of the cluster so far */
+    const unsigned char  *q;      /* used to count regional indicators */
+    unsigned long         prev;   /* code point before p */
+    size_t                pn;     /* length of prev code point */
+    size_t                ri;     /* number of regional indicators */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    p = end - n;
+
+    while (p != start)
+    {
+        pn = rev_utf8_prev(start, p, &prev);
+
+        if (rev_is_extend(cp) || (prev == 0x200d && cp >= 0x80))
+        {
+            /* cp is a mark that belongs to previous character, or
+             * previous character is zero width joiner that glues
+             * two (non ascii) characters together
+             */
+
+            p -= pn;
+            cp = prev;
+            continue;
+        }
+
+        if (rev_is_ri(cp) && rev_is_ri(prev))
+        {
+            /* regional indicators are paired from the start of their
+             * run, so count how many of them are before cp, if odd
+             * number, then prev and cp make one flag
+             */
+
+            for (ri = 0, q = p; q != start; ++ri)
+            {
+                pn = rev_utf8_prev(start, q, &prev);
+
+                if (!rev_is_ri(prev))
+                {
+                    break;
+                }
+
+                q -= pn;
+            }
+
+            if (ri % 2)
+            {
+                p -= 4;
+            }
+        }
+
+        break;
+    }
+
+    return p;
+}
+
+
+/* ==========================================================================
+    Copies utf-8 characters (or grapheme clusters in REV_MODE_GRAPHEME)
+    that end before 'end' into 'out' buffer, in reversed order, but each
+    of them in its original byte order. Data is walked from the end, and
+    whenever there is 16 bytes block of plain ascii characters, it is
+    reversed with byte kernel without decoding. Walk stops at 'start', or
+    at first character that starts before 'stop'.
+
+    Returns pointer to where walk stopped, or NULL on error.
+   ========================================================================== */
+
+
+static const unsigned char *rev_utf8_units
+(
+    struct rev_out       *out,    /* output buffer for reversed data */
+    const unsigned char  *start,  /* start of the data */
+    const unsigned char  *end,    /* end of not yet reversed part */
+    const unsigned char  *stop    /* don't reverse characters before it */
+)
+{
+    const unsigned char  *c;      /* start of character to copy */
+    unsigned long         cp;     /* decoded code point */
+    size_t                n;      /* length of code point */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while (end != start)
+    {
+        if (end - stop >= 16 && u3u_memascii(end - 16, 16))
+        {
+            if (rev_line_bytes(out, (const char *)end - 16, 16, 0) != 0)
+            {
+                return NULL;
+            }
+
+            end -= 16;
+            continue;
+        }
+
+        n = rev_utf8_prev(start, end, &cp);
+        c = end - n;
+
+        if (out->mode == REV_MODE_GRAPHEME)
+        {
+            c = rev_grapheme_start(start, end, cp, n);
+        }
+
+        if (c < stop)
+        {
+            break;
+        }
+
+        if (rev_copy(out, (const char *)c, end - c) != 0)
+        {
+            return NULL;
+        }
+
+        end = c;
+    }
+
+    return end;
+}
+
+
+/* ==========================================================================
+    Reverses utf-8 line 'line' of 'len' bytes into 'out' buffer. Multibyte
+    characters (or grapheme clusters in REV_MODE_GRAPHEME) are copied in
+    original order, only order of characters is reversed.
+   ========================================================================== */
+
+
+static int rev_line_utf8
+(
+    struct rev_out       *out,    /* output buffer for reversed line */
+    const char           *line,   /* line to reverse, without new line */
+    size_t                len,    /* length of the line */
+    int                   nl      /* add new line after reversed line */
+)
+{
+    const unsigned char  *start;  /* start of the line */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (u3u_memascii(line, len))
+    {
+        /* whole line is ascii, no need to decode anything
+         */
+
+        return rev_line_bytes(out, line, len, nl);
+    }
+
+    start = (const unsigned char *)line;
+
+    if (rev_utf8_units(out, start, start + len, start) == NULL)
+    {
+        return -1;
+    }
+
+    return nl ? rev_copy(out, "\n", 1) : 0;
+}
+
+
+/* ==========================================================================
+    Reverses single line according to mode set in 'out'.
+   ========================================================================== */
+
+
+static int rev_line
+(
+    struct rev_out  *out,  /* output buffer to store reversed line in */
+    const char      *line, /* line to reverse, without new line */
+    size_t           len,  /* length of the line */
+    int              nl    /* add new line after reversed line or not */
+)
+{
+    if (out->mode == REV_MODE_BYTE)
+    {
+        return rev_line_bytes(out, line, len, nl);
+    }
+
+    return rev_line_utf8(out, line, len, nl);
+}
+
+
+/* ==========================================================================
+    Reverses all lines from 'data' of size 'len' and stores them in 'out'.
+    Last line does not need to end with new line character.
+   ========================================================================== */
+
+
+static int rev_lines
+(
+    struct rev_out  *out,   /* output buffer to store reversed lines in */
+    const char      *data,  /* lines to reverse */
+    size_t           len    /* length of data */
+)
+{
+    const char      *end;   /* one byte past the last byte of data */
+    const char      *nl;    /* new line character in data */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    end = data + len;
+
+    while (data != end)
+    {
+        nl = memchr(data, '\n', end - data);
+
+        if (nl == NULL)
+        {
+            /* last line without new line character at the end
+             */
+
+            return rev_line(out, data, end - data, 0);
+        }
+
+        if (rev_line(out, data, nl - data, 1) != 0)
+        {
+            return -1;
+        }
+
+        data = nl + 1;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Returns length of chunk that starts at 'data'. Chunk is at least
+    U3_REV_CHUNK_SIZE bytes long (unless there is less data left) and
+    always ends with full line, so no line is split between two chunks.
+
+    Line that crosses nominal end of chunk cannot be longer than
+    U3_REV_BUF_MAX, so chunk is never longer than sum of both. When it
+    is longer, chunk ends before that line, or, when chunk starts with
+    it, chunk is just that line, and 'giant' is set. Giant line does not
+    fit in any buffer, it must be reversed straight to output.
+   ========================================================================== */
+
+
+static size_t rev_chunk_len
+(
+    const char  *data,  /* start of the chunk */
+    size_t       size,  /* number of bytes left in file */
+    int         *giant  /* chunk is single line longer than U3_REV_BUF_MAX */
+)
+{
+    const char  *nl;    /* first new line after nominal chunk size */
+    const char  *end;   /* end of the chunk */
+    const char  *line;  /* start of line crossing nominal chunk end */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    *giant = 0;
+
+    if (size <= U3_REV_CHUNK_SIZE)
+    {
+        return size;
+    }
+
+    nl = memchr(data + U3_REV_CHUNK_SIZE - 1, '\n',
+        size - U3_REV_CHUNK_SIZE + 1);
+    end = nl ? nl + 1 : data + size;
+
+    if ((size_t)(end - data) <= U3_REV_BUF_MAX)
+    {
+        /* no line in chunk can be too long, no need to look
+         */
+
+        return end - data;
+    }
+
+    line = data + U3_REV_CHUNK_SIZE - 1;
+
+    while (line != data && line[-1] != '\n')
+    {
+        --line;
+    }
+
+    if ((size_t)(end - line) <= U3_REV_BUF_MAX)
+    {
+        return end - data;
+    }
+
+    if (line != data)
+    {
+        return line - data;
+    }
+
+    *giant = 1;
+    return end - data;
+}
+
+
+#if REV_JOBS
+
+
+/* ==========================================================================
+    Thread that takes queued chunks in order and reverses them. Output of
+    reversed chunk has exactly the same size as the input, and chunk buffer
+    is that big, so rev_lines() never flushes (nor fails) here. Giant
+    chunks have no buffer, they are left for the writer.
+   ========================================================================== */
+
+
+static void *rev_worker
+(
+    void              *arg   /* pool thread works for */
+)
+{
+    struct rev_pool   *pool; /* pool thread works for */
+    struct rev_chunk  *c;    /* chunk to reverse */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    pool = arg;
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;)
+    {
+        while (pool->taken == pool->queued && pool->stop == 0)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+
+        if (pool->taken == pool->queued)
+        {
+            /* we are told to stop and there is nothing left to do
+             */
+
+            break;
+        }
+
+        c = &pool->chunks[pool->taken++ % pool->nchunks];
+        pthread_mutex_unlock(&pool->lock);
+
+        if (c->giant == 0)
+        {
+            rev_lines(&c->out, c->data, c->len);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        c->done = 1;
+        pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+/* ==========================================================================
+    Reverses 'data' of 'size' bytes with 'jobs' threads. Data is split
+    into chunks ending on line boundary, chunks are reversed in parallel,
+    and this thread writes them to stdout in original order. At most
+    U3_REV_CHUNKS_MAX (and no more than twice the number of threads)
+    chunks are in memory at once. Lines longer than U3_REV_BUF_MAX are not
+    buffered at all, this thread reverses them straight to output, when
+    their turn to be written comes.
+   ========================================================================== */
+
+
+static int rev_jobs
+(
+    struct rev_out    *out,      /* output buffer, to keep mode and order */
+    const char        *data,     /* data to reverse */
+    size_t             size,     /* size of the data */
+    long               jobs      /* number of threads to use */
+)
+{
+    struct rev_pool    pool;     /* pool of threads */
+    struct rev_chunk  *c;        /* chunk being queued or written */
+    pthread_t         *threads;  /* threads reversing chunks */
+    char              *nbuf;     /* chunk buffer after realloc */
+    size_t             written;  /* number of chunks written so far */
+    size_t             pos;      /* position of next chunk in data */
+    size_t             len;      /* length of next chunk */
+    long               nthreads; /* number of threads started */
+    long               i;        /* iterator */
+    int                ret;      /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* whatever is in output buffer must go first
+     */
+
+    if (rev_sync(out) != 0)
+    {
+        return -1;
+    }
+
+    memset(&pool, 0, sizeof(pool));
+
+    /* there is no use for more threads than chunks, and clamping
+     * first keeps 2 * jobs from overflowing
+     */
+
+    jobs = jobs < U3_REV_CHUNKS_MAX ? jobs : U3_REV_CHUNKS_MAX;
+    pool.nchunks = 2 * jobs < U3_REV_CHUNKS_MAX ? 2 * jobs : U3_REV_CHUNKS_MAX;
+
+    pool.chunks = calloc(pool.nchunks, sizeof(*pool.chunks));
+    threads = malloc(jobs * sizeof(*threads));
+
+    if (pool.chunks == NULL || threads == NULL)
+    {
+        free(pool.chunks);
+        free(threads);
+        return rev_lines(out, data, size);
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    /* pick memrev kernel now, so threads don't race for it
+     */
+
+    u3u_memrev(NULL, NULL, 0);
+
+    for (nthreads = 0; nthreads != jobs; ++nthreads)
+    {
+        if (pthread_create(&threads[nthreads], NULL, rev_worker, &pool) != 0)
+        {
+            break;
+        }
+    }
+
+    ret = 0;
+    pos = 0;
+    written = 0;
+
+    if (nthreads == 0)
+    {
+        /* could not start any thread, do it all ourself then
+         */
+
+        ret = rev_lines(out, data, size);
+        pos = size;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+
+    for (;;)
+    {
+        /* queue as many chunks as there are free slots
+         */
+
+        while (ret == 0 && pos != size &&
+            pool.queued - written != pool.nchunks)
+        {
+            c = &pool.chunks[pool.queued % pool.nchunks];
+            len = rev_chunk_len(data + pos, size - pos, &c->giant);
+
+            if (c->giant == 0 && c->out.size < len)
+            {
+                nbuf = realloc(c->out.buf, len);
+
+                if (nbuf == NULL)
+                {
+                    perror("e/realloc()");
+                    ret = -1;
+                    break;
+                }
+
+                c->out.buf = nbuf;
+                c->out.size = len;
+            }
+
+            c->data = data + pos;
+            c->len = len;
+            c->out.pos = 0;
+            c->out.mode = out->mode;
+            c->done = 0;
+            pos += len;
+            ++pool.queued;
+            pthread_cond_signal(&pool.work);
+        }
+
+        if (written == pool.queued)
+        {
+            /* everything queued has been written, we're done
+             */
+
+            break;
+        }
+
+        /* wait for the oldest chunk and write it out, chunk
+         * won't be touched by anyone else until we queue it
+         * again
+         */
+
+        c = &pool.chunks[written % pool.nchunks];
+
+        while (c->done == 0)
+        {
+            pthread_cond_wait(&pool.done, &pool.lock);
+        }
+
+        pthread_mutex_unlock(&pool.lock);
+
+        if (ret == 0)
+        {
+            ret = c->giant ? rev_lines(out, c->data, c->len) :
+                rev_write(out, c->out.buf, c->out.pos);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        ++written;
+    }
+
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i != nthreads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i != (long)pool.nchunks; ++i)
+    {
+        free(pool.chunks[i].out.buf);
+    }
+
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.work);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.chunks);
+    free(threads);
+    return ret;
+}
+
+#endif /* REV_JOBS */
+
+
+/* ==========================================================================
+    Maps regular file 'fd' into memory and reverses lines directly from the
+    mapping, without copying them to the line buffer first. This has no
+    limit on line length.
+
+    Returns 0 on success, -1 on error, and 1 when file cannot be mapped
+    (it is not a regular file or mmap failed), in which case caller should
+    read file in the usual way.
+   ========================================================================== */
+
+
+#if HAVE_MMAP
+
+static int rev_mmap
+(
+    int              fd,    /* file to reverse */
+    struct rev_out  *out,   /* output buffer to store reversed lines in */
+    long             jobs   /* number of threads to reverse file with */
+)
+{
+    struct stat      st;    /* information about fd */
+    void            *data;  /* fd mapped into memory */
+    size_t           size;  /* size of the file */
+    int              ret;   /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return 1;
+    }
+
+    if (st.st_size == 0)
+    {
+        /* empty file, mmap() would fail on that and there is
+         * nothing to reverse anyway
+         */
+
+        return 0;
+    }
+
+    if ((uintmax_t)st.st_size > SIZE_MAX)
+    {
+        /* file is too big to be mapped in one go
+         */
+
+        return 1;
+    }
+
+    size = (size_t)st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED)
+    {
+        return 1;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    /* we go through file only once from start to end, let the kernel
+     * know, so it can read ahead more aggressively
+     */
+
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+#if REV_JOBS
+
+    if (jobs > 1 && size > U3_REV_CHUNK_SIZE)
+    {
+        ret = rev_jobs(out, data, size, jobs);
+        munmap(data, size);
+        return ret;
+    }
+
+#else /* REV_JOBS */
+
+    (void)jobs;
+
+#endif /* REV_JOBS */
+
+    ret = rev_lines(out, data, size);
+    munmap(data, size);
+    return ret;
+}
+
+#endif /* HAVE_MMAP */
+
+
+/* ==========================================================================
+    Reads exactly 'len' bytes from 'fd' at 'off', unless end of file is
+    reached first. Returns number of bytes read or -1 on error.
+   ========================================================================== */
+
+
+static ssize_t rev_pread
+(
+    int       fd,    /* file to read from */
+    void     *buf,   /* where to store read data */
+    size_t    len,   /* number of bytes to read */
+    off_t     off    /* where in the file to start reading */
+)
+{
+    size_t    have;  /* number of bytes read so far */
+    ssize_t   r;     /* return value from pread() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (have = 0; have != len; have += r)
+    {
+        r = pread(fd, (char *)buf + have, len - have, off + have);
+
+        if (r == -1 && errno == EINTR)
+        {
+            r = 0;
+            continue;
+        }
+
+        if (r == -1)
+        {
+            perror("e/pread()");
+            return -1;
+        }
+
+        if (r == 0)
+        {
+            break;
+        }
+    }
+
+    return have;
+}
+
+
+/* ==========================================================================
+    Writes all 'len' bytes of 'buf' to 'fd' at 'off'.
+   ========================================================================== */
+
+
+static int rev_pwrite
+(
+    int          fd,    /* file to write to */
+    const void  *buf,   /* data to write */
+    size_t       len,   /* number of bytes to write */
+    off_t        off    /* where in the file to write data */
+)
+{
+    ssize_t      w;     /* return value from pwrite() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while (len)
+    {
+        w = pwrite(fd, buf, len, off);
+
+        if (w == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("e/pwrite()");
+            return -1;
+        }
+
+        buf = (const char *)buf + w;
+        len -= w;
+        off += w;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Reverses bytes from 'lo' to 'hi' of seekable file 'fd' into 'out'
+    buffer, without holding them in memory. Data is read backward in
+    blocks of 'size' bytes into 'buf'. In utf-8 modes first few bytes of
+    each block may be a part of character that starts in previous block,
+    so they are left for the next round. Clusters longer than that
+    margin may be split at block boundary.
+   ========================================================================== */
+
+
+static int rev_ooc
+(
+    struct rev_out       *out,    /* output buffer for reversed data */
+    int                   fd,     /* file to read data from */
+    off_t                 lo,     /* offset of the first byte to reverse */
+    off_t                 hi,     /* offset one past the last byte */
+    char                 *buf,    /* scratch buffer for blocks */
+    size_t                size    /* size of the buf */
+)
+{
+    const unsigned char  *start;  /* start of the block */
+    const unsigned char  *left;   /* not reversed part of the block */
+    off_t                 s;      /* offset of the block */
+    size_t                n;      /* length of the block */
+    size_t                margin; /* bytes left for the next block */
+    ssize_t               r;      /* return value from rev_pread() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    start = (const unsigned char *)buf;
+    margin = size / 2 < REV_OOC_MARGIN ? size / 2 : REV_OOC_MARGIN;
+
+    while (hi != lo)
+    {
+        s = hi - lo > (off_t)size ? hi - (off_t)size : lo;
+        n = (size_t)(hi - s);
+
+        if ((r = rev_pread(fd, buf, n, s)) == -1)
+        {
+            return -1;
+        }
+
+        if ((size_t)r != n)
+        {
+            fprintf(stderr, "e/input shrunk while being reversed\n");
+            errno = EIO;
+            return -1;
+        }
+
+        if (out->mode == REV_MODE_BYTE || u3u_memascii(buf, n))
+        {
+            if (rev_line_bytes(out, buf, n, 0) != 0)
+            {
+                return -1;
+            }
+
+            hi = s;
+            continue;
+        }
+
+        left = rev_utf8_units(out, start, start + n,
+            s == lo ? start : start + margin);
+
+        if (left == start + n)
+        {
+            /* single cluster bigger than whole block, we have to
+             * split it somewhere
+             */
+
+            left = rev_utf8_units(out, start, start + n, start);
+        }
+
+        if (left == NULL)
+        {
+            return -1;
+        }
+
+        hi = s + (left - start);
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Creates temporary file in $TMPDIR (or /tmp) for data that does not
+    fit into memory. File is unlinked right away, so it is gone once it's
+    closed, even if we crash. Returns file descriptor or -1 on error.
+   ========================================================================== */
+
+
+static int rev_spill_open(void)
+{
+    char         path[PATH_MAX];  /* path to temporary file */
+    const char  *dir;             /* directory for temporary file */
+    int          fd;              /* temporary file */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    dir = getenv("TMPDIR");
+    dir = dir && *dir ? dir : "/tmp";
+
+    if ((size_t)snprintf(path, sizeof(path), "%s/rev-XXXXXX", dir)
+        >= sizeof(path))
+    {
+        fprintf(stderr, "e/path is too long: %s\n", dir);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if ((fd = mkstemp(path)) == -1)
+    {
+        perror("e/mkstemp()");
+        return -1;
+    }
+
+    unlink(path);
+    return fd;
+}
+
+
+/* ==========================================================================
+    Reads next block from 'fd' into 'buf', retrying when interrupted.
+   ========================================================================== */
+
+
+static ssize_t rev_read
+(
+    int       fd,    /* file to read from */
+    char     *buf,   /* where to store data */
+    size_t    size   /* size of the buf */
+)
+{
+    ssize_t   r;     /* return value from read() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while ((r = read(fd, buf, size)) == -1 && errno == EINTR)
+    {
+        continue;
+    }
+
+    if (r == -1)
+    {
+        perror("e/error reading input file");
+    }
+
+    return r;
+}
+
+
+/* ==========================================================================
+    Reverses line that does not fit into memory. 'buf' of 'size' bytes
+    is full with beginning of the line, and is used as scratch space.
+
+    When 'fd' is seekable, we only find where line ends, and read it
+    again backward from there, and then seek past the line. Otherwise
+    line is spilled into temporary file and reversed from there, along
+    with whatever was read past the line, which is put back into 'buf'.
+
+    Returns number of bytes read past the line, that are in 'buf' now,
+    or -1 on error.
+   ========================================================================== */
+
+
+static ssize_t rev_giant
+(
+    int              fd,    /* file to read line from */
+    struct rev_out  *out,   /* output buffer for reversed line */
+    char            *buf,   /* buffer with beginning of the line */
+    size_t           size   /* size of the buf */
+)
+{
+    struct stat      st;    /* information about fd */
+    const char      *nl;    /* new line character in buf */
+    off_t            lo;    /* offset of the line */
+    off_t            hi;    /* offset of the end of the line */
+    off_t            end;   /* offset past all data we have */
+    ssize_t          r;     /* return value from rev_read() */
+    size_t           rest;  /* number of bytes read past the line */
+    int              sfd;   /* file line is reversed from */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    sfd = -1;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+        (end = lseek(fd, 0, SEEK_CUR)) != -1)
+    {
+        lo = end - size;
+    }
+    else
+    {
+        if ((sfd = rev_spill_open()) == -1)
+        {
+            return -1;
+        }
+
+        if (rev_pwrite(sfd, buf, size, 0) != 0)
+        {
+            close(sfd);
+            return -1;
+        }
+
+        lo = 0;
+        end = size;
+    }
+
+    /* look for the end of the line
+     */
+
+    for (;;)
+    {
+        if ((r = rev_read(fd, buf, size)) == -1)
+        {
+            break;
+        }
+
+        if (sfd != -1 && rev_pwrite(sfd, buf, r, end) != 0)
+        {
+            r = -1;
+            break;
+        }
+
+        nl = memchr(buf, '\n', r);
+        hi = nl ? end + (nl - buf) : end + r;
+        end += r;
+
+        if (nl || r == 0)
+        {
+            break;
+        }
+    }
+
+    if (r == -1 || rev_ooc(out, sfd == -1 ? fd : sfd, lo, hi, buf, size))
+    {
+        if (sfd != -1)
+        {
+            close(sfd);
+        }
+
+        return -1;
+    }
+
+    rest = 0;
+
+    if (hi != end)
+    {
+        /* line ends with new line character, and there may be more
+         * data after it
+         */
+
+        if (rev_copy(out, "\n", 1) != 0)
+        {
+            r = -1;
+        }
+        else if (sfd == -1)
+        {
+            if ((r = lseek(fd, hi + 1, SEEK_SET)) == -1)
+            {
+                perror("e/lseek()");
+            }
+        }
+        else
+        {
+            rest = (size_t)(end - hi - 1);
+            r = rev_pread(sfd, buf, rest, hi + 1);
+        }
+    }
+
+    if (sfd != -1)
+    {
+        close(sfd);
+    }
+
+    return r == -1 ? -1 : (ssize_t)rest;
+}
+
+
+/* ==========================================================================
+    Reads data from 'fd' in big blocks and reverses all lines found in
+    them. Line that did not fit into block is moved to the beginning of
+    the buffer and the rest of it is read in next round. If malloc is
+    enabled, buffer grows when single line does not fit into it, up to
+    U3_REV_BUF_MAX, and lines that are longer than buffer can get, are
+    reversed out of core.
+   ========================================================================== */
+
+
+static int rev_stream
+(
+    int              fd,     /* file descriptor to read data from */
+    struct rev_out  *out     /* output buffer to store reversed lines in */
+)
+{
+    const char      *line;   /* start of line to reverse */
+    const char      *nl;     /* new line character in buf */
+    const char      *end;    /* one byte past valid data in buf */
+    size_t           size;   /* size of the buf */
+    size_t           have;   /* number of valid bytes in buf */
+    ssize_t          r;      /* number of new bytes in buf */
+    int              ret;    /* return code from the function */
+
+#if ENABLE_MALLOC
+    char            *buf;    /* buffer for data read from fd */
+    char            *nbuf;   /* buffer after realloc */
+#else
+    char             buf[U3_REV_BUF_SIZE > U3_REV_LINE_MAX ?
+                         U3_REV_BUF_SIZE : U3_REV_LINE_MAX + 1];
+#endif
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = U3_REV_BUF_SIZE;
+
+#if ENABLE_MALLOC
+
+    buf = malloc(size);
+
+    if (buf == NULL)
+    {
+        perror("e/malloc()");
+        return -1;
+    }
+
+#else /* ENABLE_MALLOC */
+
+    size = sizeof(buf);
+
+#endif /* ENABLE_MALLOC */
+
+    ret = 0;
+    have = 0;
+
+    for (;;)
+    {
+        if (have == size)
+        {
+            /* whole buffer is filled with single line that does not
+             * end with new line character
+             */
+
+#if ENABLE_MALLOC
+
+            if (size * 2 <= U3_REV_BUF_MAX)
+            {
+                /* but nothing is lost yet, malloc is enabled so we can
+                 * allocate more memory to satisfy that long line.
+                 */
+
+                nbuf = realloc(buf, size * 2);
+
+                if (nbuf == NULL)
+                {
+                    perror("e/realloc()");
+                    ret = -1;
+                    break;
+                }
+
+                buf = nbuf;
+                size *= 2;
+                continue;
+            }
+
+#endif /* ENABLE_MALLOC */
+
+            /* line is too long to keep it in memory, reverse it out
+             * of core, what was read past it, is now at the start
+             * of buffer
+             */
+
+            if ((r = rev_giant(fd, out, buf, size)) == -1)
+            {
+                ret = -1;
+                break;
+            }
+
+            have = 0;
+        }
+        else
+        {
+            if ((r = rev_read(fd, buf + have, size - have)) == -1)
+            {
+                ret = -1;
+                break;
+            }
+
+            if (r == 0)
+            {
+                /* end of file reached, reverse last line if there is
+                 * any, it does not have new line character at the end
+                 */
+
+                if (have)
+                {
+                    ret = rev_line(out, buf, have, 0);
+                }
+
+                break;
+            }
+        }
+
+        /* now reverse all full lines we have in buffer
+         */
+
+        end = buf + have + r;
+        line = buf;
+
+        while ((nl = memchr(line, '\n', end - line)) != NULL)
+        {
+            if (rev_line(out, line, nl - line, 1) != 0)
+            {
+                ret = -1;
+                break;
+            }
+
+            line = nl + 1;
+        }
+
+        if (ret != 0)
+        {
+            break;
+        }
+
+        /* move partial line (if any) at the beginning of buffer
+         * so we can read rest of it in next round
+         */
+
+        have = end - line;
+        memmove(buf, line, have);
+    }
+
+#if ENABLE_MALLOC
+    free(buf);
+#endif
+
+    return ret;
+}
+
+
+/* ==========================================================================
+    Reverses in place each utf-8 character (or cluster) that ends before
+    'end', walking from the end, so what is before it is still intact when
+    it's decoded. Walk stops at 'start', or at first character that starts
+    before 'stop'. Returns pointer to where walk stopped.
+   ========================================================================== */
+
+
+static char *rev_inplace_units
+(
+    char            *start, /* start of the data */
+    char            *end,   /* end of not yet processed part */
+    char            *stop,  /* don't reverse characters before it */
+    enum rev_mode    mode   /* how to reverse characters */
+)
+{
+    unsigned char   *s;     /* start as unsigned */
+    unsigned char   *e;     /* end as unsigned */
+    unsigned char   *c;     /* start of character to reverse */
+    unsigned long    cp;    /* decoded code point */
+    size_t           n;     /* length of code point */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    s = (unsigned char *)start;
+    e = (unsigned char *)end;
+
+    while (e != s)
+    {
+        if (e - (unsigned char *)stop >= 16 && u3u_memascii(e - 16, 16))
+        {
+            /* single bytes, nothing to do before whole line
+             * is reversed
+             */
+
+            e -= 16;
+            continue;
+        }
+
+        n = rev_utf8_prev(s, e, &cp);
+        c = e - n;
+
+        if (mode == REV_MODE_GRAPHEME)
+        {
+            c = (unsigned char *)rev_grapheme_start(s, e, cp, n);
+        }
+
+        if (c < (unsigned char *)stop)
+        {
+            break;
+        }
+
+        u3u_memrev(c, c, e - c);
+        e = c;
+    }
+
+    return (char *)e;
+}
+
+
+/* ==========================================================================
+    Reverses single line 'line' of 'len' bytes in place. In utf-8 modes
+    each character is reversed first, and then whole line is reversed,
+    which puts characters back in their original byte order.
+   ========================================================================== */
+
+
+static void rev_inplace_line
+(
+    char            *line,  /* line to reverse, without new line */
+    size_t           len,   /* length of the line */
+    enum rev_mode    mode   /* how to reverse line */
+)
+{
+    if (mode != REV_MODE_BYTE && !u3u_memascii(line, len))
+    {
+        rev_inplace_units(line, line + len, line, mode);
+    }
+
+    u3u_memrev(line, line, len);
+}
+
+
+/* ==========================================================================
+    Reverses in place all lines from 'data' of size 'len'. Last line does
+    not need to end with new line character.
+   ========================================================================== */
+
+
+static void rev_inplace_lines
+(
+    char            *data,  /* lines to reverse */
+    size_t           len,   /* length of data */
+    enum rev_mode    mode   /* how to reverse lines */
+)
+{
+    char            *end;   /* one byte past the last byte of data */
+    char            *nl;    /* new line character in data */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    end = data + len;
+
+    while (data != end)
+    {
+        if ((nl = memchr(data, '\n', end - data)) == NULL)
+        {
+            nl = end;
+        }
+
+        rev_inplace_line(data, nl - data, mode);
+        data = nl == end ? end : nl + 1;
+    }
+}
+
+
+/* ==========================================================================
+    Returns 64bit FNV-1a checksum of 'len' bytes of 'data', continuing
+    from 'sum' (pass REV_JOURNAL_SUM to start new one).
+   ========================================================================== */
+
+
+static uint64_t rev_journal_sum
+(
+    uint64_t              sum,   /* checksum so far */
+    const void           *data,  /* data to checksum */
+    size_t                len    /* length of the data */
+)
+{
+    const unsigned char  *p;     /* data as bytes */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (p = data; len; --len)
+    {
+        sum = (sum ^ *p++) * 1099511628211ULL;
+    }
+
+    return sum;
+}
+
+
+/* ==========================================================================
+    Stores journal header 'j' in 'jfd' and makes sure it hit the disk.
+   ========================================================================== */
+
+
+static int rev_journal_put
+(
+    int                  jfd,  /* journal file */
+    struct rev_journal  *j     /* header to store */
+)
+{
+    if (rev_pwrite(jfd, j, sizeof(*j), 0) != 0)
+    {
+        return -1;
+    }
+
+    if (fdatasync(jfd) != 0)
+    {
+        perror("e/fdatasync()");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Opens journal 'jpath' of file 'fd' that is reversed in place, or
+    creates new one if there is none. If journal says that previous run
+    was interrupted while reversing a window, and original data of the
+    window was fully saved, it is copied back to the file, so window is
+    in its original state again. Checksum that does not match means we
+    crashed before window was saved, and file was not yet touched then.
+
+    On success 'j' holds offset to continue from, and journal file
+    descriptor is returned. -1 is returned on error.
+   ========================================================================== */
+
+
+static int rev_journal_open
+(
+    const char          *jpath,  /* path to journal file */
+    int                  fd,     /* file reversed in place */
+    off_t                size,   /* size of fd */
+    enum rev_mode        mode,   /* how lines are reversed */
+    struct rev_journal  *j       /* journal header read from file */
+)
+{
+    char                 buf[U3_REV_BUF_SIZE]; /* for copying window */
+    uint64_t             sum;    /* checksum of saved window */
+    uint64_t             pos;    /* position in saved window */
+    size_t               n;      /* number of bytes to copy in one go */
+    ssize_t              r;      /* return value from rev_pread() */
+    int                  jfd;    /* journal file */
+    int                  pass;   /* 0 - verify saved window, 1 - restore */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if ((jfd = open(jpath, O_RDWR | O_CREAT, 0600)) == -1)
+    {
+        perror("e/open()");
+        return -1;
+    }
+
+    if ((r = rev_pread(jfd, j, sizeof(*j), 0)) == -1)
+    {
+        close(jfd);
+        return -1;
+    }
+
+    if ((size_t)r < sizeof(*j))
+    {
+        /* new journal, or we crashed before first header was stored,
+         * in both cases file was not yet touched
+         */
+
+        memset(j, 0, sizeof(*j));
+        memcpy(j->magic, REV_JOURNAL_MAGIC, sizeof(j->magic));
+        j->mode = mode;
+
+        if (rev_journal_put(jfd, j) != 0)
+        {
+            close(jfd);
+            return -1;
+        }
+
+        return jfd;
+    }
+
+    if (memcmp(j->magic, REV_JOURNAL_MAGIC, sizeof(j->magic)) != 0 ||
+        j->off > (uint64_t)size || j->len > (uint64_t)size - j->off)
+    {
+        fprintf(stderr, "e/%s is not a valid rev journal\n", jpath);
+        close(jfd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (j->mode != (uint32_t)mode)
+    {
+        fprintf(stderr, "e/%s was started with different -u/-g options\n",
+            jpath);
+        close(jfd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (pass = 0; pass != 2 && j->len; ++pass)
+    {
+        sum = REV_JOURNAL_SUM;
+
+        for (pos = 0; pos != j->len; pos += n)
+        {
+            n = j->len - pos < sizeof(buf) ? j->len - pos : sizeof(buf);
+
+            if ((r = rev_pread(jfd, buf, n, sizeof(*j) + pos)) == -1)
+            {
+                close(jfd);
+                return -1;
+            }
+
+            if ((size_t)r != n)
+            {
+                /* journal was cut short, so window could not have
+                 * been saved
+                 */
+
+                break;
+            }
+
+            if (pass == 0)
+            {
+                sum = rev_journal_sum(sum, buf, n);
+                continue;
+            }
+
+            if (rev_pwrite(fd, buf, n, j->off + pos) != 0)
+            {
+                close(jfd);
+                return -1;
+            }
+        }
+
+        if (pass == 0 && (pos != j->len || sum != j->sum))
+        {
+            break;
+        }
+    }
+
+    if (j->len && pass == 2 && fdatasync(fd) != 0)
+    {
+        perror("e/fdatasync()");
+        close(jfd);
+        return -1;
+    }
+
+    /* window is in original state now, start again from it
+     */
+
+    j->len = 0;
+    j->sum = 0;
+
+    if (rev_journal_put(jfd, j) != 0)
+    {
+        close(jfd);
+        return -1;
+    }
+
+    return jfd;
+}
+
+
+/* ==========================================================================
+    Reverses lines of single window 'win' of 'len' bytes, that is at 'off'
+    in file 'fd'. Original window is saved in journal 'jfd' before it is
+    touched, and journal is marked done only after reversed window is on
+    disk. If 'mapped' is set, 'win' is shared mapping of the file,
+    otherwise it's a buffer that is written back to the file.
+   ========================================================================== */
+
+
+static int rev_inplace_window
+(
+    int                  fd,      /* file reversed in place */
+    int                  jfd,     /* journal file */
+    struct rev_journal  *j,       /* journal header */
+    char                *win,     /* window to reverse */
+    off_t                off,     /* offset of window in file */
+    size_t               len,     /* length of the window */
+    int                  mapped   /* win is mapped file or a copy */
+)
+{
+#if HAVE_MMAP
+    long                 page;    /* size of memory page */
+    size_t               skew;    /* win distance from page start */
+#endif
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* save original window, it goes to disk together with header,
+     * and if header makes it without the data, checksum will tell
+     */
+
+    if (rev_pwrite(jfd, win, len, sizeof(*j)) != 0)
+    {
+        return -1;
+    }
+
+    j->off = off;
+    j->len = len;
+    j->sum = rev_journal_sum(REV_JOURNAL_SUM, win, len);
+
+    if (rev_journal_put(jfd, j) != 0)
+    {
+        return -1;
+    }
+
+    rev_inplace_lines(win, len, (enum rev_mode)j->mode);
+
+#if HAVE_MMAP
+
+    if (mapped)
+    {
+        page = sysconf(_SC_PAGESIZE);
+        skew = page > 0 ? (size_t)(off % page) : 0;
+
+        if (msync(win - skew, len + skew, MS_SYNC) != 0)
+        {
+            perror("e/msync()");
+            return -1;
+        }
+    }
+
+#endif /* HAVE_MMAP */
+
+    if (!mapped)
+    {
+        if (rev_pwrite(fd, win, len, off) != 0)
+        {
+            return -1;
+        }
+
+        if (fdatasync(fd) != 0)
+        {
+            perror("e/fdatasync()");
+            return -1;
+        }
+    }
+
+    /* reversed window is on disk, move on
+     */
+
+    j->off = off + len;
+    j->len = 0;
+    j->sum = 0;
+    return rev_journal_put(jfd, j);
+}
+
+
+/* ==========================================================================
+    Reverses bytes from 'lo' to 'hi' of file 'fd' in place, without
+    holding them in memory. Two blocks, one from each end, are read into
+    halves of 'buf', reversed, and written back swapped, until ends meet.
+   ========================================================================== */
+
+
+static int rev_inplace_swap
+(
+    int       fd,    /* file to reverse data in */
+    off_t     lo,    /* offset of the first byte to reverse */
+    off_t     hi,    /* offset one past the last byte */
+    char     *buf,   /* scratch buffer */
+    size_t    size   /* size of the buf */
+)
+{
+    size_t    h;     /* size of single block */
+    size_t    n;     /* number of bytes in the middle */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    h = size / 2;
+
+    while (hi - lo >= (off_t)(2 * h))
+    {
+        if (rev_pread(fd, buf, h, lo) != (ssize_t)h ||
+            rev_pread(fd, buf + h, h, hi - h) != (ssize_t)h)
+        {
+            return -1;
+        }
+
+        u3u_memrev(buf, buf, h);
+        u3u_memrev(buf + h, buf + h, h);
+
+        if (rev_pwrite(fd, buf + h, h, lo) != 0 ||
+            rev_pwrite(fd, buf, h, hi - h) != 0)
+        {
+            return -1;
+        }
+
+        lo += h;
+        hi -= h;
+    }
+
+    n = (size_t)(hi - lo);
+
+    if (rev_pread(fd, buf, n, lo) != (ssize_t)n)
+    {
+        return -1;
+    }
+
+    u3u_memrev(buf, buf, n);
+    return rev_pwrite(fd, buf, n, lo);
+}
+
+
+/* ==========================================================================
+    Reverses in place each utf-8 character between 'lo' and 'hi' of file
+    'fd', reading it backward in blocks, like rev_ooc() does.
+   ========================================================================== */
+
+
+static int rev_inplace_ooc_units
+(
+    int              fd,     /* file to reverse characters in */
+    off_t            lo,     /* offset of the first byte */
+    off_t            hi,     /* offset one past the last byte */
+    char            *buf,    /* scratch buffer */
+    size_t           size,   /* size of the buf */
+    enum rev_mode    mode    /* how to reverse characters */
+)
+{
+    char            *left;   /* not processed part of the block */
+    off_t            s;      /* offset of the block */
+    size_t           n;      /* length of the block */
+    size_t           margin; /* bytes left for the next block */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    margin = size / 2 < REV_OOC_MARGIN ? size / 2 : REV_OOC_MARGIN;
+
+    while (hi != lo)
+    {
+        s = hi - lo > (off_t)size ? hi - (off_t)size : lo;
+        n = (size_t)(hi - s);
+
+        if (rev_pread(fd, buf, n, s) != (ssize_t)n)
+        {
+            return -1;
+        }
+
+        left = rev_inplace_units(buf, buf + n,
+            s == lo ? buf : buf + margin, mode);
+
+        if (left == buf + n)
+        {
+            left = rev_inplace_units(buf, buf + n, buf, mode);
+        }
+
+        if (rev_pwrite(fd, left, buf + n - left, s + (left - buf)) != 0)
+        {
+            return -1;
+        }
+
+        hi = s + (left - buf);
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Reverses in place line at 'off' of file 'fd' that does not fit into
+    'buf'. Line is saved in journal block by block, just like a window,
+    so it can be restored after a crash. Length of the line, including
+    new line character, is stored in 'len'.
+   ========================================================================== */
+
+
+static int rev_inplace_giant
+(
+    int                  fd,     /* file to reverse in place */
+    int                  jfd,    /* journal file */
+    struct rev_journal  *j,      /* journal header */
+    off_t                off,    /* offset of the line */
+    off_t                size,   /* size of the file */
+    char                *buf,    /* scratch buffer */
+    size_t               bsize,  /* size of the buf */
+    size_t              *len     /* length of the line */
+)
+{
+    const char          *nl;     /* new line character in buf */
+    uint64_t             sum;    /* checksum of the line */
+    off_t                end;    /* end of the line */
+    size_t               n;      /* bytes to process in one go */
+    ssize_t              r;      /* return value from rev_pread() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* find end of the line and save it to journal on the way
+     */
+
+    sum = REV_JOURNAL_SUM;
+    nl = NULL;
+
+    for (end = off; end != size && nl == NULL; end += n)
+    {
+        n = size - end < (off_t)bsize ? (size_t)(size - end) : bsize;
+
+        if ((r = rev_pread(fd, buf, n, end)) != (ssize_t)n)
+        {
+            return -1;
+        }
+
+        if ((nl = memchr(buf, '\n', n)) != NULL)
+        {
+            n = nl - buf + 1;
+        }
+
+        sum = rev_journal_sum(sum, buf, n);
+
+        if (rev_pwrite(jfd, buf, n, sizeof(*j) + (end - off)) != 0)
+        {
+            return -1;
+        }
+    }
+
+    *len = (size_t)(end - off);
+    j->off = off;
+    j->len = *len;
+    j->sum = sum;
+
+    if (rev_journal_put(jfd, j) != 0)
+    {
+        return -1;
+    }
+
+    end -= nl ? 1 : 0;
+
+    if (j->mode != REV_MODE_BYTE &&
+        rev_inplace_ooc_units(fd, off, end, buf, bsize, j->mode) != 0)
+    {
+        return -1;
+    }
+
+    if (rev_inplace_swap(fd, off, end, buf, bsize) != 0)
+    {
+        return -1;
+    }
+
+    if (fdatasync(fd) != 0)
+    {
+        perror("e/fdatasync()");
+        return -1;
+    }
+
+    j->off = off + *len;
+    j->len = 0;
+    j->sum = 0;
+    return rev_journal_put(jfd, j);
+}
+
+
+#if HAVE_MMAP
+
+/* ==========================================================================
+    Reverses file 'fd' in place through shared writable mapping, starting
+    from offset stored in journal 'j'. Windows are cut like rev_jobs()
+    chunks, so none is longer than U3_REV_CHUNK_SIZE + U3_REV_BUF_MAX,
+    and lines longer than U3_REV_BUF_MAX are reversed on disk, block by
+    block. Returns 1 if file cannot be mapped.
+   ========================================================================== */
+
+
+static int rev_inplace_mmap
+(
+    int                  fd,     /* file to reverse in place */
+    int                  jfd,    /* journal file */
+    struct rev_journal  *j,      /* journal header */
+    off_t                fsize   /* size of the file */
+)
+{
+    char                 buf[U3_REV_BUF_SIZE]; /* for giant lines */
+    char                *data;   /* file mapped into memory */
+    size_t               size;   /* size of the file */
+    size_t               off;    /* offset of the next window */
+    size_t               len;    /* length of the next window */
+    int                  giant;  /* window is single very long line */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if ((uintmax_t)fsize > SIZE_MAX || fsize == 0)
+    {
+        return fsize == 0 ? 0 : 1;
+    }
+
+    size = (size_t)fsize;
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED)
+    {
+        return 1;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+    for (off = j->off; off != size; off += len)
+    {
+        len = rev_chunk_len(data + off, size - off, &giant);
+
+        if (giant)
+        {
+            /* don't copy whole line to journal at once, nor dirty
+             * all of it in the mapping, swap it on disk instead
+             */
+
+            if (rev_inplace_giant(fd, jfd, j, off, fsize, buf, sizeof(buf),
+                &len) != 0)
+            {
+                munmap(data, size);
+                return -1;
+            }
+
+            continue;
+        }
+
+        if (rev_inplace_window(fd, jfd, j, data + off, off, len, 1) != 0)
+        {
+            munmap(data, size);
+            return -1;
+        }
+    }
+
+    munmap(data, size);
+    return 0;
+}
+
+#endif /* HAVE_MMAP */
+
+
+/* ==========================================================================
+    Reverses file 'fd' in place by reading windows with pread() and
+    writing them back with pwrite(), starting from offset stored in
+    journal 'j'. Window always ends with full line, and lines that don't
+    fit into buffer are reversed on disk, block by block.
+   ========================================================================== */
+
+
+static int rev_inplace_pread
+(
+    int                  fd,     /* file to reverse in place */
+    int                  jfd,    /* journal file */
+    struct rev_journal  *j,      /* journal header */
+    off_t                size    /* size of the file */
+)
+{
+    off_t                off;    /* offset of the next window */
+    size_t               bsize;  /* size of the buf */
+    size_t               len;    /* length of the next window */
+    ssize_t              r;      /* return value from rev_pread() */
+    int                  ret;    /* return code */
+
+#if ENABLE_MALLOC
+    char                *buf;    /* buffer for window */
+    char                *nbuf;   /* buffer after realloc */
+#else
+    char                 buf[U3_REV_BUF_SIZE > U3_REV_LINE_MAX ?
+                             U3_REV_BUF_SIZE : U3_REV_LINE_MAX + 1];
+#endif
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+#if ENABLE_MALLOC
+
+    bsize = U3_REV_CHUNK_SIZE;
+
+    if ((buf = malloc(bsize)) == NULL)
+    {
+        perror("e/malloc()");
+        return -1;
+    }
+
+#else /* ENABLE_MALLOC */
+
+    bsize = sizeof(buf);
+
+#endif /* ENABLE_MALLOC */
+
+    ret = 0;
+
+    for (off = j->off; off != size; off += len)
+    {
+        len = size - off < (off_t)bsize ? (size_t)(size - off) : bsize;
+
+        if ((r = rev_pread(fd, buf, len, off)) == -1)
+        {
+            ret = -1;
+            break;
+        }
+
+        if ((size_t)r != len)
+        {
+            fprintf(stderr, "e/file shrunk while being reversed\n");
+            errno = EIO;
+            ret = -1;
+            break;
+        }
+
+        if (off + (off_t)len != size)
+        {
+            /* cut window after last full line in it
+             */
+
+            while (len && buf[len - 1] != '\n')
+            {
+                --len;
+            }
+        }
+
+        if (len == 0)
+        {
+            /* single line does not fit into buffer
+             */
+
+#if ENABLE_MALLOC
+
+            if (bsize * 2 <= U3_REV_BUF_MAX)
+            {
+                if ((nbuf = realloc(buf, bsize * 2)) == NULL)
+                {
+                    perror("e/realloc()");
+                    ret = -1;
+                    break;
+                }
+
+                buf = nbuf;
+                bsize *= 2;
+                continue;
+            }
+
+#endif /* ENABLE_MALLOC */
+
+            if (rev_inplace_giant(fd, jfd, j, off, size, buf, bsize, &len))
+            {
+                ret = -1;
+                break;
+            }
+
+            continue;
+        }
 
-#include "u3.h"
-#include "u3defs.h"
+        if (rev_inplace_window(fd, jfd, j, buf, off, len, 0) != 0)
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+#if ENABLE_MALLOC
+    free(buf);
+#endif
+
+    return ret;
+}
 
 
 /* ==========================================================================
-               ____                     __   _
-              / __/__  __ ____   _____ / /_ (_)____   ____   _____
-             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
-            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
-           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+    Reverses lines of file 'path' in place, line lengths don't change, so
+    there is no need for temporary copy of the file. File is processed in
+    windows of whole lines, and original data of the window that is being
+    worked on is kept in '<path>.rev-journal'. If rev is interrupted (even
+    by power loss), file contains reversed lines up to some line, and
+    original lines after it, plus journal that says where that is. Running
+    'rev -i' on the file again finishes the job, and journal is removed
+    once whole file is reversed. Safety is not free, every byte is written
+    twice (to journal, then reversed to the file), and each window costs
+    three syncs.
+   ========================================================================== */
+
+
+static int rev_inplace
+(
+    const char          *path,   /* file to reverse in place */
+    enum rev_mode        mode    /* how to reverse lines */
+)
+{
+    char                 jpath[PATH_MAX];  /* path to journal */
+    struct rev_journal   j;      /* journal header */
+    struct stat          st;     /* information about file */
+    int                  fd;     /* file to reverse */
+    int                  jfd;    /* journal file */
+    int                  ret;    /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if ((size_t)snprintf(jpath, sizeof(jpath), "%s.rev-journal", path)
+        >= sizeof(jpath))
+    {
+        fprintf(stderr, "e/path is too long: %s\n", path);
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    if ((fd = open(path, O_RDWR)) == -1)
+    {
+        perror("e/open()");
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "e/%s is not a regular file\n", path);
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((jfd = rev_journal_open(jpath, fd, st.st_size, mode, &j)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    ret = 1;
+
+#if HAVE_MMAP
+    ret = rev_inplace_mmap(fd, jfd, &j, st.st_size);
+#endif
+
+    if (ret == 1)
+    {
+        ret = rev_inplace_pread(fd, jfd, &j, st.st_size);
+    }
+
+    close(jfd);
+    close(fd);
+
+    if (ret == 0)
+    {
+        /* all done, journal is not needed anymore
+         */
+
+        unlink(jpath);
+    }
+
+    return ret;
+}
 
+
+/* ==========================================================================
+    Opens file 'path' for reading, "-" means stdin. Regular file is also
+    announced to the kernel as soon to be needed, so it starts reading it
+    in background, while we are still busy with previous file.
+
+    Returns opened file or NULL on error with errno set.
    ========================================================================== */
 
 
-static void print_help(void)
+static FILE *rev_open
+(
+    const char  *path   /* path to file to open */
+)
 {
-    fprintf(stderr,
-        "usage: rev [ -v | -h | <file> ]\n"
-        "\n"
-        "  -h       print this help and exit\n"
-        "  -v       print version information and exit\n"
-        "  <file>   path to file to reverse\n"
-        "\n"
-        "if <file> is passed, program revers data in given file\n"
-        "else it uses piped data from another program\n"
-        "else data is read from stdin\n");
+    FILE        *f;     /* opened file */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (strcmp(path, "-") == 0)
+    {
+        return stdin;
+    }
+
+    if ((f = fopen(path, "r")) == NULL)
+    {
+        return NULL;
+    }
+
+#if HAVE_POSIX_FADVISE
+
+    /* don't ask for more than threads can have in flight, no point
+     * in pushing out of page cache what we will need first
+     */
+
+    posix_fadvise(fileno(f), 0, (off_t)U3_REV_CHUNK_SIZE * U3_REV_CHUNKS_MAX,
+        POSIX_FADV_WILLNEED);
+
+#endif /* HAVE_POSIX_FADVISE */
+
+    return f;
+}
+
+
+/* ==========================================================================
+    Reverses all lines from 'fin' into 'out'. Regular files are mapped
+    into memory when possible, everything else is read in blocks.
+   ========================================================================== */
+
+
+static int rev_file
+(
+    FILE            *fin,   /* file to reverse */
+    struct rev_out  *out,   /* output buffer to store reversed lines in */
+    long             jobs   /* number of threads to reverse file with */
+)
+{
+    int              ret;   /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    ret = 1;
+
+#if HAVE_MMAP
+
+    if (fin != stdin)
+    {
+        /* we are reading from file, try to map it into memory and
+         * reverse it directly from there
+         */
+
+        ret = rev_mmap(fileno(fin), out, jobs);
+    }
+
+#else /* HAVE_MMAP */
+
+    (void)jobs;
+
+#endif /* HAVE_MMAP */
+
+    if (ret == 1)
+    {
+        /* we read from stdin or file could not have been mapped,
+         * read data in blocks then
+         */
+
+        ret = rev_stream(fileno(fin), out);
+    }
+
+    return ret;
+}
+
+
+/* ==========================================================================
+                       __     __ _          ____
+        ____   __  __ / /_   / /(_)_____   / __/__  __ ____   _____ _____
+       / __ \ / / / // __ \ / // // ___/  / /_ / / / // __ \ / ___// ___/
+      / /_/ // /_/ // /_/ // // // /__   / __// /_/ // / / // /__ (__  )
+     / .___/ \__,_//_.___//_//_/ \___/  /_/   \__,_//_/ /_/ \___//____/
+    /_/
+   ========================================================================== */
+
+
+/* ==========================================================================
+    Reverses all lines from 'in' buffer of 'len' bytes, and stores them in
+    'out', which must be at least 'len' bytes long. 'out' may point to the
+    same memory as 'in', but they cannot partially overlap. New lines stay
+    where they were, so reversed data is always exactly 'len' bytes long,
+    and last line does not need to end with new line character.
+
+    Function does not touch stdio, nor allocate anything, and keeps no
+    state, so it can be called from many threads at once.
+
+    Returns 0 on success, or -1 when arguments are invalid.
+
+    errno:
+            EINVAL      in or out is NULL and len is not 0
+            EINVAL      flags are unknown, or both of them are set
+   ========================================================================== */
+
+
+int u3_rev
+(
+    const void      *in,     /* lines to reverse */
+    size_t           len,    /* length of in */
+    void            *out,    /* reversed lines will be stored here */
+    int              flags   /* U3_REV_UTF8 or U3_REV_GRAPHEME */
+)
+{
+    const char      *src;    /* current line in in */
+    const char      *end;    /* one byte past the last byte of in */
+    const char      *nl;     /* new line character in in */
+    char            *dst;    /* where current line goes in out */
+    enum rev_mode    mode;   /* how to reverse lines */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if ((len && (in == NULL || out == NULL)) ||
+        (flags & ~(U3_REV_UTF8 | U3_REV_GRAPHEME)) ||
+        flags == (U3_REV_UTF8 | U3_REV_GRAPHEME))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    mode = REV_MODE_BYTE;
+    mode = flags & U3_REV_UTF8 ? REV_MODE_CODEPOINT : mode;
+    mode = flags & U3_REV_GRAPHEME ? REV_MODE_GRAPHEME : mode;
+
+    src = in;
+    dst = out;
+    end = src + len;
+
+    while (src != end)
+    {
+        if ((nl = memchr(src, '\n', end - src)) == NULL)
+        {
+            nl = end;
+        }
+
+        if (mode == REV_MODE_BYTE || u3u_memascii(src, nl - src))
+        {
+            /* single bytes, line can be reversed straight into
+             * out, without copying it first
+             */
+
+            u3u_memrev(dst, src, nl - src);
+        }
+        else
+        {
+            if (dst != src)
+            {
+                memcpy(dst, src, nl - src);
+            }
+
+            rev_inplace_line(dst, nl - src, mode);
+        }
+
+        dst += nl - src;
+
+        if (nl != end)
+        {
+            *dst++ = '\n';
+            ++nl;
+        }
+
+        src = nl;
+    }
+
+    return 0;
 }
 
 
@@ -75,18 +3124,28 @@ int u3_rev_main
     char        *argv[]      /* program arguments */
 )
 {
-    const char  *file_path;  /* path to file to process */
-    size_t       line_size;  /* size of the line buffer */
-    size_t       line_pos;   /* data position in line buffer */
-    size_t       line_len;   /* length of string in line buffer */
+    char        *dash[] = { "-" };  /* files to use when none are passed */
+    char       **files;      /* paths to files to process */
+    const char  *arg;        /* argument of an option */
     FILE        *fin;        /* input file data will be read from */
+    FILE        *next;       /* next file, opened ahead of time */
+    int          nfiles;     /* number of elements in files */
+    int          next_err;   /* errno from opening next */
+    int          err;        /* errno of the first error */
+    int          failed;     /* some file could not be reversed */
     int          ret;        /* return code from the program */
-    size_t       i;          /* iterator */
+    int          i;          /* iterator */
+    long         jobs;       /* number of threads to use */
+    int          zcopy;      /* bypass stdio with gather output */
+    int          inplace;    /* reverse files in place */
+    struct rev_out out;      /* output buffer for reversed lines */
+
+#if REV_GATHER
+    struct rev_gather gather;  /* output for zcopy */
+#endif
 
-#if ENABLE_MALLOC
-    char        *line;       /* malloced buffer to hold single line */
-#else
-    char         line[U3_REV_LINE_MAX + 2]; /* buffer to hold single line */
+#if ENABLE_MALLOC == 0
+    char         outbuf[U3_REV_BUF_SIZE];   /* buffer for reversed lines */
 #endif
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
@@ -95,232 +3154,277 @@ int u3_rev_main
      */
 
     ret = 0;
-    file_path = NULL;
-    line_pos = 0;
+    out.mode = REV_MODE_BYTE;
+    jobs = 1;
+    zcopy = 0;
+    inplace = 0;
+
+    /* parse options, they all start with '-', first argument that does
+     * not (or is just "-") is the first file to process
+     */
 
-    if (argc == 2)
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i)
     {
-        /* exactly one argument has been passed
+        /* options cannot be grouped, only -j takes its argument
+         * right after it
          */
 
-        if (argv[1][0] == '-')
+        if (argv[i][1] != 'j' && argv[i][2] != '\0')
         {
-            switch (argv[1][1])
-            {
-            case 'v':
-                fprintf(stderr, "rev " U3_REV_VERSION "\n"
-                    "u3 " U3_VERSION "\n");
-                break;
+            fprintf(stderr, "e/invalid option %s\n", argv[i]);
+            print_help();
+            errno = EINVAL;
+            return U3_EXIT_FAILURE;
+        }
 
-            case 'h':
-                print_help();
-                break;
+        switch (argv[i][1])
+        {
+        case 'v':
+            fprintf(stderr, "rev " U3_REV_VERSION "\n"
+                "u3 " U3_VERSION "\n");
+            return 0;
 
-            default:
-                fprintf(stderr, "e/invalid option -%c\n", argv[1][1]);
-                print_help();
-                ret = U3_EXIT_FAILURE;
-                errno = EINVAL;
-            }
+        case 'h':
+            print_help();
+            return 0;
 
-            return ret;
-        }
+        case 'u':
+            out.mode = REV_MODE_CODEPOINT;
+            break;
 
-        /* argument does not start from '-' assuming it's file
-         */
+        case 'g':
+            out.mode = REV_MODE_GRAPHEME;
+            break;
 
-        file_path = argv[1];
-    }
-    else if (argc > 2)
-    {
-        print_help();
-        errno = EINVAL;
-        return U3_EXIT_FAILURE;
-    }
+        case 'z':
+            zcopy = 1;
+            break;
 
-    line_size = U3_REV_LINE_MAX + 2;
+        case 'i':
+            inplace = 1;
+            break;
 
-#if ENABLE_MALLOC
+        case 'j':
+            /* accept both "-j4" and "-j 4" forms
+             */
 
-    line = malloc(line_size);
+            arg = argv[i] + 2;
 
-    if (line == NULL)
-    {
-        perror("e/malloc()");
-        return U3_EXIT_FAILURE;
-    }
+            if (*arg == '\0')
+            {
+                if (++i == argc)
+                {
+                    fprintf(stderr, "e/option -j requires an argument\n");
+                    errno = EINVAL;
+                    return U3_EXIT_FAILURE;
+                }
+
+                arg = argv[i];
+            }
 
-#endif
+            if (u3u_get_number(arg, &jobs) != 0)
+            {
+                return U3_EXIT_FAILURE;
+            }
 
-    /* if file has been passed in argument use that as a source of data,
-     * otherwise use stdin which may be actual stdin or pipe
-     */
+            if (jobs < 1)
+            {
+                fprintf(stderr, "e/number of jobs must be positive\n");
+                errno = EINVAL;
+                return U3_EXIT_FAILURE;
+            }
 
-    fin = file_path ? fopen(file_path, "r") : stdin;
+            break;
 
-    if (fin == NULL)
-    {
-        perror("e/fopen()");
-        ret = U3_EXIT_FAILURE;
-        goto fopen_error;
+        default:
+            fprintf(stderr, "e/invalid option -%c\n", argv[i][1]);
+            print_help();
+            errno = EINVAL;
+            return U3_EXIT_FAILURE;
+        }
     }
 
-    for (;;)
-    {
-        /* set last byte of line buffer to something other than '\0'to know
-         * whether fgets overwrite it or not
-         */
+    /* all arguments left are files to process, in order, if there are
+     * none, use stdin which may be actual stdin or pipe
+     */
 
-        line[line_size - 1] = 0x7f;
+    files = argv + i;
+    nfiles = i < argc ? argc - i : 0;
+    err = 0;
+    failed = 0;
 
-        /* try to read whole line into the buffer
+    if (inplace)
+    {
+        /* nothing goes to stdout, files are modified directly
          */
 
-        if (fgets(line + line_pos, line_size - line_pos, fin) == NULL)
+        if (nfiles == 0)
         {
-            if (feof(fin))
-            {
-                /* end of file reached and no data has been read, we're done
-                 */
+            fprintf(stderr, "e/option -i requires a file\n");
+            errno = EINVAL;
+            return U3_EXIT_FAILURE;
+        }
 
-                break;
+        for (i = 0; i != nfiles; ++i)
+        {
+            if (rev_inplace(files[i], out.mode) != 0)
+            {
+                err = err ? err : errno;
+                failed = 1;
             }
-
-            perror("e/error reading input file");
-            ret = U3_EXIT_FAILURE;
-            goto error;
         }
 
-        if (line[line_size - 1] == '\0' && line[line_size - 2] != '\n')
-        {
-            /* fgets did overwrite last byte with '\0' which means it filled
-             * whole line buffer
-             *
-             * and
-             *
-             * last character in string is not new * line
-             */
+        errno = err;
+        return failed ? U3_EXIT_FAILURE : 0;
+    }
 
-#if ENABLE_MALLOC
+    if (nfiles == 0)
+    {
+        files = dash;
+        nfiles = 1;
+    }
 
-            char *new_line;
-            /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#if REV_GATHER
 
+    out.gather = NULL;
 
-            /* but nothing is lost yet, malloc is enabled to we can alocate
-             * more memory to satisfy that long line. In previous malloc
-             * we added +2 to line_size for '\n' and '\0' characters and
-             * now we want to double the line_size buffer, so we subtract
-             * 2, then double the size and at the end add 2 bytes again.
-             */
+    if (zcopy)
+    {
+        /* we write directly to file descriptor, so whatever stdio
+         * has buffered must go first
+         */
 
-            line_size -= 2;
-            line_size *= 2;
-            line_size += 2;
-            new_line = realloc(line, line_size);
+        fflush(stdout);
 
-            if (new_line == NULL)
-            {
-                perror("e/realloc()");
-                goto error;
-            }
+        if (rev_gather_init(&gather, &out, fileno(stdout)) != 0)
+        {
+            return U3_EXIT_FAILURE;
+        }
+    }
 
-            /* reallocation successful, update line with new pointer and
-             * set line_pos to point to next free byte in line.
-             */
+#else /* REV_GATHER */
 
-            line = new_line;
-            line_pos = line_size / 2;
-            continue;
+    /* no mmap() for gather ring, stdio will have to do
+     */
 
-#else /* ENABLE_MALLOC */
+    zcopy = 0;
 
-            /* malloc is not used so we cannot increase buffer, that means
-             * error
-             */
+#endif /* REV_GATHER */
 
-            fprintf(stderr, "e/line is longer than %ld, aborting\n",
-                (long)(line_size - 2));
-            errno = ENOBUFS;
-            ret = U3_EXIT_FAILURE;
-            goto error;
+    if (zcopy == 0)
+    {
+#if ENABLE_MALLOC
 
-#endif /* ENABLE_MALLOC */
+        out.buf = malloc(U3_REV_BUF_SIZE);
 
+        if (out.buf == NULL)
+        {
+            perror("e/malloc()");
+            return U3_EXIT_FAILURE;
         }
 
-        /* now we have full line in line buffer, do the reverse
-        */
+#else /* ENABLE_MALLOC */
+
+        out.buf = outbuf;
+
+#endif /* ENABLE_MALLOC */
+
+        out.size = U3_REV_BUF_SIZE;
+        out.pos = 0;
+    }
+
+    next = rev_open(files[0]);
+    next_err = errno;
 
-        line_len = strlen(line);
+    for (i = 0; i != nfiles; ++i)
+    {
+        fin = next;
+        next = NULL;
+        errno = next_err;
 
-        if (line[line_len - 1] == '\n')
+        if (i + 1 != nfiles)
         {
-            /* last character of the line is a newline, we don't include it
-             * in reversing, so decrement line_len by one.
+            /* open next file now, so kernel can read it in while
+             * we are reversing current one
              */
 
-            --line_len;
+            next = rev_open(files[i + 1]);
+            next_err = errno;
         }
 
-        if (line_len == 0)
+        if (fin == NULL)
         {
-            /* it appears current line contains only new line character,
-             * nothing to swap/
+            /* file cannot be opened, report it and go on with the
+             * rest of them
              */
 
-            if (fputs("\n", stdout) == EOF)
-            {
-                perror("e/fputs()");
-                ret = U3_EXIT_FAILURE;
-                goto error;
-            }
-
+            err = err ? err : errno;
+            perror("e/fopen()");
+            failed = 1;
             continue;
         }
 
-        for (i = 0, --line_len; i < line_len; ++i, --line_len)
+        ret = rev_file(fin, &out, jobs);
+        err = ret == 0 || err ? err : errno;
+
+        if (fin != stdin)
         {
-            /* standard swap with the help of XOR magic
-            */
+            /* close only if fin is not stdin,  we don't want to close
+             * stdin in case standalone is not enabled - we could cause
+             * next read of stdin to fail
+             */
 
-            line[i] ^= line[line_len];
-            line[line_len] ^= line[i];
-            line[i] ^= line[line_len];
+            fclose(fin);
         }
 
-        /* print line to stdout, if newline was in line, it will be printed
-         * as last character, since we didn't swap it
-         */
-
-        if (fputs(line, stdout) == EOF)
+        if (ret != 0)
         {
-            perror("e/fputs()");
-            ret = U3_EXIT_FAILURE;
-            goto error;
+            break;
         }
+    }
+
+    if (next && next != stdin)
+    {
+        fclose(next);
+    }
 
-        line_pos = 0;
+    if (ret == 0)
+    {
+        /* send to stdout whatever is left in output buffer
+         */
+
+        ret = rev_sync(&out);
+        err = ret == 0 || err ? err : errno;
     }
 
     fflush(stdout);
+    ret = ret == 0 && failed == 0 ? 0 : U3_EXIT_FAILURE;
 
-error:
-    if (file_path)
+#if REV_GATHER
+    if (zcopy)
     {
-        /* close only if fin is not stdin,  we don't want to close stdin
-         * in case standalone is not enabled - we could cause next read
-         * of stdin to fail
+        /* pages that are still in the pipe are referenced by the
+         * kernel, so unmapping them does not change what reader gets
          */
 
-        fclose(fin);
+        munmap(gather.ring, gather.bsize * REV_GATHER_BLOCKS);
     }
-
-fopen_error:
+#endif
 
 #if ENABLE_MALLOC
-    free(line);
+    if (zcopy == 0)
+    {
+        free(out.buf);
+    }
 #endif
 
+    if (ret != 0 && err)
+    {
+        /* let caller know what went wrong first
+         */
+
+        errno = err;
+    }
+
     return ret;
 }
@@ -22,10 +22,25 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* multiple threads print chunks of range, and each of them needs its
+ * own buffer for printed numbers
+ */
+
+#if ENABLE_THREADS && ENABLE_MALLOC
+#   define SEQ_JOBS 1
+#   include <pthread.h>
+#else
+#   define SEQ_JOBS 0
+#endif
 
 #include "u3.h"
 #include "u3defs.h"
@@ -33,28 +48,2603 @@
 
 
 /* ==========================================================================
-               ____                     __   _
-              / __/__  __ ____   _____ / /_ (_)____   ____   _____
-             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
-            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
-           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+                          __
+                         / /_ __  __ ____   ___   _____
+                        / __// / / // __ \ / _ \ / ___/
+                       / /_ / /_/ // /_/ //  __/(__  )
+                       \__/ \__, // .___/ \___//____/
+                           /____//_/
+   ========================================================================== */
+
+
+/* enough digits for magnitude of any long, in any radix
+ */
+
+#define SEQ_DIGITS_MAX 64
+
+/* longest text that can be printed before or after number, and
+ * longest separator between numbers
+ */
+
+#define SEQ_LIT_MAX 64
+
+/* widest number field that format can ask for
+ */
+
+#define SEQ_FIELD_MAX 64
+
+/* max size of printed number, with text around it and separator
+ */
+
+#define SEQ_REC_MAX (3 * SEQ_LIT_MAX + SEQ_FIELD_MAX)
+
+/* with increment 1 (or -1) numbers are printed in blocks, which only
+ * differ on last few digits, block has at most that many numbers
+ */
+
+#define SEQ_BLOCK_MAX 256
+
+/* number of rounds of feistel network that shuffles numbers
+ */
+
+#define SEQ_SHUF_ROUNDS 4
+
+/* what to print when only size of output is queried
+ */
+
+#define SEQ_QUERY_BYTES 0x01  /* number of bytes that would be printed */
+#define SEQ_QUERY_COUNT 0x02  /* number of numbers that would be printed */
+
+
+/* format compiled into what is printed around digits of each number,
+ * so numbers are printed with few copies and no printf() is called
+ */
+
+struct seq_fmt
+{
+    char           pre[SEQ_LIT_MAX];  /* text before number */
+    size_t         npre;              /* length of pre */
+    char           tail[2 * SEQ_LIT_MAX]; /* text after number, and sep */
+    size_t         ntail;             /* length of tail */
+    char           end[SEQ_LIT_MAX + 1]; /* text after last number */
+    size_t         nend;              /* length of end */
+    char           sign;     /* printed before non-negative number, or 0 */
+    char           pad;      /* pads number to width, '0' or ' ' */
+    int            left;     /* number is padded on the right */
+    size_t         width;    /* min width of number with sign and pad */
+    size_t         rec_max;  /* longest number printed with this format */
+    unsigned       base;     /* radix of printed numbers */
+    const char    *xdigits;  /* characters of digits in radix */
+    unsigned long  block;    /* numbers in block, base^bdigits */
+    size_t         bdigits;  /* last digits that change within block */
+    size_t         bin;      /* size of binary number, 0 prints text */
+    int            be;       /* binary number is big endian */
+    intmax_t       min;      /* smallest value binary number holds */
+    intmax_t       max;      /* biggest value binary number holds */
+};
+
+
+/* current number kept as string of digits in radix of output, so that
+ * it can be copied to output as is, and incremented digit by digit
+ */
+
+struct seq_ctr
+{
+    char           digits[SEQ_DIGITS_MAX]; /* right aligned magnitude */
+    size_t         ndigits;  /* number of used digits, rest is '0' */
+    long           value;    /* number digits represent */
+    unsigned       base;     /* radix of digits */
+    const char    *xdigits;  /* characters of digits in radix */
+};
+
+
+/* keyed permutation of indexes of whole sequence, index is permuted with
+ * feistel network over smallest domain of even number of bits that
+ * holds all of them, and again until it falls into sequence (cycle
+ * walking), so nothing has to be stored
+ */
+
+struct seq_shuf
+{
+    long           first;    /* first number of whole sequence */
+    long           inc;      /* increment between numbers */
+    unsigned long  count;    /* number of numbers in whole sequence */
+    uint64_t       keys[SEQ_SHUF_ROUNDS]; /* key for each round */
+    uint64_t       mask;     /* mask of half of index */
+    unsigned       half;     /* number of bits in half of index */
+};
+
+
+/* generates numbers into buffers, it can be stopped when buffer is full
+ * and resumed later with another buffer
+ */
+
+struct seq_gen
+{
+    const struct seq_fmt *fmt; /* how to print numbers */
+    const struct seq_shuf *shuf; /* permutation of numbers, or NULL */
+    unsigned long  pos;      /* position of next number in permutation */
+    int            end;      /* last number ends whole output */
+    struct seq_ctr ctr;      /* number to print next */
+    long           inc;      /* increment between numbers */
+    unsigned char  incd[SEQ_DIGITS_MAX]; /* magnitude of inc, as values */
+    size_t         nincd;    /* number of used digits in incd */
+    unsigned long  left;     /* numbers left to print, ctr included */
+    char           tmpl[SEQ_BLOCK_MAX * SEQ_REC_MAX]; /* block of numbers */
+    size_t         tmpl_ndigits; /* ndigits tmpl was built for, or 0 */
+    int            tmpl_neg;     /* tmpl was built for negative numbers */
+};
+
+
+#if SEQ_JOBS
+
+/* part of the range printed by single thread
+ */
+
+struct seq_chunk
+{
+    struct seq_gen  gen;   /* generator for numbers of this chunk */
+    char           *buf;   /* buffer with printed numbers */
+    size_t          len;   /* number of bytes in buf */
+    int             done;  /* chunk is printed and can be written */
+};
+
+
+/* chunks are queued in ring of 'nchunks' elements, and threads take
+ * them in order they were queued
+ */
+
+struct seq_pool
+{
+    pthread_mutex_t    lock;     /* protects all fields below */
+    pthread_cond_t     work;     /* signaled when chunk is queued */
+    pthread_cond_t     done;     /* signaled when chunk is printed */
+    struct seq_chunk  *chunks;   /* ring of chunks */
+    size_t             nchunks;  /* number of elements in chunks */
+    size_t             size;     /* size of buffer of each chunk */
+    unsigned long      queued;   /* number of chunks queued so far */
+    unsigned long      taken;    /* number of chunks taken by threads */
+    int                stop;     /* tells threads to exit */
+};
+
+
+/* threads writing directly to file take chunks from here, every one
+ * of them knows where it goes in file, so there is no ordering
+ */
+
+struct seq_fpool
+{
+    pthread_mutex_t    lock;     /* protects all fields below */
+    const struct seq_fmt *fmt;   /* how to print numbers */
+    const struct seq_shuf *shuf; /* permutation of numbers, or NULL */
+    unsigned long      pos;      /* position of first number in shuf */
+    int                end;      /* last number ends whole output */
+    unsigned long      nums;     /* numbers in single chunk */
+    long               first;    /* first number of the sequence */
+    long               inc;      /* increment between numbers */
+    unsigned long      count;    /* number of numbers in sequence */
+    unsigned long      next;     /* index of first number of next chunk */
+    int                fd;       /* file to write numbers to */
+    int                err;      /* errno of first error, or 0 */
+};
+
+#endif /* SEQ_JOBS */
+
+
+/* state of u3_seq_fill() iterator, kept in caller's struct u3_seq
+ */
+
+struct seq_iter
+{
+    struct seq_fmt  fmt;   /* how to print numbers */
+    struct seq_gen  gen;   /* generator of numbers */
+};
+
+
+/* struct u3_seq must be able to hold whole iterator, compilation
+ * fails here when it cannot
+ */
+
+typedef char seq_iter_fits[sizeof(struct seq_iter) <= U3_SEQ_SIZE ? 1 : -1];
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ========================================================================== */
+
+
+static void print_help(void)
+{
+    fprintf(stderr,
+        "usage: seq <last>\n"
+        "       seq <first> <last>\n"
+        "       seq <first> <increment> <last>\n"
+        "\n"
+        "Prints number from <first> to <last> in steps of <increment>\n"
+        "\n"
+        "* if <first> or <increment> is not defined, it will be set to 1\n"
+        "* <fist>, <increment> and <last> are all of type \"long int\"\n"
+        "* possible values are (-LONG_MAX, LONG_MAX)\n"
+        "* numbers can end with K, M, G, T (powers of 1000) or Ki, Mi, Gi,\n"
+        "  Ti (powers of 1024), like 10K or 4Mi\n"
+        "\n"
+        "options, they must be passed before numbers\n"
+        "\t-h             prints this help and exits\n"
+        "\t-v             prints version and exits\n"
+        "\t-j <jobs>      print numbers with <jobs> threads\n"
+        "\t-o <file>      write numbers to <file> instead of stdout\n"
+        "\t-f <format>    printf() like format with single %%d conversion\n"
+        "\t-s <sep>       separate numbers with <sep> instead of new line\n"
+        "\t-w             pad numbers with zeros to equal width\n"
+        "\t--radix <r>    print numbers in radix 16, 10, 8 or 2, format\n"
+        "\t               can do that too with %%x, %%X, %%o or %%b\n"
+        "\t--bytes        only print how many bytes would be printed\n"
+        "\t--count        only print how many numbers would be printed\n"
+        "\t--shard <K/N>  print only K-th of N parts of similar size\n"
+        "\t--shuffle[=<seed>]\n"
+        "\t               print numbers in random order, which is always\n"
+        "\t               the same for the same <seed>\n"
+        "\t--binary <type>\n"
+        "\t               print raw binary numbers of <type>, one of\n"
+        "\t               i32le, i32be, u32le, u32be, i64le, i64be\n"
+    );
+}
+
+
+/* ==========================================================================
+    Checks if 'arg' is long option 'name', with or without "=value".
+   ========================================================================== */
+
+
+static int seq_is_opt
+(
+    const char  *arg,    /* argument to check */
+    const char  *name    /* name of long option, with "--" */
+)
+{
+    size_t       len;    /* length of name */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    len = strlen(name);
+    return strncmp(arg, name, len) == 0 &&
+        (arg[len] == '\0' || arg[len] == '=');
+}
+
+
+/* ==========================================================================
+    Returns argument of option at 'i' in 'argv', which is either glued
+    to option ("-j4", "--shard=1/4") or is next argument ("-j 4",
+    "--shard 1/4"), in which case 'i' is moved to it. Returns NULL when
+    there is no argument.
+   ========================================================================== */
+
+
+static const char *seq_optarg
+(
+    int          argc,   /* number of arguments in argv */
+    char        *argv[], /* program arguments */
+    int         *i       /* index of option in argv */
+)
+{
+    const char  *eq;     /* '=' in long option */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (argv[*i][1] == '-' && (eq = strchr(argv[*i], '=')) != NULL)
+    {
+        return eq + 1;
+    }
+
+    if (argv[*i][1] != '-' && argv[*i][2] != '\0')
+    {
+        return argv[*i] + 2;
+    }
+
+    if (*i + 1 == argc)
+    {
+        fprintf(stderr, "e/option %s requires an argument\n", argv[*i]);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return argv[++*i];
+}
+
+
+/* ==========================================================================
+    Converts 'num' argument, which can have multiplier suffix like "10K",
+    into 'n'. LONG_MIN and LONG_MAX are parsed fine, but sequence cannot
+    use them, as it needs one number of headroom on both ends.
+
+    errno:
+            EINVAL      num is empty or is not a number
+            ERANGE      num does not fit in (LONG_MIN, LONG_MAX)
+   ========================================================================== */
+
+
+static int seq_get_number
+(
+    const char  *num,  /* string to convert to number */
+    long        *n     /* converted num will be placed here */
+)
+{
+    if (u3u_get_count(num, n) != 0)
+    {
+        return -1;
+    }
+
+    if (*n == LONG_MAX || *n == LONG_MIN)
+    {
+        fprintf(stderr, "e/number is out of range: '%s'\n", num);
+        errno = ERANGE;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Compiles printf() like 'format' and separator 'sep' into 'fmt'.
+    Format must contain exactly one "%d" (or "%i") conversion, or "%x",
+    "%X", "%o" or "%b" to print number in radix 16, 8 or 2. Conversion
+    can have '-', '+', ' ' and '0' flags, width and 'l' modifier.
+    "%%" prints '%'. Text before and after the number, and separator,
+    are precomputed, so printing number is only a matter of copying them
+    around digits.
+
+    errno:
+            EINVAL      format is invalid or any part of it is too long
+   ========================================================================== */
+
+
+static int seq_fmt_init
+(
+    struct seq_fmt  *fmt,     /* compiled format */
+    const char      *format,  /* printf() like format */
+    const char      *sep      /* separator between numbers */
+)
+{
+    const char      *f;       /* current character of format */
+    size_t           i;       /* iterator */
+    char            *lit;     /* where literal text goes */
+    size_t          *nlit;    /* length of literal text */
+    size_t           nsep;    /* length of separator */
+    int              conv;    /* number of conversions found */
+    int              zero;    /* '0' flag was found */
+    unsigned long    n;       /* biggest number in radix */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    memset(fmt, 0, sizeof(*fmt));
+    lit = fmt->pre;
+    nlit = &fmt->npre;
+    conv = 0;
+    zero = 0;
+
+    for (f = format; *f != '\0'; ++f)
+    {
+        if (*f != '%' || f[1] == '%')
+        {
+            if (*nlit == SEQ_LIT_MAX)
+            {
+                fprintf(stderr, "e/format '%s' is too long\n", format);
+                errno = EINVAL;
+                return -1;
+            }
+
+            lit[(*nlit)++] = *f;
+            f += *f == '%';
+            continue;
+        }
+
+        if (conv++)
+        {
+            break;
+        }
+
+        for (++f; *f != '\0' && strchr("-+ 0", *f) != NULL; ++f)
+        {
+            fmt->left |= *f == '-';
+            zero |= *f == '0';
+
+            if (*f == '+' || (*f == ' ' && fmt->sign == '\0'))
+            {
+                /* '+' wins over ' ' no matter the order
+                 */
+
+                fmt->sign = *f;
+            }
+        }
+
+        for (; *f >= '0' && *f <= '9'; ++f)
+        {
+            fmt->width = fmt->width * 10 + *f - '0';
+
+            if (fmt->width > SEQ_FIELD_MAX)
+            {
+                fprintf(stderr, "e/format '%s' is too long\n", format);
+                errno = EINVAL;
+                return -1;
+            }
+        }
+
+        f += *f == 'l';
+        fmt->xdigits = *f == 'X' ? "0123456789ABCDEF" : "0123456789abcdef";
+
+        switch (*f)
+        {
+        case 'd':
+        case 'i':
+            fmt->base = 10;
+            break;
+
+        case 'x':
+        case 'X':
+            fmt->base = 16;
+            break;
+
+        case 'o':
+            fmt->base = 8;
+            break;
+
+        case 'b':
+            fmt->base = 2;
+            break;
+
+        default:
+            conv = 0;
+        }
+
+        if (conv == 0)
+        {
+            break;
+        }
+
+        /* what follows number goes to tail
+         */
+
+        lit = fmt->tail;
+        nlit = &fmt->ntail;
+    }
+
+    if (conv != 1 || *f != '\0')
+    {
+        fprintf(stderr, "e/invalid format '%s', expected single %%d\n",
+            format);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((nsep = strlen(sep)) > SEQ_LIT_MAX)
+    {
+        fprintf(stderr, "e/separator '%s' is too long\n", sep);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* last number is not followed by separator, but by new line
+     */
+
+    memcpy(fmt->end, fmt->tail, fmt->ntail);
+    fmt->end[fmt->ntail] = '\n';
+    fmt->nend = fmt->ntail + 1;
+    memcpy(fmt->tail + fmt->ntail, sep, nsep);
+    fmt->ntail += nsep;
+
+    fmt->pad = zero && fmt->left == 0 ? '0' : ' ';
+
+    /* numbers of block differ on last two digits, or on more of
+     * them when radix is small, so block is not too short
+     */
+
+    fmt->bdigits = fmt->base == 2 ? 7 : 2;
+
+    for (i = 0, fmt->block = 1; i != fmt->bdigits; ++i)
+    {
+        fmt->block *= fmt->base;
+    }
+
+    /* longest number has sign and as many digits as LONG_MAX
+     */
+
+    for (n = LONG_MAX, i = 1; n; n /= fmt->base)
+    {
+        ++i;
+    }
+
+    fmt->rec_max = fmt->npre + (fmt->width > i ? fmt->width : i) +
+        (fmt->ntail > fmt->nend ? fmt->ntail : fmt->nend);
+    return 0;
+}
+
+
+/* ==========================================================================
+    Sets up 'fmt' to print numbers as raw binary integers of 'type',
+    which is one of "i32le", "i32be", "u32le", "u32be", "i64le" or
+    "i64be". Numbers are stored one after another, with no separator.
+
+    errno:
+            EINVAL      type is invalid
+   ========================================================================== */
+
+
+static int seq_fmt_bin
+(
+    struct seq_fmt  *fmt,    /* format to set up */
+    const char      *type    /* type of binary numbers */
+)
+{
+    static const struct
+    {
+        const char  *name;   /* name of type */
+        size_t       size;   /* size of number in bytes */
+        int          be;     /* number is big endian */
+        intmax_t     min;    /* smallest value of type */
+        intmax_t     max;    /* biggest value of type */
+    }
+    types[] =
+    {
+        { "i32le", 4, 0, INT32_MIN, INT32_MAX },
+        { "i32be", 4, 1, INT32_MIN, INT32_MAX },
+        { "u32le", 4, 0, 0, UINT32_MAX },
+        { "u32be", 4, 1, 0, UINT32_MAX },
+        { "i64le", 8, 0, INT64_MIN, INT64_MAX },
+        { "i64be", 8, 1, INT64_MIN, INT64_MAX }
+    };
+
+    size_t           i;      /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(types) / sizeof(*types); ++i)
+    {
+        if (strcmp(type, types[i].name) == 0)
+        {
+            memset(fmt, 0, sizeof(*fmt));
+            fmt->bin = types[i].size;
+            fmt->be = types[i].be;
+            fmt->min = types[i].min;
+            fmt->max = types[i].max;
+            fmt->rec_max = fmt->bin;
+
+            /* numbers are never converted to text, but generator
+             * still initializes its counter, and chunks are still
+             * multiple of block
+             */
+
+            fmt->base = 10;
+            fmt->xdigits = "0123456789";
+            fmt->block = 1;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "e/invalid binary type '%s', expected i32le, i32be, "
+        "u32le, u32be, i64le or i64be\n", type);
+    errno = EINVAL;
+    return -1;
+}
+
+
+/* ==========================================================================
+    Returns value of digit 'c', which is one of "0123456789abcdef", in
+    lower or upper case.
+   ========================================================================== */
+
+
+static unsigned seq_xval
+(
+    char  c      /* digit to return value of */
+)
+{
+    return c <= '9' ? (unsigned)(c - '0') : (unsigned)((c | 0x20) - 'a' + 10);
+}
+
+
+/* ==========================================================================
+    Sets counter 'ctr' to 'value', with digits in radix of 'fmt'. This
+    is the only place where number is converted from binary, further
+    numbers are computed on digits. Digits of radix that is power of 2
+    are just looked up for each group of bits.
+   ========================================================================== */
+
+
+static void seq_ctr_set
+(
+    struct seq_ctr        *ctr,    /* counter to set */
+    const struct seq_fmt  *fmt,    /* format with radix of digits */
+    long                   value   /* value to set counter to */
+)
+{
+    unsigned long          mag;    /* magnitude of value */
+    unsigned               shift;  /* bits in single digit */
+    size_t                 i;      /* index of digit being set */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    memset(ctr->digits, '0', sizeof(ctr->digits));
+    mag = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    i = SEQ_DIGITS_MAX;
+
+    if (fmt->base == 10)
+    {
+        do
+        {
+            ctr->digits[--i] = '0' + mag % 10;
+            mag /= 10;
+        }
+        while (mag);
+    }
+    else
+    {
+        shift = fmt->base == 16 ? 4 : fmt->base == 8 ? 3 : 1;
+
+        do
+        {
+            ctr->digits[--i] = fmt->xdigits[mag & (fmt->base - 1)];
+            mag >>= shift;
+        }
+        while (mag);
+    }
+
+    ctr->ndigits = SEQ_DIGITS_MAX - i;
+    ctr->value = value;
+    ctr->base = fmt->base;
+    ctr->xdigits = fmt->xdigits;
+}
+
+
+/* ==========================================================================
+    Adds 'nincd' digits of 'incd' to magnitude of 'ctr'. Carry usually
+    stops after a digit or two, so this is way cheaper than converting
+    whole number from binary each time. Digits of radix up to 10 are
+    consecutive characters, so these are added directly, only radix 16
+    needs to look up values of digits.
+   ========================================================================== */
+
+
+static void seq_ctr_add
+(
+    struct seq_ctr       *ctr,    /* counter to add to */
+    const unsigned char  *incd,   /* right aligned digits to add */
+    size_t                nincd   /* number of digits in incd */
+)
+{
+    char                 *d;      /* digit being added to */
+    const unsigned char  *a;      /* digit being added */
+    unsigned              v;      /* value of digit after addition */
+    unsigned              carry;  /* carry to next digit */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = ctr->digits + SEQ_DIGITS_MAX;
+    a = incd + SEQ_DIGITS_MAX;
+    carry = 0;
+
+    if (ctr->base <= 10)
+    {
+        while (nincd--)
+        {
+            v = *--d + *--a + carry;
+            carry = v >= '0' + ctr->base;
+            *d = carry ? v - ctr->base : v;
+        }
+
+        while (carry)
+        {
+            v = *--d + 1;
+            carry = v == '0' + ctr->base;
+            *d = carry ? '0' : v;
+        }
+    }
+    else
+    {
+        while (nincd--)
+        {
+            v = seq_xval(*--d) + *--a + carry;
+            carry = v >= ctr->base;
+            *d = ctr->xdigits[carry ? v - ctr->base : v];
+        }
+
+        while (carry)
+        {
+            v = seq_xval(*--d) + 1;
+            carry = v == ctr->base;
+            *d = ctr->xdigits[carry ? 0 : v];
+        }
+    }
+
+    if ((size_t)(ctr->digits + SEQ_DIGITS_MAX - d) > ctr->ndigits)
+    {
+        ctr->ndigits = ctr->digits + SEQ_DIGITS_MAX - d;
+    }
+}
+
+
+/* ==========================================================================
+    Subtracts 'nincd' digits of 'incd' from magnitude of 'ctr'. Magnitude
+    must be bigger than subtracted number. Like in seq_ctr_add(), only
+    radix 16 needs to look up values of digits.
+   ========================================================================== */
+
+
+static void seq_ctr_sub
+(
+    struct seq_ctr       *ctr,    /* counter to subtract from */
+    const unsigned char  *incd,   /* right aligned digits to subtract */
+    size_t                nincd   /* number of digits in incd */
+)
+{
+    char                 *d;      /* digit being subtracted from */
+    const unsigned char  *a;      /* digit being subtracted */
+    unsigned              v;      /* value of digit after subtraction */
+    unsigned              borrow; /* borrow from next digit */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    d = ctr->digits + SEQ_DIGITS_MAX;
+    a = incd + SEQ_DIGITS_MAX;
+    borrow = 0;
+
+    if (ctr->base <= 10)
+    {
+        while (nincd--)
+        {
+            v = *--d + ctr->base - *--a - borrow;
+            borrow = v < '0' + ctr->base;
+            *d = borrow ? v : v - ctr->base;
+        }
+
+        while (borrow)
+        {
+            borrow = *--d == '0';
+            *d = borrow ? ctr->xdigits[ctr->base - 1] : *d - 1;
+        }
+    }
+    else
+    {
+        while (nincd--)
+        {
+            v = seq_xval(*--d) + ctr->base - *--a - borrow;
+            borrow = v < ctr->base;
+            *d = ctr->xdigits[borrow ? v : v - ctr->base];
+        }
+
+        while (borrow)
+        {
+            borrow = *--d == '0';
+            *d = ctr->xdigits[borrow ? ctr->base - 1 : seq_xval(*d) - 1];
+        }
+    }
+
+    /* leading digits that dropped to 0 are no longer used
+     */
+
+    d = ctr->digits + SEQ_DIGITS_MAX - ctr->ndigits;
+
+    while (*d == '0')
+    {
+        ++d;
+        --ctr->ndigits;
+    }
+}
+
+
+/* ==========================================================================
+    Moves generator 'g' to next number. When number crosses (or touches)
+    zero, sign changes and digits are simply converted again, otherwise
+    increment is added or subtracted from magnitude.
+   ========================================================================== */
+
+
+static void seq_step
+(
+    struct seq_gen  *g       /* generator to step */
+)
+{
+    long             value;  /* current number */
+    long             next;   /* number after step */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    value = g->ctr.value;
+    next = value + g->inc;
+
+    if (value == 0 || next == 0 || (value < 0) != (next < 0))
+    {
+        seq_ctr_set(&g->ctr, g->fmt, next);
+        return;
+    }
+
+    if ((value > 0) == (g->inc > 0))
+    {
+        seq_ctr_add(&g->ctr, g->incd, g->nincd);
+    }
+    else
+    {
+        seq_ctr_sub(&g->ctr, g->incd, g->nincd);
+    }
+
+    g->ctr.value = next;
+}
+
+
+/* ==========================================================================
+    Returns how many numbers there are from 'first' to 'last' in steps
+    of 'inc', 0 when 'last' cannot be reached.
+   ========================================================================== */
+
+
+static unsigned long seq_count
+(
+    long            first,  /* first number to print */
+    long            inc,    /* increment, cannot be 0 */
+    long            last    /* last number to print */
+)
+{
+    unsigned long   mag;    /* magnitude of inc */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mag = inc < 0 ? 0UL - (unsigned long)inc : (unsigned long)inc;
+
+    if (inc > 0 && first <= last)
+    {
+        return ((unsigned long)last - (unsigned long)first) / mag + 1;
+    }
+
+    if (inc < 0 && first >= last)
+    {
+        return ((unsigned long)first - (unsigned long)last) / mag + 1;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Returns how many of 'count' numbers, starting from 'first' in steps
+    of 'inc', are bigger or equal to 't', which must be positive and
+    not bigger than LONG_MAX.
+   ========================================================================== */
+
+
+static unsigned long seq_count_ge
+(
+    long            first,  /* first number of sequence */
+    long            inc,    /* increment, cannot be 0 */
+    unsigned long   count,  /* number of numbers in sequence */
+    unsigned long   t       /* threshold to check numbers against */
+)
+{
+    unsigned long   mag;    /* magnitude of inc */
+    unsigned long   gap;    /* distance between first and t */
+    unsigned long   k;      /* index of first (or last) number >= t */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mag = inc < 0 ? 0UL - (unsigned long)inc : (unsigned long)inc;
+
+    if (first >= 0 && (unsigned long)first >= t)
+    {
+        /* first number is already there, when going up all are,
+         * when going down only those before crossing t
+         */
+
+        if (inc > 0)
+        {
+            return count;
+        }
+
+        k = ((unsigned long)first - t) / mag + 1;
+        return k < count ? k : count;
+    }
+
+    if (inc < 0)
+    {
+        /* starts below t and goes down, never gets there
+         */
+
+        return 0;
+    }
+
+    gap = t - (unsigned long)first;
+    k = gap / mag + (gap % mag != 0);
+    return k < count ? count - k : 0;
+}
+
+
+/* ==========================================================================
+    Returns length of number printed with 'fmt', that is negative when
+    'neg' is set, and has 'ndigits' digits. Number is followed by
+    separator.
+   ========================================================================== */
+
+
+static size_t seq_reclen
+(
+    const struct seq_fmt  *fmt,     /* format number is printed with */
+    int                    neg,     /* number is negative */
+    size_t                 ndigits  /* number of digits in number */
+)
+{
+    size_t                 field;   /* length of number with sign */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    field = (neg || fmt->sign ? 1 : 0) + ndigits;
+    field = field > fmt->width ? field : fmt->width;
+    return fmt->npre + field + fmt->ntail;
+}
+
+
+/* ==========================================================================
+    Computes exact number of bytes, that 'count' numbers starting from
+    'first' in steps of 'inc' take when printed with 'fmt', without
+    printing them. Every number is counted with separator after it.
+    Numbers are grouped by sign and number of digits, and size of each
+    group is computed with seq_count_ge(). Result is stored in 'size'.
+
+    errno:
+            EFBIG       size does not fit in uintmax_t
+   ========================================================================== */
+
+
+static int seq_size
+(
+    const struct seq_fmt *fmt, /* format numbers are printed with */
+    long            first,  /* first number of sequence */
+    long            inc,    /* increment, cannot be 0 */
+    unsigned long   count,  /* number of numbers in sequence */
+    uintmax_t      *size    /* size of printed numbers */
+)
+{
+    unsigned long   prev[2];  /* numbers >= base^(d-1), by sign */
+    unsigned long   cur[2];   /* numbers >= base^d, by sign */
+    unsigned long   t;        /* base^d */
+    uintmax_t       len;      /* length of number in group */
+    size_t          d;        /* number of digits of group */
+    int             neg;      /* sign of group */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* negative numbers are counted on mirrored sequence, 0 has
+     * single digit, so it goes together with positive numbers
+     */
+
+    if (fmt->bin)
+    {
+        /* binary numbers are all the same size
+         */
+
+        if (count > UINTMAX_MAX / fmt->bin)
+        {
+            errno = EFBIG;
+            return -1;
+        }
+
+        *size = (uintmax_t)count * fmt->bin;
+        return 0;
+    }
+
+    prev[1] = seq_count_ge(-first, -inc, count, 1);
+    prev[0] = count - prev[1];
+    *size = 0;
+    t = fmt->base;
+
+    for (d = 1; d != SEQ_DIGITS_MAX && (prev[0] || prev[1]); ++d)
+    {
+        cur[0] = t ? seq_count_ge(first, inc, count, t) : 0;
+        cur[1] = t ? seq_count_ge(-first, -inc, count, t) : 0;
+        t = t && t <= LONG_MAX / fmt->base ? t * fmt->base : 0;
+
+        for (neg = 0; neg != 2; ++neg)
+        {
+            len = seq_reclen(fmt, neg, d);
+
+            if (prev[neg] - cur[neg] > (UINTMAX_MAX - *size) / len)
+            {
+                errno = EFBIG;
+                return -1;
+            }
+
+            *size += (prev[neg] - cur[neg]) * len;
+            prev[neg] = cur[neg];
+        }
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Returns 'idx'th number (counting from 0) of sequence starting from
+    'first' in steps of 'inc'. Number must be in range of long, but
+    computation is done on unsigned, so 'idx * inc' may overflow.
+   ========================================================================== */
+
+
+static long seq_nth
+(
+    long           first,  /* first number of sequence */
+    long           inc,    /* increment */
+    unsigned long  idx     /* index of number to return */
+)
+{
+    return (long)((unsigned long)first + idx * (unsigned long)inc);
+}
+
+
+/* ==========================================================================
+    Returns length of 'value' printed in radix 'base', with sign.
+   ========================================================================== */
+
+
+static int seq_width
+(
+    long           value,  /* value to return length of */
+    unsigned long  base    /* radix value is printed in */
+)
+{
+    unsigned long  mag;    /* magnitude of value */
+    int            width;  /* length of printed value */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mag = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+
+    for (width = value < 0 ? 2 : 1; mag >= base; mag /= base)
+    {
+        ++width;
+    }
+
+    return width;
+}
+
+
+/* ==========================================================================
+    Mixes bits of 'x', so that every bit of result depends on every bit
+    of 'x'. It's finalizer of splitmix64 generator.
+   ========================================================================== */
+
+
+static uint64_t seq_mix
+(
+    uint64_t  x       /* value to mix */
+)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+/* ==========================================================================
+    Initializes 'shuf' to permute 'count' numbers starting from 'first'
+    in steps of 'inc'. Permutation is defined by 'seed' only, so the same
+    seed always gives the same order.
+   ========================================================================== */
+
+
+static void seq_shuf_init
+(
+    struct seq_shuf  *shuf,   /* permutation to initialize */
+    long              first,  /* first number of sequence */
+    long              inc,    /* increment between numbers */
+    unsigned long     count,  /* number of numbers in sequence */
+    unsigned long     seed    /* key of permutation */
+)
+{
+    size_t            i;      /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    shuf->first = first;
+    shuf->inc = inc;
+    shuf->count = count;
+
+    /* smallest domain of 2 * half bits that holds all indexes, so
+     * cycle walking takes less than 4 rounds on average
+     */
+
+    shuf->half = 1;
+
+    while (shuf->half != 32 && (uint64_t)(count - 1) >> (2 * shuf->half))
+    {
+        ++shuf->half;
+    }
+
+    shuf->mask = ((uint64_t)1 << shuf->half) - 1;
+
+    for (i = 0; i != SEQ_SHUF_ROUNDS; ++i)
+    {
+        shuf->keys[i] = seq_mix(seed + (i + 1) * 0x9e3779b97f4a7c15ULL);
+    }
+}
+
+
+/* ==========================================================================
+    Returns number at position 'pos' of permutation 'shuf'. Position is
+    encrypted with feistel network, which is a bijection over domain of
+    2 * half bits, and again until result is a valid index, which keeps
+    it a bijection over indexes of sequence.
+   ========================================================================== */
+
+
+static long seq_shuf_nth
+(
+    const struct seq_shuf  *shuf,   /* permutation to take number from */
+    unsigned long           pos     /* position in permutation */
+)
+{
+    uint64_t                x;      /* index being encrypted */
+    uint64_t                l;      /* left half of x */
+    uint64_t                r;      /* right half of x */
+    uint64_t                t;      /* new right half */
+    size_t                  i;      /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    x = pos;
+
+    do
+    {
+        l = x >> shuf->half;
+        r = x & shuf->mask;
+
+        for (i = 0; i != SEQ_SHUF_ROUNDS; ++i)
+        {
+            t = l ^ (seq_mix(r ^ shuf->keys[i]) & shuf->mask);
+            l = r;
+            r = t;
+        }
+
+        x = l << shuf->half | r;
+    }
+    while (x >= shuf->count);
+
+    return seq_nth(shuf->first, shuf->inc, (unsigned long)x);
+}
+
+
+/* ==========================================================================
+    Computes exact number of bytes generator 'g' prints, and stores it
+    in 'size'. Last number of whole output is not followed by separator
+    but by new line. Only part of shuffled sequence has numbers from all
+    over the place, so size of each of them is computed one by one.
+
+    errno:
+            EFBIG       size does not fit in uintmax_t
+   ========================================================================== */
+
+
+static int seq_total
+(
+    const struct seq_gen  *g,     /* generator to compute size for */
+    uintmax_t             *size   /* size of printed numbers */
+)
+{
+    const struct seq_shuf *shuf;  /* permutation of numbers, or NULL */
+    struct seq_ctr         ctr;   /* number to compute size of */
+    unsigned long          pos;   /* position in permutation */
+    size_t                 len;   /* size of single number */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    shuf = g->shuf;
+
+    if (shuf && g->fmt->bin == 0 && g->left != shuf->count)
+    {
+        *size = 0;
+
+        for (pos = g->pos; pos != g->pos + g->left; ++pos)
+        {
+            seq_ctr_set(&ctr, g->fmt, seq_shuf_nth(shuf, pos));
+            len = seq_reclen(g->fmt, ctr.value < 0, ctr.ndigits);
+
+            if (len > UINTMAX_MAX - *size)
+            {
+                errno = EFBIG;
+                return -1;
+            }
+
+            *size += len;
+        }
+    }
+    else if (seq_size(g->fmt, shuf ? shuf->first : g->ctr.value, g->inc,
+        g->left, size) != 0)
+    {
+        return -1;
+    }
+
+    if (g->end && g->left)
+    {
+        *size -= g->fmt->ntail;
+
+        if (*size > UINTMAX_MAX - g->fmt->nend)
+        {
+            errno = EFBIG;
+            return -1;
+        }
+
+        *size += g->fmt->nend;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Initializes generator 'g' to print 'count' numbers starting from
+    'first' in steps of 'inc' with format 'fmt'. Last number ends whole
+    output, unless caller says otherwise. Number of values is known up front, so
+    loop never steps past the last one, and cannot overflow.
+   ========================================================================== */
+
+
+static void seq_gen_init
+(
+    struct seq_gen  *g,      /* generator to initialize */
+    const struct seq_fmt *fmt, /* how to print numbers */
+    long             first,  /* first number to print */
+    long             inc,    /* increment, cannot be 0 */
+    unsigned long    count   /* number of numbers to print */
+)
+{
+    struct seq_ctr   incc;   /* inc converted to digits */
+    size_t           i;      /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    seq_ctr_set(&g->ctr, fmt, first);
+    seq_ctr_set(&incc, fmt, inc);
+
+    for (i = 0; i != SEQ_DIGITS_MAX; ++i)
+    {
+        g->incd[i] = seq_xval(incc.digits[i]);
+    }
+
+    g->nincd = incc.ndigits;
+    g->fmt = fmt;
+    g->shuf = NULL;
+    g->pos = 0;
+    g->end = 1;
+    g->inc = inc;
+    g->left = count;
+    g->tmpl_ndigits = 0;
+}
+
+
+/* ==========================================================================
+    Parses shard 'arg' in "K/N" form, and narrows generator 'g' down to
+    K-th of N contiguous parts of sequence. Parts are balanced by size
+    of output, not by number of numbers, so every consumer gets about
+    the same number of bytes. Boundaries are found with binary search
+    over seq_size(), so it takes the same time no matter which part is
+    taken.
+   ========================================================================== */
+
+
+static int seq_shard
+(
+    struct seq_gen  *g,       /* generator to narrow down */
+    const char      *arg      /* shard, in "K/N" form */
+)
+{
+    char             k_s[32]; /* K part of arg */
+    const char      *slash;   /* '/' in arg */
+    long             k;       /* number of shard to take */
+    long             n;       /* number of shards */
+    long             first;   /* first number of whole sequence */
+    unsigned long    bound[2];/* first number of shard, and next one */
+    unsigned long    lo;      /* binary search lower bound */
+    unsigned long    hi;      /* binary search upper bound */
+    unsigned long    mid;     /* middle of binary search */
+    uintmax_t        total;   /* size of whole sequence */
+    uintmax_t        target;  /* size of shards before bound */
+    uintmax_t        size;    /* size of numbers before mid */
+    int              end;     /* sequence ends whole output */
+    int              b;       /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    slash = strchr(arg, '/');
+
+    if (slash == NULL || (size_t)(slash - arg) >= sizeof(k_s))
+    {
+        fprintf(stderr, "e/invalid shard '%s', expected K/N\n", arg);
+        errno = EINVAL;
+        return -1;
+    }
+
+    memcpy(k_s, arg, slash - arg);
+    k_s[slash - arg] = '\0';
+
+    if (u3u_get_number(k_s, &k) != 0 || u3u_get_number(slash + 1, &n) != 0)
+    {
+        return -1;
+    }
+
+    if (n < 1 || n > UINT_MAX || k < 1 || k > n)
+    {
+        fprintf(stderr, "e/invalid shard '%s', K must be in <1, N>\n", arg);
+        errno = EINVAL;
+        return -1;
+    }
+
+    first = g->ctr.value;
+    end = g->end;
+
+    if (g->shuf)
+    {
+        /* numbers of shuffled sequence are all over the place, so
+         * it's split by position in permutation instead, and all
+         * parts get the same number of numbers
+         */
+
+        for (b = 0; b != 2; ++b)
+        {
+            bound[b] = g->left / n * (k - 1 + b) +
+                g->left % n * (k - 1 + b) / n;
+        }
+
+        g->pos += bound[0];
+        g->left = bound[1] - bound[0];
+        g->end = end && k == n;
+        return 0;
+    }
+
+    if (seq_size(g->fmt, first, g->inc, g->left, &total) != 0)
+    {
+        fprintf(stderr, "e/output would be too big\n");
+        return -1;
+    }
+
+    for (b = 0; b != 2; ++b)
+    {
+        /* find first number, that has at least (k - 1 + b) / n
+         * of output before it, n fits in unsigned int, so target
+         * is computed without overflow
+         */
+
+        target = total / n * (k - 1 + b) + total % n * (k - 1 + b) / n;
+        lo = 0;
+        hi = g->left;
+
+        while (lo != hi)
+        {
+            mid = lo + (hi - lo) / 2;
+            seq_size(g->fmt, first, g->inc, mid, &size);
+
+            if (size < target)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        bound[b] = lo;
+    }
+
+    seq_gen_init(g, g->fmt, seq_nth(first, g->inc, bound[0]), g->inc,
+        bound[1] - bound[0]);
+
+    /* only last shard ends with new line, so shards put together
+     * give the same output as whole sequence
+     */
+
+    g->end = end && k == n;
+    return 0;
+}
+
+
+/* ==========================================================================
+    Prints number from counter 'ctr' with format 'fmt' into 'p', there
+    must be room for fmt->rec_max bytes. Number is followed by separator,
+    or by new line when it's 'last' one. Returns number of bytes printed.
+   ========================================================================== */
+
+
+static size_t seq_emit
+(
+    const struct seq_fmt  *fmt,  /* format to print number with */
+    const struct seq_ctr  *ctr,  /* counter to print */
+    char                  *p,    /* where to print number */
+    int                    last  /* number is last in output */
+)
+{
+    char                  *s;    /* start of printed number */
+    char                   sign; /* sign to print, or 0 */
+    size_t                 field;/* length of number with sign */
+    size_t                 pad;  /* number of padding characters */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    s = p;
+    memcpy(p, fmt->pre, fmt->npre);
+    p += fmt->npre;
+    sign = ctr->value < 0 ? '-' : fmt->sign;
+    field = (sign ? 1 : 0) + ctr->ndigits;
+    pad = fmt->width > field ? fmt->width - field : 0;
+
+    if (pad && fmt->left == 0 && fmt->pad == ' ')
+    {
+        memset(p, ' ', pad);
+        p += pad;
+    }
+
+    if (sign)
+    {
+        *p++ = sign;
+    }
+
+    if (pad && fmt->pad == '0')
+    {
+        memset(p, '0', pad);
+        p += pad;
+    }
+
+    memcpy(p, ctr->digits + SEQ_DIGITS_MAX - ctr->ndigits, ctr->ndigits);
+    p += ctr->ndigits;
+
+    if (pad && fmt->left)
+    {
+        memset(p, ' ', pad);
+        p += pad;
+    }
+
+    if (last)
+    {
+        memcpy(p, fmt->end, fmt->nend);
+        return p + fmt->nend - s;
+    }
+
+    memcpy(p, fmt->tail, fmt->ntail);
+    return p + fmt->ntail - s;
+}
+
+
+/* ==========================================================================
+    Prints block of fmt->block numbers, starting from current one, into
+    'p'. Last fmt->bdigits digits of counter must be '0', and its
+    magnitude must grow by 1 with each step, so numbers in block differ
+    only on these digits and all have the same length. Last number of
+    output cannot be in block, as it's followed by something else than
+    separator.
+
+    Block is copied from template, which is built only when length of
+    numbers changes. Between blocks only few leading digits change, and
+    only these are patched in every number of template.
+
+    Returns number of bytes printed, or 0 when block does not fit in
+    'size' bytes.
+   ========================================================================== */
+
+
+static size_t seq_block
+(
+    struct seq_gen  *g,       /* generator to take numbers from */
+    char            *p,       /* where to print numbers */
+    size_t           size     /* room left in p */
+)
+{
+    char             rec[SEQ_REC_MAX]; /* first number of block */
+    struct seq_ctr   ctr;     /* counter for building template */
+    char            *d;       /* digit being incremented */
+    char             top;     /* biggest digit in radix */
+    size_t           len;     /* length of single number */
+    size_t           block;   /* numbers in block */
+    size_t           i;       /* iterator */
+    size_t           j;       /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    len = seq_emit(g->fmt, &g->ctr, rec, 0);
+    block = g->fmt->block;
+
+    if (size < block * len)
+    {
+        return 0;
+    }
+
+    if (g->tmpl_ndigits != g->ctr.ndigits ||
+        g->tmpl_neg != (g->ctr.value < 0))
+    {
+        /* length of numbers changed, whole template has to be
+         * built from scratch
+         */
+
+        ctr = g->ctr;
+
+        for (i = 0; i != block; ++i)
+        {
+            seq_emit(g->fmt, &ctr, g->tmpl + i * len, 0);
+            seq_ctr_add(&ctr, g->incd, g->nincd);
+        }
+
+        g->tmpl_ndigits = g->ctr.ndigits;
+        g->tmpl_neg = g->ctr.value < 0;
+    }
+    else
+    {
+        /* patch bytes that differ from previous block, last digits
+         * are '0' in both, so they are never touched
+         */
+
+        for (j = 0; j != len; ++j)
+        {
+            if (g->tmpl[j] == rec[j])
+            {
+                continue;
+            }
+
+            for (i = 0; i != block; ++i)
+            {
+                g->tmpl[i * len + j] = rec[j];
+            }
+        }
+    }
+
+    memcpy(p, g->tmpl, block * len);
+
+    /* move counter to first number of next block, that is add 1 to
+     * first digit before these that change in block
+     */
+
+    d = g->ctr.digits + SEQ_DIGITS_MAX - g->fmt->bdigits;
+    top = g->ctr.xdigits[g->ctr.base - 1];
+
+    while (*--d == top)
+    {
+        *d = '0';
+    }
+
+    *d = g->ctr.xdigits[seq_xval(*d) + 1];
+
+    if ((size_t)(g->ctr.digits + SEQ_DIGITS_MAX - d) > g->ctr.ndigits)
+    {
+        ++g->ctr.ndigits;
+    }
+
+    g->ctr.value += (long)block * g->inc;
+    g->left -= block;
+    return block * len;
+}
+
+
+/* ==========================================================================
+    Stores 32 lowest bits of 'x' in 'p', in big endian order when 'be'
+    is set, little endian otherwise. It's always called with constant
+    'be', so compiler merges these into single store, with byte swap
+    when host order is different.
+   ========================================================================== */
+
+
+static void seq_bin_store32
+(
+    unsigned char  *p,     /* where to store number */
+    uint64_t        x,     /* number to store */
+    int             be     /* store in big endian order */
+)
+{
+    if (be)
+    {
+        p[0] = (unsigned char)(x >> 24);
+        p[1] = (unsigned char)(x >> 16);
+        p[2] = (unsigned char)(x >> 8);
+        p[3] = (unsigned char)x;
+        return;
+    }
+
+    p[0] = (unsigned char)x;
+    p[1] = (unsigned char)(x >> 8);
+    p[2] = (unsigned char)(x >> 16);
+    p[3] = (unsigned char)(x >> 24);
+}
+
+
+/* ==========================================================================
+    Stores 'x' in 'p', in big endian order when 'be' is set, little
+    endian otherwise. Same as seq_bin_store32(), but for all 64 bits.
+   ========================================================================== */
+
+
+static void seq_bin_store64
+(
+    unsigned char  *p,     /* where to store number */
+    uint64_t        x,     /* number to store */
+    int             be     /* store in big endian order */
+)
+{
+    seq_bin_store32(p + (be ? 0 : 4), x >> 32, be);
+    seq_bin_store32(p + (be ? 4 : 0), x, be);
+}
+
+
+/* ==========================================================================
+    Prints as many numbers from generator 'g' into 'buf' of 'size' bytes
+    as will fit, as raw binary numbers. Every number is computed from
+    its index, there is no dependency between iterations, and each
+    combination of size and byte order gets its own loop, so compiler
+    can vectorize them. Returns number of bytes stored in 'buf'.
+   ========================================================================== */
+
+
+static size_t seq_fill_bin
+(
+    struct seq_gen  *g,      /* generator to take numbers from */
+    char            *buf,    /* buffer to print numbers into */
+    size_t           size    /* size of the buf */
+)
+{
+    unsigned char   *p;      /* buf as bytes */
+    uint64_t         v;      /* first number */
+    uint64_t         inc;    /* increment between numbers */
+    unsigned long    n;      /* numbers to print */
+    unsigned long    i;      /* iterator */
+    size_t           bin;    /* size of single number */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    bin = g->fmt->bin;
+    n = size / bin < g->left ? size / bin : g->left;
+    p = (unsigned char *)buf;
+    v = (uint64_t)g->ctr.value;
+    inc = (uint64_t)g->inc;
+
+    if (bin == 4 && g->fmt->be)
+    {
+        for (i = 0; i != n; ++i)
+        {
+            seq_bin_store32(p + i * 4, v + i * inc, 1);
+        }
+    }
+    else if (bin == 4)
+    {
+        for (i = 0; i != n; ++i)
+        {
+            seq_bin_store32(p + i * 4, v + i * inc, 0);
+        }
+    }
+    else if (g->fmt->be)
+    {
+        for (i = 0; i != n; ++i)
+        {
+            seq_bin_store64(p + i * 8, v + i * inc, 1);
+        }
+    }
+    else
+    {
+        for (i = 0; i != n; ++i)
+        {
+            seq_bin_store64(p + i * 8, v + i * inc, 0);
+        }
+    }
+
+    g->left -= n;
+
+    if (g->left)
+    {
+        g->ctr.value = seq_nth(g->ctr.value, g->inc, n);
+    }
+
+    return n * bin;
+}
+
+
+/* ==========================================================================
+    Prints as many numbers from shuffled generator 'g' into 'buf' of
+    'size' bytes as will fit. Neighbours have nothing in common here,
+    so every number is converted on its own. Returns number of bytes
+    stored in 'buf'.
+   ========================================================================== */
+
+
+static size_t seq_fill_shuf
+(
+    struct seq_gen  *g,      /* generator to take numbers from */
+    char            *buf,    /* buffer to print numbers into */
+    size_t           size    /* size of the buf */
+)
+{
+    char            *p;      /* where next number goes in buf */
+    char            *end;    /* one byte past buf */
+    long             v;      /* number to print */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    p = buf;
+    end = buf + size;
+
+    for (; g->left && (size_t)(end - p) >= g->fmt->rec_max; --g->left)
+    {
+        v = seq_shuf_nth(g->shuf, g->pos++);
+
+        if (g->fmt->bin == 4)
+        {
+            seq_bin_store32((unsigned char *)p, (uint64_t)v, g->fmt->be);
+            p += 4;
+        }
+        else if (g->fmt->bin == 8)
+        {
+            seq_bin_store64((unsigned char *)p, (uint64_t)v, g->fmt->be);
+            p += 8;
+        }
+        else
+        {
+            seq_ctr_set(&g->ctr, g->fmt, v);
+            p += seq_emit(g->fmt, &g->ctr, p, g->end && g->left == 1);
+        }
+    }
+
+    return p - buf;
+}
+
+
+/* ==========================================================================
+    Prints as many numbers from generator 'g' into 'buf' of 'size' bytes
+    as will fit. Only whole numbers are printed. Returns number of bytes
+    stored in 'buf', 0 means there is nothing more to print.
+   ========================================================================== */
+
+
+static size_t seq_fill
+(
+    struct seq_gen  *g,      /* generator to take numbers from */
+    char            *buf,    /* buffer to print numbers into */
+    size_t           size    /* size of the buf */
+)
+{
+    char            *p;      /* where next number goes in buf */
+    char            *end;    /* one byte past buf */
+    const char      *last;   /* digits that change within block */
+    size_t           bd;     /* number of digits in last */
+    size_t           n;      /* number of bytes printed */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (g->shuf)
+    {
+        return seq_fill_shuf(g, buf, size);
+    }
+
+    if (g->fmt->bin)
+    {
+        return seq_fill_bin(g, buf, size);
+    }
+
+    p = buf;
+    end = buf + size;
+    bd = g->fmt->bdigits;
+    last = g->ctr.digits + SEQ_DIGITS_MAX - bd;
+
+    while (g->left)
+    {
+        if (g->nincd == 1 && g->incd[SEQ_DIGITS_MAX - 1] == 1 &&
+            g->left - g->end >= g->fmt->block && g->ctr.ndigits > bd &&
+            memcmp(last, "0000000", bd) == 0 &&
+            (g->ctr.value > 0) == (g->inc > 0))
+        {
+            /* magnitude grows by one and is at the start of block
+             * (like 100 numbers in radix 10), take the fast path
+             */
+
+            if ((n = seq_block(g, p, end - p)) != 0)
+            {
+                p += n;
+                continue;
+            }
+
+            if (p != buf)
+            {
+                /* block does not fit, leave it for the next buffer,
+                 * so it starts with full block
+                 */
+
+                break;
+            }
+
+            /* block won't fit into whole buffer either, print
+             * numbers one by one then
+             */
+        }
+
+        if ((size_t)(end - p) < g->fmt->rec_max)
+        {
+            break;
+        }
+
+        p += seq_emit(g->fmt, &g->ctr, p, g->end && g->left == 1);
+
+        if (--g->left)
+        {
+            seq_step(g);
+        }
+    }
+
+    return p - buf;
+}
+
+
+/* ==========================================================================
+    Prints all numbers from generator 'g' to stdout.
+   ========================================================================== */
+
+
+static int seq_stdout
+(
+    struct seq_gen  *g       /* generator to take numbers from */
+)
+{
+    char            *buf;    /* buffer for printed numbers */
+    size_t           n;      /* number of bytes in buf */
+    int              ret;    /* return code */
+
+#if ENABLE_MALLOC == 0
+    char             outbuf[U3_SEQ_BUF_SIZE]; /* buffer for printed numbers */
+#endif
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+#if ENABLE_MALLOC
+
+    if ((buf = malloc(U3_SEQ_BUF_SIZE)) == NULL)
+    {
+        perror("e/malloc()");
+        return -1;
+    }
+
+#else /* ENABLE_MALLOC */
+
+    buf = outbuf;
+
+#endif /* ENABLE_MALLOC */
+
+    ret = 0;
+
+    while ((n = seq_fill(g, buf, U3_SEQ_BUF_SIZE)) != 0)
+    {
+        if (fwrite(buf, 1, n, stdout) != n)
+        {
+            fprintf(stderr, "e/fwrite()\n");
+            ret = -1;
+            break;
+        }
+    }
+
+#if ENABLE_MALLOC
+    free(buf);
+#endif
+
+    return ret;
+}
+
+
+#if SEQ_JOBS
+
+
+/* ==========================================================================
+    Returns how many numbers printed with 'fmt' single thread prints in
+    one go. It's multiple of block, so chunks start on block boundary
+    whenever they can, and all of them fit in about U3_SEQ_CHUNK_SIZE
+    bytes.
+   ========================================================================== */
+
+
+static unsigned long seq_chunk_nums
+(
+    const struct seq_fmt  *fmt    /* format numbers are printed with */
+)
+{
+    unsigned long          nums;  /* numbers in chunk */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    nums = U3_SEQ_CHUNK_SIZE / fmt->rec_max / fmt->block * fmt->block;
+    return nums ? nums : fmt->block;
+}
+
+
+/* ==========================================================================
+    Thread that takes queued chunks in order and prints numbers of each
+    one into its buffer. Buffer is big enough for all numbers of chunk.
+   ========================================================================== */
+
+
+static void *seq_worker
+(
+    void              *arg   /* pool thread works for */
+)
+{
+    struct seq_pool   *pool; /* pool thread works for */
+    struct seq_chunk  *c;    /* chunk to print */
+    size_t             n;    /* bytes printed in one go */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    pool = arg;
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;)
+    {
+        while (pool->taken == pool->queued && pool->stop == 0)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+
+        if (pool->taken == pool->queued)
+        {
+            /* we are told to stop and there is nothing left to do
+             */
+
+            break;
+        }
+
+        c = &pool->chunks[pool->taken++ % pool->nchunks];
+        pthread_mutex_unlock(&pool->lock);
+
+        c->len = 0;
+
+        while ((n = seq_fill(&c->gen, c->buf + c->len, pool->size -
+            c->len)) != 0)
+        {
+            c->len += n;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        c->done = 1;
+        pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+/* ==========================================================================
+    Prints all numbers from generator 'g' to stdout with 'jobs' threads.
+    Range is split into chunks of seq_chunk_nums() numbers, each chunk
+    gets its own generator, chunks are printed in parallel, and this
+    thread writes them to stdout in order. At most U3_SEQ_CHUNKS_MAX
+    (and no more than twice the number of threads) chunks are in memory
+    at once.
+   ========================================================================== */
+
+
+static int seq_jobs
+(
+    struct seq_gen    *g,        /* generator to take numbers from */
+    long               jobs      /* number of threads to use */
+)
+{
+    struct seq_pool    pool;     /* pool of threads */
+    struct seq_chunk  *c;        /* chunk being queued or written */
+    pthread_t         *threads;  /* threads printing chunks */
+    unsigned long      written;  /* number of chunks written so far */
+    unsigned long      idx;      /* index of first number of next chunk */
+    unsigned long      count;    /* numbers in next chunk */
+    unsigned long      nums;     /* numbers in single chunk */
+    long               first;    /* first number of the sequence */
+    long               nthreads; /* number of threads started */
+    long               i;        /* iterator */
+    int                ret;      /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    nums = seq_chunk_nums(g->fmt);
+
+    if (g->left <= nums)
+    {
+        /* not even two chunks, threads won't help here
+         */
+
+        return seq_stdout(g);
+    }
+
+    memset(&pool, 0, sizeof(pool));
+
+    /* there is no use for more threads than chunks, and clamping
+     * first keeps 2 * jobs from overflowing
+     */
+
+    jobs = jobs < U3_SEQ_CHUNKS_MAX ? jobs : U3_SEQ_CHUNKS_MAX;
+    pool.nchunks = 2 * jobs < U3_SEQ_CHUNKS_MAX ? 2 * jobs : U3_SEQ_CHUNKS_MAX;
+    pool.size = nums * g->fmt->rec_max;
+    pool.chunks = calloc(pool.nchunks, sizeof(*pool.chunks));
+    threads = malloc(jobs * sizeof(*threads));
+
+    for (i = 0; pool.chunks && i != (long)pool.nchunks; ++i)
+    {
+        if ((pool.chunks[i].buf = malloc(pool.size)) == NULL)
+        {
+            break;
+        }
+    }
+
+    if (pool.chunks == NULL || threads == NULL || i != (long)pool.nchunks)
+    {
+        for (i = 0; pool.chunks && i != (long)pool.nchunks; ++i)
+        {
+            free(pool.chunks[i].buf);
+        }
+
+        free(pool.chunks);
+        free(threads);
+        return seq_stdout(g);
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    for (nthreads = 0; nthreads != jobs; ++nthreads)
+    {
+        if (pthread_create(&threads[nthreads], NULL, seq_worker, &pool) != 0)
+        {
+            break;
+        }
+    }
+
+    ret = 0;
+    idx = 0;
+    written = 0;
+    first = g->ctr.value;
+
+    if (nthreads == 0)
+    {
+        /* could not start any thread, do it all ourself then
+         */
+
+        ret = seq_stdout(g);
+        idx = g->left;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+
+    for (;;)
+    {
+        /* queue as many chunks as there are free slots
+         */
+
+        while (ret == 0 && idx != g->left &&
+            pool.queued - written != pool.nchunks)
+        {
+            c = &pool.chunks[pool.queued % pool.nchunks];
+            count = g->left - idx;
+            count = count < nums ? count : nums;
+            seq_gen_init(&c->gen, g->fmt, seq_nth(first, g->inc, idx),
+                g->inc, count);
+            c->gen.end = g->end && idx + count == g->left;
+            c->gen.shuf = g->shuf;
+            c->gen.pos = g->pos + idx;
+            c->done = 0;
+            idx += count;
+            ++pool.queued;
+            pthread_cond_signal(&pool.work);
+        }
+
+        if (written == pool.queued)
+        {
+            /* everything queued has been written, we're done
+             */
+
+            break;
+        }
+
+        /* wait for the oldest chunk and write it out, chunk
+         * won't be touched by anyone else until we queue it
+         * again
+         */
+
+        c = &pool.chunks[written % pool.nchunks];
+
+        while (c->done == 0)
+        {
+            pthread_cond_wait(&pool.done, &pool.lock);
+        }
+
+        pthread_mutex_unlock(&pool.lock);
+
+        if (ret == 0 && fwrite(c->buf, 1, c->len, stdout) != c->len)
+        {
+            fprintf(stderr, "e/fwrite()\n");
+            ret = -1;
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        ++written;
+    }
+
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i != nthreads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i != (long)pool.nchunks; ++i)
+    {
+        free(pool.chunks[i].buf);
+    }
+
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.work);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.chunks);
+    free(threads);
+    g->left = 0;
+    return ret;
+}
+
+#endif /* SEQ_JOBS */
+
+
+/* ==========================================================================
+    Writes all numbers from generator 'g' to file 'fd', starting at
+    offset 'off', through 'buf' of 'size' bytes.
+   ========================================================================== */
+
+
+static int seq_pwrite
+(
+    struct seq_gen  *g,      /* generator to take numbers from */
+    int              fd,     /* file to write numbers to */
+    uintmax_t        off,    /* offset where first number goes */
+    char            *buf,    /* buffer for printed numbers */
+    size_t           size    /* size of the buf */
+)
+{
+    size_t           n;      /* number of bytes in buf */
+    size_t           pos;    /* bytes of buf written so far */
+    ssize_t          w;      /* return value from pwrite() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while ((n = seq_fill(g, buf, size)) != 0)
+    {
+        for (pos = 0; pos != n; pos += w)
+        {
+            w = pwrite(fd, buf + pos, n - pos, (off_t)(off + pos));
+
+            if (w == -1 && errno == EINTR)
+            {
+                w = 0;
+                continue;
+            }
+
+            if (w == -1)
+            {
+                perror("e/pwrite()");
+                return -1;
+            }
+        }
+
+        off += n;
+    }
+
+    return 0;
+}
+
+
+#if SEQ_JOBS
+
+/* ==========================================================================
+    Thread that takes chunks of sequence, prints them, and writes them
+    straight to their place in file. Chunk offset is computed with
+    seq_size(), so threads don't wait for each other.
+   ========================================================================== */
+
+
+static void *seq_file_worker
+(
+    void               *arg    /* pool thread works for */
+)
+{
+    struct seq_fpool   *pool;  /* pool thread works for */
+    struct seq_gen      gen;   /* generator for current chunk */
+    unsigned long       idx;   /* index of first number of chunk */
+    unsigned long       count; /* numbers in chunk */
+    uintmax_t           off;   /* offset of chunk in file */
+    char               *buf;   /* buffer for printed numbers */
+    int                 err;   /* errno from failed operation */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    pool = arg;
+    err = 0;
+
+    if ((buf = malloc(pool->nums * pool->fmt->rec_max)) == NULL)
+    {
+        /* others will do the job
+         */
+
+        return NULL;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->err = pool->err ? pool->err : err;
+        idx = pool->next;
+        count = pool->err ? 0 : pool->count - idx;
+        count = count < pool->nums ? count : pool->nums;
+        pool->next += count;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (count == 0)
+        {
+            /* all done, or someone failed and there is no point
+             * in going on
+             */
+
+            break;
+        }
+
+        seq_gen_init(&gen, pool->fmt, seq_nth(pool->first, pool->inc, idx),
+            pool->inc, count);
+        gen.end = pool->end && idx + count == pool->count;
+        gen.shuf = pool->shuf;
+        gen.pos = pool->pos + idx;
+
+        if (seq_size(pool->fmt, pool->first, pool->inc, idx, &off) != 0 ||
+            seq_pwrite(&gen, pool->fd, off, buf,
+                pool->nums * pool->fmt->rec_max) != 0)
+        {
+            err = errno;
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+#endif /* SEQ_JOBS */
+
+
+/* ==========================================================================
+    Writes all numbers from generator 'g' to file 'path' with 'jobs'
+    threads. Exact size of output is computed up front, and file is
+    allocated before anything is written to it, so threads can write
+    their chunks anywhere in file with pwrite().
+   ========================================================================== */
+
+
+static int seq_file
+(
+    struct seq_gen     *g,        /* generator to take numbers from */
+    const char         *path,     /* file to write numbers to */
+    long                jobs      /* number of threads to use */
+)
+{
+    uintmax_t           size;     /* size of the output */
+    int                 fd;       /* file to write numbers to */
+    int                 ret;      /* return code */
+    char               *buf;      /* buffer for printed numbers */
+
+#if SEQ_JOBS
+    struct seq_fpool    pool;     /* pool of threads */
+    pthread_t          *threads;  /* threads writing chunks */
+    long                nthreads; /* number of threads started */
+    long                i;        /* iterator */
+#endif
+
+#if ENABLE_MALLOC == 0
+    char                outbuf[U3_SEQ_BUF_SIZE]; /* buffer for numbers */
+#endif
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (seq_total(g, &size) != 0 ||
+        size >> (sizeof(off_t) * CHAR_BIT - 1))
+    {
+        fprintf(stderr, "e/output would be too big\n");
+        errno = EFBIG;
+        return -1;
+    }
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+    {
+        perror("e/open()");
+        return -1;
+    }
+
+#if HAVE_POSIX_FALLOCATE
+
+    /* reserve space for whole file now, so we don't end up with
+     * half written file when disk is full, and file is not
+     * fragmented by threads writing all over the place
+     */
+
+    if (size && (ret = posix_fallocate(fd, 0, (off_t)size)) != 0 &&
+        ret != EINVAL && ret != EOPNOTSUPP)
+    {
+        errno = ret;
+        perror("e/posix_fallocate()");
+        close(fd);
+        return -1;
+    }
+
+#endif /* HAVE_POSIX_FALLOCATE */
+
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        perror("e/ftruncate()");
+        close(fd);
+        return -1;
+    }
+
+    ret = 0;
+
+#if SEQ_JOBS
+
+    /* offset of chunk of shuffled text is not known before all
+     * numbers before it are printed, so it's done by single thread
+     */
+
+    if (jobs > 1 && g->left > seq_chunk_nums(g->fmt) &&
+        (g->shuf == NULL || g->fmt->bin))
+    {
+        memset(&pool, 0, sizeof(pool));
+        pool.fmt = g->fmt;
+        pool.shuf = g->shuf;
+        pool.pos = g->pos;
+        pool.end = g->end;
+        pool.nums = seq_chunk_nums(g->fmt);
+        pool.first = g->ctr.value;
+        pool.inc = g->inc;
+        pool.count = g->left;
+        pool.fd = fd;
+        g->left = 0;
+
+        /* every thread has buffer for single chunk, so that many
+         * chunks are in memory at once, and size of threads array
+         * does not overflow
+         */
+
+        jobs = jobs < U3_SEQ_CHUNKS_MAX ? jobs : U3_SEQ_CHUNKS_MAX;
+
+        if ((threads = malloc(jobs * sizeof(*threads))) == NULL)
+        {
+            jobs = 1;
+        }
+
+        pthread_mutex_init(&pool.lock, NULL);
+
+        for (nthreads = 0; nthreads < jobs - 1; ++nthreads)
+        {
+            if (pthread_create(&threads[nthreads], NULL, seq_file_worker,
+                &pool) != 0)
+            {
+                break;
+            }
+        }
+
+        /* this thread works too, so there is always at least
+         * one worker
+         */
+
+        seq_file_worker(&pool);
+
+        for (i = 0; i != nthreads; ++i)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        pthread_mutex_destroy(&pool.lock);
+        free(threads);
+
+        if (pool.err == 0 && pool.next != pool.count)
+        {
+            /* no thread could get memory for its buffer
+             */
+
+            pool.err = ENOMEM;
+            fprintf(stderr, "e/malloc()\n");
+        }
+
+        ret = pool.err ? -1 : 0;
+        errno = pool.err;
+    }
+
+#else /* SEQ_JOBS */
+
+    (void)jobs;
+
+#endif /* SEQ_JOBS */
+
+    if (g->left)
+    {
+#if ENABLE_MALLOC
+
+        if ((buf = malloc(U3_SEQ_BUF_SIZE)) == NULL)
+        {
+            perror("e/malloc()");
+            close(fd);
+            return -1;
+        }
+
+#else /* ENABLE_MALLOC */
+
+        buf = outbuf;
+
+#endif /* ENABLE_MALLOC */
+
+        ret = seq_pwrite(g, fd, 0, buf, U3_SEQ_BUF_SIZE);
+
+#if ENABLE_MALLOC
+        free(buf);
+#endif
+    }
+
+    if (close(fd) != 0 && ret == 0)
+    {
+        perror("e/close()");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+
+/* ==========================================================================
+                       __     __ _          ____
+        ____   __  __ / /_   / /(_)_____   / __/__  __ ____   _____ _____
+       / __ \ / / / // __ \ / // // ___/  / /_ / / / // __ \ / ___// ___/
+      / /_/ // /_/ // /_/ // // // /__   / __// /_/ // / / // /__ (__  )
+     / .___/ \__,_//_.___//_//_/ \___/  /_/   \__,_//_/ /_/ \___//____/
+    /_/
+   ========================================================================== */
+
 
+/* ==========================================================================
+    Initializes iterator 'seq' to generate numbers from 'first' to 'last'
+    in steps of 'inc', the same numbers seq program would print. Numbers
+    are then taken with u3_seq_fill(). Nothing is allocated, so iterator
+    does not need to be destroyed, and it can be initialized again at any
+    time.
+
+    Returns 0 on success, or -1 when arguments are invalid.
+
+    errno:
+            EINVAL      seq is NULL, or inc is 0
+            ERANGE      first, inc or last is LONG_MIN or LONG_MAX
    ========================================================================== */
 
 
-static void print_help(void)
+int u3_seq_init
+(
+    struct u3_seq    *seq,    /* iterator to initialize */
+    long              first,  /* first number to generate */
+    long              inc,    /* increment between numbers */
+    long              last    /* last number to generate */
+)
 {
-    fprintf(stderr,
-        "usage: seq <last>\n"
-        "       seq <first> <last>\n"
-        "       seq <first> <increment> <last>\n"
-        "\n"
-        "Prints number from <first> to <last> in steps of <increment>\n"
-        "\n"
-        "* if <first> or <increment> is not defined, it will be set to 1\n"
-        "* <fist>, <increment> and <last> are all of type \"long int\"\n"
-        "* possible values are (-LONG_MAX, LONG_MAX)\n"
-    );
+    struct seq_iter  *it;     /* iterator state inside of seq */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (seq == NULL || inc == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (first == LONG_MIN || first == LONG_MAX || inc == LONG_MIN ||
+        inc == LONG_MAX || last == LONG_MIN || last == LONG_MAX)
+    {
+        errno = ERANGE;
+        return -1;
+    }
+
+    it = (struct seq_iter *)seq->priv.data;
+
+    if (seq_fmt_init(&it->fmt, "%d", "\n") != 0)
+    {
+        return -1;
+    }
+
+    seq_gen_init(&it->gen, &it->fmt, first, inc,
+        seq_count(first, inc, last));
+    return 0;
+}
+
+
+/* ==========================================================================
+    Prints as many next numbers of iterator 'seq' as fit in 'buf' of
+    'size' bytes, each number followed by new line. Only whole numbers
+    are printed, and next call continues where previous one stopped.
+    Buffer of U3_SEQ_NUM_MAX bytes always fits at least one number.
+    Function does not touch stdio, nor allocate anything.
+
+    Returns number of bytes printed, 0 when all numbers have already been
+    printed, or -1 on error.
+
+    errno:
+            EINVAL      seq is NULL, or buf is NULL and size is not 0
+            ENOBUFS     next number does not fit in size bytes
+   ========================================================================== */
+
+
+ssize_t u3_seq_fill
+(
+    struct u3_seq    *seq,    /* iterator to take numbers from */
+    void             *buf,    /* where to print numbers */
+    size_t            size    /* size of buf */
+)
+{
+    struct seq_iter  *it;     /* iterator state inside of seq */
+    struct seq_gen   *g;      /* generator of iterator */
+    char              rec[SEQ_REC_MAX]; /* next number */
+    size_t            len;    /* length of rec */
+    size_t            n;      /* number of bytes printed */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (seq == NULL || (buf == NULL && size))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* number of bytes printed must fit in return value
+     */
+
+    size = size > SSIZE_MAX ? SSIZE_MAX : size;
+
+    it = (struct seq_iter *)seq->priv.data;
+    g = &it->gen;
+
+    /* caller is free to copy iterator, so pointer to format may
+     * point to the old copy by now
+     */
+
+    g->fmt = &it->fmt;
+    n = size >= it->fmt.rec_max ? seq_fill(g, buf, size) : 0;
+
+    /* seq_fill() stops when there is no room for the longest number,
+     * but few more shorter ones may still fit
+     */
+
+    while (g->left)
+    {
+        len = seq_emit(g->fmt, &g->ctr, rec, g->end && g->left == 1);
+
+        if (len > size - n)
+        {
+            break;
+        }
+
+        memcpy((char *)buf + n, rec, len);
+        n += len;
+
+        if (--g->left)
+        {
+            seq_step(g);
+        }
+    }
+
+    if (n == 0 && g->left)
+    {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    return (ssize_t)n;
 }
 
 
@@ -74,42 +2664,233 @@ int main
 int u3_seq_main
 #endif
 (
-    int  argc,
-    char *argv[]
+    int             argc,
+    char           *argv[]
 )
 {
-    long   first;
-    long   increment;
-    long   last;
-    long   current;
+    long            first;
+    long            increment;
+    long            last;
+    long            current;
+    long            jobs;    /* number of threads to use */
+    const char     *arg;     /* argument of an option */
+    const char     *output;  /* file to write numbers to, or NULL */
+    const char     *shard;   /* shard to print, or NULL */
+    const char     *format;  /* format of numbers, or NULL */
+    const char     *sep;     /* separator between numbers, or NULL */
+    const char     *binary;  /* type of binary numbers, or NULL */
+    const char     *shuffle; /* seed of shuffle, "" for random, or NULL */
+    long            radix;   /* radix of printed numbers */
+    char            conv;    /* conversion that prints in radix */
+    long            seed;    /* seed of shuffle */
+    char            wformat[32]; /* format for equal width */
+    int             width[2];/* width of first and last number */
+    int             equal;   /* print numbers with equal width */
+    int             query;   /* print size and/or count only */
+    uintmax_t       size;    /* size of output */
+    struct seq_fmt  fmt;     /* compiled format of numbers */
+    struct seq_shuf shuf;    /* permutation of numbers */
+    struct seq_gen  gen;     /* generator of numbers */
+    int             ret;     /* return code */
+    int             i;       /* iterator */
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 
-    if (argc == 2)
+    jobs = 1;
+    output = NULL;
+    shard = NULL;
+    format = NULL;
+    sep = NULL;
+    binary = NULL;
+    shuffle = NULL;
+    radix = 10;
+    equal = 0;
+    query = 0;
+
+    /* parse options, they all start with '-' followed by a letter,
+     * or with "--", anything else (like "-5") is a number
+     */
+
+    for (i = 1; i < argc && argv[i][0] == '-' &&
+        ((argv[i][1] >= 'a' && argv[i][1] <= 'z') ||
+         (argv[i][1] >= 'A' && argv[i][1] <= 'Z') ||
+         argv[i][1] == '-'); ++i)
     {
-        if (argv[1][0] == '-')
+        if (strcmp(argv[i], "--") == 0)
+        {
+            /* end of options, negative number may follow
+             */
+
+            ++i;
+            break;
+        }
+
+        if (strcmp(argv[i], "--bytes") == 0)
+        {
+            query |= SEQ_QUERY_BYTES;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--count") == 0)
+        {
+            query |= SEQ_QUERY_COUNT;
+            continue;
+        }
+
+        if (seq_is_opt(argv[i], "--shard"))
         {
-            if (argv[1][1] == 'v')
+            if ((shard = seq_optarg(argc, argv, &i)) == NULL)
             {
-                /* '-v' passed, print version and exit
-                 */
+                return U3_EXIT_FAILURE;
+            }
+
+            continue;
+        }
+
+        if (seq_is_opt(argv[i], "--shuffle"))
+        {
+            /* seed is optional, so it can only be glued to option
+             */
 
-                fprintf(stderr, "seq " U3_SEQ_VERSION "\n"
-                        "u3 " U3_VERSION "\n");
-                return 0;
+            shuffle = argv[i][9] == '=' ? argv[i] + 10 : "";
+            continue;
+        }
+
+        if (seq_is_opt(argv[i], "--radix"))
+        {
+            if ((arg = seq_optarg(argc, argv, &i)) == NULL ||
+                u3u_get_number(arg, &radix) != 0)
+            {
+                return U3_EXIT_FAILURE;
             }
 
-            if (argv[1][1] == 'h')
+            if (radix != 16 && radix != 10 && radix != 8 && radix != 2)
             {
-                /* '-h' passed, print help and exit
-                 */
+                fprintf(stderr, "e/invalid radix %s, expected 16, 10, 8 "
+                    "or 2\n", arg);
+                errno = EINVAL;
+                return U3_EXIT_FAILURE;
+            }
+
+            continue;
+        }
+
+        if (seq_is_opt(argv[i], "--binary"))
+        {
+            if ((binary = seq_optarg(argc, argv, &i)) == NULL)
+            {
+                return U3_EXIT_FAILURE;
+            }
+
+            continue;
+        }
+
+        if (argv[i][1] == '-')
+        {
+            fprintf(stderr, "e/invalid option %s\n", argv[i]);
+            print_help();
+            errno = EINVAL;
+            return U3_EXIT_FAILURE;
+        }
+
+        switch (argv[i][1])
+        {
+        case 'v':
+            /* '-v' passed, print version and exit
+             */
+
+            fprintf(stderr, "seq " U3_SEQ_VERSION "\n"
+                    "u3 " U3_VERSION "\n");
+            return 0;
+
+        case 'h':
+            /* '-h' passed, print help and exit
+             */
+
+            print_help();
+            return 0;
+
+        case 'j':
+            if ((arg = seq_optarg(argc, argv, &i)) == NULL ||
+                u3u_get_number(arg, &jobs) != 0)
+            {
+                return U3_EXIT_FAILURE;
+            }
+
+            if (jobs < 1)
+            {
+                fprintf(stderr, "e/number of jobs must be positive\n");
+                errno = EINVAL;
+                return U3_EXIT_FAILURE;
+            }
+
+            break;
+
+        case 'o':
+            if ((output = seq_optarg(argc, argv, &i)) == NULL)
+            {
+                return U3_EXIT_FAILURE;
+            }
+
+            break;
+
+        case 'f':
+            if ((format = seq_optarg(argc, argv, &i)) == NULL)
+            {
+                return U3_EXIT_FAILURE;
+            }
+
+            break;
 
-                print_help();
-                return 0;
+        case 's':
+            if ((sep = seq_optarg(argc, argv, &i)) == NULL)
+            {
+                return U3_EXIT_FAILURE;
             }
+
+            break;
+
+        case 'w':
+            equal = 1;
+            break;
+
+        default:
+            fprintf(stderr, "e/invalid option -%c\n", argv[i][1]);
+            print_help();
+            errno = EINVAL;
+            return U3_EXIT_FAILURE;
         }
     }
 
+    if (format && equal)
+    {
+        fprintf(stderr, "e/format cannot be used with equal width\n");
+        errno = EINVAL;
+        return U3_EXIT_FAILURE;
+    }
+
+    if (format && radix != 10)
+    {
+        fprintf(stderr, "e/radix cannot be used with format, use %%x, %%o "
+            "or %%b in format instead\n");
+        errno = EINVAL;
+        return U3_EXIT_FAILURE;
+    }
+
+    if (binary && (format || sep || equal || radix != 10))
+    {
+        fprintf(stderr, "e/binary numbers cannot be formatted\n");
+        errno = EINVAL;
+        return U3_EXIT_FAILURE;
+    }
+
+    /* what's left are numbers, make it look like they were the only
+     * arguments passed
+     */
+
+    argv += i - 1;
+    argc -= i - 1;
+
     /* if some arguments are not passed, their default value should be 1
      */
 
@@ -139,21 +2920,21 @@ int u3_seq_main
         /* when all arguments are passed, increment is at 'argc == 2'
          */
 
-        current |= u3u_get_number(argv[2], &increment);
+        current |= seq_get_number(argv[2], &increment);
 
     case 3:
          /* if more than 2 arguments are passed, 'first' will always
           * be at 'argc == 1' position
           */
 
-        current |= u3u_get_number(argv[1], &first);
+        current |= seq_get_number(argv[1], &first);
 
     case 2:
         /* 'last' argument is always present and always is at 'argc - 1'
          * position
          */
 
-        current |= u3u_get_number(argv[argc - 1], &last);
+        current |= seq_get_number(argv[argc - 1], &last);
 
         if (current == 0)
         {
@@ -183,34 +2964,134 @@ int u3_seq_main
         return U3_EXIT_FAILURE;
     }
 
+    conv = radix == 16 ? 'x' : radix == 8 ? 'o' : radix == 2 ? 'b' : 'd';
+
+    if (equal)
+    {
+        /* pad numbers with zeros, so they are as wide as wider
+         * of first and last
+         */
+
+        width[0] = seq_width(first, radix);
+        width[1] = seq_width(last, radix);
+        sprintf(wformat, "%%0%d%c", width[0] > width[1] ? width[0] : width[1],
+            conv);
+        format = wformat;
+    }
+    else if (format == NULL)
+    {
+        sprintf(wformat, "%%%c", conv);
+        format = wformat;
+    }
+
+    if (binary ? seq_fmt_bin(&fmt, binary) != 0 :
+        seq_fmt_init(&fmt, format, sep ? sep : "\n") != 0)
+    {
+        return U3_EXIT_FAILURE;
+    }
+
     /* arguments parsed, now print numbers
      */
 
-    for (current = first;
+    seq_gen_init(&gen, &fmt, first, increment,
+        seq_count(first, increment, last));
 
-        /* if increment is positive, we count from lower number to
-         * bigger one (like 1 2 3 4)
-         *
-         * if increment is negative, we count from bigger number to
-         * lower one (like 4 3 2 1) thus we swap check or else calling
-         * 'seq 10 -1 5' would return without printing anything and
-         * we want to count down
+    if (binary && gen.left)
+    {
+        /* sequence only goes one way, so it's enough to check
+         * first and last number
          */
 
-        increment > 0 ? current <= last : current >= last;
-        current += increment)
+        current = seq_nth(first, increment, gen.left - 1);
+
+        if (first < fmt.min || first > fmt.max ||
+            current < fmt.min || current > fmt.max)
+        {
+            fprintf(stderr, "e/numbers do not fit in %s\n", binary);
+            errno = ERANGE;
+            return U3_EXIT_FAILURE;
+        }
+    }
+
+    if (shuffle)
     {
-        if (printf("%ld\n", current) < 0)
+        if (*shuffle == '\0')
         {
-            /* when stdout fails there is still chance stderr will
-             * be available (like piped to some other file, whatever)
+            /* no seed, every run gets different order
              */
 
-            fprintf(stderr, "e/printf()");
+            seed = (long)time(NULL) ^ (long)getpid() << 16;
+        }
+        else if (u3u_get_number(shuffle, &seed) != 0)
+        {
             return U3_EXIT_FAILURE;
         }
+
+        seq_shuf_init(&shuf, first, increment, gen.left, seed);
+        gen.shuf = &shuf;
     }
 
-    fflush(stdout);
-    return 0;
+    if (shard && seq_shard(&gen, shard) != 0)
+    {
+        return U3_EXIT_FAILURE;
+    }
+
+    if (query)
+    {
+        /* only tell how much would be printed, so space can be
+         * prepared for it
+         */
+
+        if (seq_total(&gen, &size) != 0)
+        {
+            fprintf(stderr, "e/output would be too big\n");
+            return U3_EXIT_FAILURE;
+        }
+
+        if (query & SEQ_QUERY_BYTES)
+        {
+            printf("%ju\n", size);
+        }
+
+        if (query & SEQ_QUERY_COUNT)
+        {
+            printf("%lu\n", gen.left);
+        }
+
+        /* nothing is generated, not even output file is touched
+         */
+
+        if (fflush(stdout) != 0)
+        {
+            fprintf(stderr, "e/fwrite()\n");
+            return U3_EXIT_FAILURE;
+        }
+
+        return 0;
+    }
+
+    if (output)
+    {
+        ret = seq_file(&gen, output, jobs);
+    }
+    else
+    {
+#if SEQ_JOBS
+        ret = jobs > 1 ? seq_jobs(&gen, jobs) : seq_stdout(&gen);
+#else
+        ret = seq_stdout(&gen);
+#endif
+    }
+
+    if (ret == 0 && fflush(stdout) != 0)
+    {
+        /* when stdout fails there is still chance stderr will
+         * be available (like piped to some other file, whatever)
+         */
+
+        fprintf(stderr, "e/fwrite()\n");
+        ret = -1;
+    }
+
+    return ret == 0 ? 0 : U3_EXIT_FAILURE;
 }
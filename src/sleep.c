@@ -22,17 +22,154 @@
 #endif
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <limits.h>
+#include <unistd.h>
+
+#if HAVE_SYS_PRCTL_H
+#   include <sys/prctl.h>
+#endif
+
+#if HAVE_SYS_TIMERFD_H
+#   include <sys/timerfd.h>
+#endif
 
 #include "utils.h"
 #include "u3.h"
 #include "u3defs.h"
 
 
+/* ==========================================================================
+                          __
+                         / /_ __  __ ____   ___   _____
+                        / __// / / // __ \ / _ \ / ___/
+                       / /_ / /_/ // /_/ //  __/(__  )
+                       \__/ \__, // .___/ \___//____/
+                           /____//_/
+   ========================================================================== */
+
+
+/* precise sleep measures how late it wakes up from few short sleeps of
+ * that many nanoseconds, and then spins for that long before deadline
+ */
+
+#define SLEEP_CALIBRATE_NS      50000l
+#define SLEEP_CALIBRATE_ROUNDS  3
+
+/* spin at least that long, even when calibration found wake ups to be
+ * always on time
+ */
+
+#define SLEEP_SPIN_MIN          2000l
+
+
+/* state of precise sleep, kept between deadlines of periodic sleep
+ */
+
+struct sleep_spin
+{
+    long  spin;   /* time to busy wait before deadline */
+    int   slack;  /* timer slack to restore, or -1 */
+};
+
+
+/* overshoot histogram is log-linear, every power of two is split into
+ * 8 buckets, so percentiles are within 12.5% of real value, and no
+ * samples need to be kept, no matter how many of them are taken
+ */
+
+#define SLEEP_STATS_SUB_BITS    3
+#define SLEEP_STATS_SUB         (1 << SLEEP_STATS_SUB_BITS)
+#define SLEEP_STATS_BUCKETS     (64 * SLEEP_STATS_SUB)
+
+/* printed histogram has rows in 1-2-5 series, bars are that long for
+ * the row with most samples
+ */
+
+#define SLEEP_STATS_ROWS        20
+#define SLEEP_STATS_BAR         40
+
+
+/* measurements of repeated sleeps, all times are in nanoseconds
+ */
+
+struct sleep_stats
+{
+    unsigned long  hist[SLEEP_STATS_BUCKETS];  /* overshoot histogram */
+    unsigned long  rows[SLEEP_STATS_ROWS];     /* printed histogram */
+    unsigned long  n;                          /* number of samples */
+    int64_t        wall;                       /* sum of wall time slept */
+    int64_t        mono;                       /* sum of monotonic time */
+    int64_t        over;                       /* sum of overshoots */
+    long           min;                        /* smallest overshoot */
+    long           max;                        /* biggest overshoot */
+};
+
+
+/* timer wheel has levels of slots, each level covers 64 times longer
+ * time than previous one, and slot of level 0 is single tick. 6 levels
+ * of 1ms ticks cover over 2 years, longer timers go through top
+ * level more than once.
+ */
+
+#define SLEEP_WHEEL_TICK_NS  1000000l
+#define SLEEP_WHEEL_HZ       (1000000000l / SLEEP_WHEEL_TICK_NS)
+#define SLEEP_WHEEL_BITS     6
+#define SLEEP_WHEEL_SLOTS    (1 << SLEEP_WHEEL_BITS)
+#define SLEEP_WHEEL_LEVELS   6
+#define SLEEP_WHEEL_RANGE    ((uint64_t)1 << \
+                                 (SLEEP_WHEEL_BITS * SLEEP_WHEEL_LEVELS))
+
+
+/* timer, kept in caller's struct u3_timer, it's linked into slot of
+ * wheel while it's pending
+ */
+
+struct sleep_timer
+{
+    struct sleep_timer   *next;     /* next timer in slot */
+    struct sleep_timer  **pprev;    /* pointer that points to us */
+    uint64_t              expires;  /* tick at which timer expires */
+    u3_timer_fn           fn;       /* function to call on expiry */
+    void                 *arg;      /* argument for fn */
+    unsigned char         level;    /* level of slot we are in */
+    unsigned char         slot;     /* slot of level we are in */
+    unsigned char         pending;  /* timer is linked into wheel */
+};
+
+
+/* timer wheel, kept in caller's struct u3_timers. Bit in 'used' is set
+ * for every slot that has timers, so next event is found without
+ * looking at empty slots.
+ */
+
+struct sleep_wheel
+{
+    struct sleep_timer   *slots[SLEEP_WHEEL_LEVELS][SLEEP_WHEEL_SLOTS];
+    uint64_t              used[SLEEP_WHEEL_LEVELS]; /* slots with timers */
+    struct timespec       base;     /* monotonic time of tick 0 */
+    uint64_t              tick;     /* next tick to process */
+    uint64_t              armed;    /* tick timerfd is armed for */
+    unsigned long         count;    /* number of pending timers */
+    int                   running;  /* u3_timers_run() is in progress */
+    int                   fd;       /* timerfd to wake host up */
+};
+
+
+/* caller's structures must be able to hold ours, compilation fails
+ * here when they cannot
+ */
+
+typedef char sleep_wheel_fits[
+    sizeof(struct sleep_wheel) <= U3_TIMERS_SIZE ? 1 : -1];
+typedef char sleep_timer_fits[
+    sizeof(struct sleep_timer) <= U3_TIMER_SIZE ? 1 : -1];
+
+
 /* ==========================================================================
                ____                     __   _
               / __/__  __ ____   _____ / /_ (_)____   ____   _____
@@ -47,12 +184,24 @@ static void print_help(void)
 {
     fprintf(stderr,
         "usage: sleep <time>[.<fraction>]\n"
+        "       sleep -p <time>[.<fraction>]\n"
+        "       sleep [-p] --every <time>[.<fraction>] [--count <n>]\n"
+        "       sleep [-p] --stats [--count <n>] <time>[.<fraction>]\n"
         "       sleep <option>\n"
         "\n"
         "Pause execution for time seconds.\n"
         "\n"
         "\t<time>       number of seconds to pause\n"
         "\t<fraction>   number of fraction of seconds to pause\n"
+        "\t-p           precise sleep, wake up within few microseconds, at\n"
+        "\t             cost of busy waiting for the last of them\n"
+        "\t--every <t>  print tick number every <t> seconds, ticks are at\n"
+        "\t             multiples of <t> from start, late ticks are reported\n"
+        "\t             and skipped, so schedule never drifts\n"
+        "\t--stats      measure how late sleep wakes up, and print\n"
+        "\t             overshoot percentiles and histogram\n"
+        "\t--count <n>  stop after <n> ticks, or sleep <n> times for\n"
+        "\t             --stats, <n> can have K, M, Ki or Mi suffix\n"
         "\t-h           show this help\n"
         "\t-v           show version and exit\n"
     );
@@ -60,84 +209,91 @@ static void print_help(void)
 
 
 /* ==========================================================================
-                                              _
-                           ____ ___   ____ _ (_)____
-                          / __ `__ \ / __ `// // __ \
-                         / / / / / // /_/ // // / / /
-                        /_/ /_/ /_/ \__,_//_//_/ /_/
+    Checks if 'arg' is long option 'name', with or without "=value".
+   ========================================================================== */
+
+
+static int sleep_is_opt
+(
+    const char  *arg,    /* argument to check */
+    const char  *name    /* name of long option, with "--" */
+)
+{
+    size_t       len;    /* length of name */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    len = strlen(name);
+    return strncmp(arg, name, len) == 0 &&
+        (arg[len] == '\0' || arg[len] == '=');
+}
+
 
+/* ==========================================================================
+    Returns argument of long option at 'i' in 'argv', which is either
+    glued to option ("--every=0.1") or is next argument ("--every 0.1"),
+    in which case 'i' is moved to it. Returns NULL when there is no
+    argument.
    ========================================================================== */
 
 
-#if U3_STANDALONE
-int main
-#else
-int u3_sleep_main
-#endif
+static char *sleep_optarg
 (
-    int              argc,
-    char            *argv[]
+    int     argc,    /* number of arguments in argv */
+    char   *argv[],  /* program arguments */
+    int    *i        /* index of option in argv */
 )
 {
-    char            *sfractions;
-    struct timespec  request;
-    long             nano;
-    long             seconds;
+    char   *eq;      /* '=' in long option */
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 
-    if (argc != 2)
+    if ((eq = strchr(argv[*i], '=')) != NULL)
     {
-        fprintf(stderr, "wrong number of arguments passed\n");
-        print_help();
-        return 1;
+        return eq + 1;
     }
 
-    if (argv[1][0] == '-')
+    if (*i + 1 == argc)
     {
-        if (argv[1][1] == 'v')
-        {
-            /* '-v' passed, print version and exit
-            */
+        fprintf(stderr, "option %s requires an argument\n", argv[*i]);
+        return NULL;
+    }
 
-            fprintf(stderr, "sleep " U3_SLEEP_VERSION "\n"
-                    "u3 " U3_VERSION "\n");
-            return 0;
-        }
+    return argv[++*i];
+}
 
-        if (argv[1][1] == 'h')
-        {
-            /* '-h' passed, print help and exit
-            */
 
-            print_help();
-            return 0;
-        }
+/* ==========================================================================
+    Parses time 'arg' in "<seconds>[.<fraction>]" form into 'ts'. 'arg'
+    is modified in the process.
+   ========================================================================== */
 
-        /* minus encoutered without option, negative number?
-         * not likely!
-         */
 
-        fprintf(stderr, "negative seconds passed: '%s'\n", argv[1]);
-        return 1;
-    }
+static int sleep_parse
+(
+    char             *arg,         /* time to parse */
+    struct timespec  *ts           /* parsed time */
+)
+{
+    char             *sfractions;  /* fractions part of arg */
+    long              nano;        /* nanoseconds in single fraction */
+    long              seconds;     /* seconds part of arg */
+    long              fractions;   /* fractions part of arg */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-    /* no '-' option, assume argument is number
-     */
 
     nano = 1000000000l;
-    request.tv_sec = -1;
-    request.tv_nsec  = -1;
+    fractions = -1;
 
     /* check if fractions are passed or whole seconds
      */
 
-    for (sfractions = argv[1]; *sfractions != '\0'; ++sfractions)
+    for (sfractions = arg; *sfractions != '\0'; ++sfractions)
     {
         if (*sfractions == '.')
         {
             /* fractions are enabled, change that '.' to '\0', so
-             * argv[1] is valid seconds also increment sfractions
+             * arg is valid seconds also increment sfractions
              * so it points to first number of fraction string
              */
 
@@ -150,13 +306,21 @@ int u3_sleep_main
     {
         fprintf(stderr, "negative fractions of seconds passed: '%s'\n",
             sfractions);
-        return 1;
+        errno = EINVAL;
+        return -1;
     }
 
-    if (u3u_get_number(argv[1], &seconds) != 0)
+    if (u3u_get_number(arg, &seconds) != 0)
     {
         fprintf(stderr, "error parsing seconds part of argument\n");
-        return 1;
+        return -1;
+    }
+
+    if (seconds < 0)
+    {
+        fprintf(stderr, "negative seconds passed: '%s'\n", arg);
+        errno = EINVAL;
+        return -1;
     }
 
     /* tv_sec is time_t type, and u3u_get_number() gets pointer to long,
@@ -164,15 +328,15 @@ int u3_sleep_main
      * may lead to wrong values when sizeof(time_t) != sizeof(long)
      */
 
-    request.tv_sec = seconds;
+    ts->tv_sec = seconds;
 
     if (*sfractions)
     {
-        if (u3u_get_number(sfractions, &request.tv_nsec) != 0)
+        if (u3u_get_number(sfractions, &fractions) != 0)
         {
             fprintf(stderr, "error parsing fractions of seconds part of "
                 "argument\n");
-            return 1;
+            return -1;
         }
     }
 
@@ -188,36 +352,1693 @@ int u3_sleep_main
          */
 
         fprintf(stderr, "fractions cannot be bigger than 999999999\n");
-        return 1;
+        errno = EINVAL;
+        return -1;
     }
 
-    if (request.tv_nsec == -1l)
+    if (fractions == -1l)
     {
         /* fractions not set, so don't use them, set tv_nsec to 0,
          * so nanosleep() don't cry about wrong number there
          */
 
-        request.tv_nsec = 0;
+        fractions = 0;
     }
 
-    request.tv_nsec *= nano;
+    ts->tv_nsec = fractions * nano;
+    return 0;
+}
+
 
-    /* number parsed properly, now perform sleep
+/* ==========================================================================
+    Returns 'a' - 'b' in nanoseconds. Difference is capped at about an
+    hour both ways, callers only care about short differences anyway.
+   ========================================================================== */
+
+
+static long sleep_ts_diff
+(
+    const struct timespec  *a,  /* time to subtract from */
+    const struct timespec  *b   /* time to subtract */
+)
+{
+    long                    s;  /* difference of seconds */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (a->tv_sec - b->tv_sec > 3600)
+    {
+        return 3600l * 1000000000l;
+    }
+
+    if (a->tv_sec - b->tv_sec < -3600)
+    {
+        return -3600l * 1000000000l;
+    }
+
+    s = (long)(a->tv_sec - b->tv_sec);
+    return s * 1000000000l + (a->tv_nsec - b->tv_nsec);
+}
+
+
+/* ==========================================================================
+    Moves 'ts' by 'ns' nanoseconds, which may be negative.
+   ========================================================================== */
+
+
+static void sleep_ts_add
+(
+    struct timespec  *ts,  /* time to move */
+    long              ns   /* nanoseconds to move ts by */
+)
+{
+    ts->tv_sec += ns / 1000000000l;
+    ts->tv_nsec += ns % 1000000000l;
+
+    if (ts->tv_nsec >= 1000000000l)
+    {
+        ts->tv_nsec -= 1000000000l;
+        ++ts->tv_sec;
+    }
+
+    if (ts->tv_nsec < 0)
+    {
+        ts->tv_nsec += 1000000000l;
+        --ts->tv_sec;
+    }
+}
+
+
+/* ==========================================================================
+    Sleeps until monotonic clock reaches 'wake'. Deadline is absolute,
+    so after signal sleep is simply started again, and no time is lost
+    on the way, nor sleep gets longer with each signal.
+   ========================================================================== */
+
+
+static int sleep_until
+(
+    const struct timespec  *wake   /* monotonic time to wake up at */
+)
+{
+#if HAVE_CLOCK_NANOSLEEP
+    int                     err;   /* error from clock_nanosleep() */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, wake,
+        NULL)) != 0)
+    {
+        if (err != EINTR)
+        {
+            errno = err;
+            perror("clock_nanosleep()");
+            return -1;
+        }
+    }
+
+    return 0;
+#else /* HAVE_CLOCK_NANOSLEEP */
+    struct timespec         now;   /* current time */
+    struct timespec         left;  /* time left to wake */
+    long                    ns;    /* nanoseconds left to wake */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* no absolute sleep on this system, so compute relative sleep
+     * from deadline every time we are woken up
      */
 
-#if TEST_RUN
-    /* when we are running tests, we don't want to sleep because
-     * tests would be long and it would be hard to calculate how
-     * long did we really sleep. Instead we just print value that
-     * we would have slept for in normal execution.
-     *
-     * use seconds instead of request.tv_sec since, time_t is
-     * hard to print
+    for (;;)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if ((ns = sleep_ts_diff(wake, &now)) <= 0)
+        {
+            return 0;
+        }
+
+        left.tv_sec = ns / 1000000000l;
+        left.tv_nsec = ns % 1000000000l;
+
+        if (nanosleep(&left, NULL) != 0 && errno != EINTR)
+        {
+            perror("nanosleep()");
+            return -1;
+        }
+    }
+#endif /* HAVE_CLOCK_NANOSLEEP */
+}
+
+
+/* ==========================================================================
+    Prepares precise sleeps, that will end not earlier than 'deadline'.
+    Timer slack is lowered, so kernel does not delay wake ups on its own,
+    and then few short sleeps measure how late scheduler wakes us up,
+    that's how long we will busy wait before each deadline. These sleeps
+    are done only if they end well before 'deadline', so they count to
+    requested time.
+   ========================================================================== */
+
+
+static int sleep_spin_init
+(
+    struct sleep_spin      *s,        /* precise sleep to prepare */
+    const struct timespec  *deadline  /* first deadline to sleep to */
+)
+{
+    struct timespec         wake;     /* time to wake up at */
+    struct timespec         now;      /* current time */
+    long                    late;     /* how late single wake up was */
+    int                     i;        /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    s->slack = -1;
+
+#if HAVE_SYS_PRCTL_H && defined PR_SET_TIMERSLACK
+    s->slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+#endif
+
+    s->spin = SLEEP_SPIN_MIN;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (i = 0; i != SLEEP_CALIBRATE_ROUNDS; ++i)
+    {
+        wake = now;
+        sleep_ts_add(&wake, SLEEP_CALIBRATE_NS);
+
+        if (sleep_ts_diff(deadline, &wake) < U3_SLEEP_SPIN_MAX)
+        {
+            break;
+        }
+
+        if (sleep_until(&wake) != 0)
+        {
+            return -1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        late = sleep_ts_diff(&now, &wake);
+        s->spin = late > s->spin ? late : s->spin;
+    }
+
+    /* give it some margin, as wake ups are not always equally late,
+     * but don't spin for too long
      */
 
-    fprintf(stderr, "sleep for: %ld.%ld\n", seconds, request.tv_nsec);
+    s->spin += s->spin / 2;
+    s->spin = s->spin > U3_SLEEP_SPIN_MAX ? U3_SLEEP_SPIN_MAX : s->spin;
+    return 0;
+}
+
+
+/* ==========================================================================
+    Restores timer slack changed by sleep_spin_init().
+   ========================================================================== */
+
+
+static void sleep_spin_cleanup
+(
+    struct sleep_spin  *s  /* precise sleep to clean up */
+)
+{
+#if HAVE_SYS_PRCTL_H && defined PR_SET_TIMERSLACK
+    if (s->slack > 0)
+    {
+        prctl(PR_SET_TIMERSLACK, s->slack, 0, 0, 0);
+    }
 #else
-    nanosleep(&request, NULL);
+    (void)s;
 #endif
+}
+
+
+/* ==========================================================================
+    Sleeps until 'deadline'. When 's' is not NULL, sleep ends that much
+    before deadline, and the rest is busy waited on clock, since
+    scheduler would wake us up too late.
+   ========================================================================== */
+
+
+static int sleep_deadline
+(
+    const struct timespec    *deadline,  /* monotonic time to return at */
+    const struct sleep_spin  *s          /* precise sleep, or NULL */
+)
+{
+    struct timespec           wake;      /* time to wake up at */
+    struct timespec           now;       /* current time */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (s == NULL)
+    {
+        return sleep_until(deadline);
+    }
+
+    wake = *deadline;
+    sleep_ts_add(&wake, -s->spin);
+
+    if (sleep_until(&wake) != 0)
+    {
+        return -1;
+    }
+
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    while (sleep_ts_diff(deadline, &now) > 0);
+
     return 0;
 }
+
+
+/* ==========================================================================
+    Prints tick number to stdout every 'interval', until 'count' ticks
+    are printed, or forever when 'count' is 0. Ticks are at multiples of
+    interval from the start, so time spent on printing, or on being late,
+    does not move the schedule. When we wake up so late, that next ticks
+    are due already, these are reported as missed and skipped, so tick
+    numbers always tell how many intervals passed since the start.
+   ========================================================================== */
+
+
+static int sleep_every
+(
+    const struct timespec  *interval,  /* time between ticks */
+    unsigned long           count,     /* number of ticks, 0 for infinite */
+    int                     precise    /* wake up with busy wait */
+)
+{
+    struct sleep_spin       spin;      /* precise sleep state */
+    struct timespec         deadline;  /* time of next tick */
+    struct timespec         now;       /* current time */
+    unsigned long           tick;      /* number of current tick */
+    unsigned long           missed;    /* ticks we were too late for */
+    long                    ins;       /* interval in nanoseconds */
+    int                     ret;       /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    if (interval->tv_sec > LONG_MAX / 2 - deadline.tv_sec)
+    {
+        fprintf(stderr, "interval is too long\n");
+        return -1;
+    }
+
+    /* late wake ups are never measured longer than an hour, so ticks
+     * can be missed only with intervals shorter than that
+     */
+
+    ins = interval->tv_sec < 3600 ?
+        (long)interval->tv_sec * 1000000000l + interval->tv_nsec : 0;
+
+    deadline.tv_sec += interval->tv_sec;
+    sleep_ts_add(&deadline, interval->tv_nsec);
+    spin.spin = 0;
+    spin.slack = -1;
+
+    if (precise && sleep_spin_init(&spin, &deadline) != 0)
+    {
+        sleep_spin_cleanup(&spin);
+        return -1;
+    }
+
+    ret = 0;
+
+    for (tick = 1;; ++tick)
+    {
+        if ((ret = sleep_deadline(&deadline, precise ? &spin : NULL)) != 0)
+        {
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        missed = ins ? sleep_ts_diff(&now, &deadline) / ins : 0;
+
+        if (count && missed > count - tick)
+        {
+            missed = count - tick;
+        }
+
+        if (missed)
+        {
+            fprintf(stderr, "missed %lu ticks\n", missed);
+            tick += missed;
+            sleep_ts_add(&deadline, (long)missed * ins);
+        }
+
+        if (printf("%lu\n", tick) < 0 || fflush(stdout) != 0)
+        {
+            perror("fwrite()");
+            ret = -1;
+            break;
+        }
+
+        if (tick == count)
+        {
+            break;
+        }
+
+        deadline.tv_sec += interval->tv_sec;
+        sleep_ts_add(&deadline, interval->tv_nsec);
+    }
+
+    if (precise)
+    {
+        sleep_spin_cleanup(&spin);
+    }
+
+    return ret;
+}
+
+
+/* ==========================================================================
+    Returns timer slack of calling thread, or -1 when it's not known.
+   ========================================================================== */
+
+
+static long sleep_slack(void)
+{
+#if HAVE_SYS_PRCTL_H && defined PR_GET_TIMERSLACK
+    return prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+#else
+    return -1;
+#endif
+}
+
+
+/* ==========================================================================
+    Returns index of histogram bucket for overshoot 'ns'.
+   ========================================================================== */
+
+
+static unsigned sleep_stats_bucket
+(
+    long      ns   /* overshoot to find bucket for */
+)
+{
+    unsigned  msb; /* most significant bit of ns */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (ns < SLEEP_STATS_SUB)
+    {
+        return ns < 0 ? 0 : (unsigned)ns;
+    }
+
+    for (msb = SLEEP_STATS_SUB_BITS; ns >> (msb + 1); ++msb)
+    {
+        continue;
+    }
+
+    return (msb - SLEEP_STATS_SUB_BITS + 1) * SLEEP_STATS_SUB +
+        ((ns >> (msb - SLEEP_STATS_SUB_BITS)) & (SLEEP_STATS_SUB - 1));
+}
+
+
+/* ==========================================================================
+    Returns smallest overshoot that goes to histogram bucket 'bucket'.
+   ========================================================================== */
+
+
+static long sleep_stats_bucket_min
+(
+    unsigned  bucket  /* bucket to get lower bound of */
+)
+{
+    unsigned  msb;    /* most significant bit of values in bucket */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (bucket < SLEEP_STATS_SUB)
+    {
+        return (long)bucket;
+    }
+
+    msb = bucket / SLEEP_STATS_SUB + SLEEP_STATS_SUB_BITS - 1;
+    return (long)(SLEEP_STATS_SUB + bucket % SLEEP_STATS_SUB) <<
+        (msb - SLEEP_STATS_SUB_BITS);
+}
+
+
+/* ==========================================================================
+    Returns upper bound of printed histogram row 'row', values in it are
+    smaller than that. Rows go in 1-2-5 series from 1us, last row has no
+    upper bound, and LONG_MAX is returned for it.
+   ========================================================================== */
+
+
+static long sleep_stats_row_max
+(
+    unsigned  row    /* row to get upper bound of */
+)
+{
+    long      ns;    /* upper bound of row */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (row == SLEEP_STATS_ROWS - 1)
+    {
+        return LONG_MAX;
+    }
+
+    for (ns = 1000; row >= 3; row -= 3)
+    {
+        ns *= 10;
+    }
+
+    return ns * (row == 0 ? 1 : row == 1 ? 2 : 5);
+}
+
+
+/* ==========================================================================
+    Adds sample to 'st'. Sleep of 'request' took 'mono' time on monotonic
+    clock, and 'wall' on realtime clock.
+   ========================================================================== */
+
+
+static void sleep_stats_add
+(
+    struct sleep_stats  *st,       /* stats to add sample to */
+    long                 request,  /* requested sleep time */
+    long                 mono,     /* monotonic time slept */
+    long                 wall      /* wall time slept */
+)
+{
+    long                 over;     /* how late we woke up */
+    unsigned             row;      /* row of printed histogram */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    over = mono - request;
+    ++st->n;
+    st->wall += wall;
+    st->mono += mono;
+    st->over += over;
+    st->min = over < st->min ? over : st->min;
+    st->max = over > st->max ? over : st->max;
+    ++st->hist[sleep_stats_bucket(over)];
+
+    for (row = 0; over >= sleep_stats_row_max(row); ++row)
+    {
+        continue;
+    }
+
+    ++st->rows[row];
+}
+
+
+/* ==========================================================================
+    Returns overshoot, which 'percent' percent of samples in 'st' do not
+    exceed. Value is upper bound of histogram bucket, but never bigger
+    than the biggest overshoot seen.
+   ========================================================================== */
+
+
+static long sleep_stats_percentile
+(
+    const struct sleep_stats  *st,       /* stats to get percentile of */
+    unsigned                   percent   /* percentile to get */
+)
+{
+    unsigned long              rank;     /* number of sample to find */
+    unsigned long              seen;     /* samples in buckets so far */
+    unsigned                   b;        /* histogram bucket */
+    long                       ns;       /* upper bound of bucket */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    rank = st->n / 100 * percent + (st->n % 100 * percent + 99) / 100;
+    seen = 0;
+
+    for (b = 0; b != SLEEP_STATS_BUCKETS - 1; ++b)
+    {
+        if ((seen += st->hist[b]) >= rank)
+        {
+            break;
+        }
+    }
+
+    ns = sleep_stats_bucket_min(b + 1) - 1;
+    ns = ns > st->max ? st->max : ns;
+    return ns < st->min ? st->min : ns;
+}
+
+
+/* ==========================================================================
+    Formats 'ns' as microseconds with nanosecond precision into 'buf'.
+   ========================================================================== */
+
+
+static const char *sleep_stats_us
+(
+    char  *buf,  /* buffer of at least 32 bytes */
+    long   ns    /* time to format */
+)
+{
+    sprintf(buf, "%s%ld.%03ld us", ns < 0 ? "-" : "",
+        labs(ns / 1000), labs(ns % 1000));
+    return buf;
+}
+
+
+/* ==========================================================================
+    Formats upper bound of histogram row 'row' into 'buf', in units that
+    make it a whole number.
+   ========================================================================== */
+
+
+static const char *sleep_stats_unit
+(
+    char      *buf,  /* buffer of at least 32 bytes */
+    unsigned   row   /* row to format bound of */
+)
+{
+    long       ns;   /* upper bound of row */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    ns = sleep_stats_row_max(row);
+
+    if (ns % 1000000000l == 0)
+    {
+        sprintf(buf, "%ld s", ns / 1000000000l);
+    }
+    else if (ns % 1000000l == 0)
+    {
+        sprintf(buf, "%ld ms", ns / 1000000l);
+    }
+    else
+    {
+        sprintf(buf, "%ld us", ns / 1000l);
+    }
+
+    return buf;
+}
+
+
+/* ==========================================================================
+    Prints report of 'st' to stdout. 'request' is time of single sleep,
+    and 'slack' is timer slack that was in effect for them.
+   ========================================================================== */
+
+
+static int sleep_stats_print
+(
+    const struct sleep_stats  *st,       /* stats to print */
+    long                       request,  /* requested sleep time */
+    long                       slack     /* timer slack, or -1 */
+)
+{
+    char                       b1[32];   /* formatted value */
+    char                       b2[32];   /* formatted value */
+    unsigned long              most;     /* samples in biggest row */
+    unsigned                   first;    /* first row with samples */
+    unsigned                   last;     /* last row with samples */
+    unsigned                   r;        /* printed row */
+    int                        bar;      /* length of row bar */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    printf("samples.............: %lu\n", st->n);
+    printf("requested...........: %s\n", sleep_stats_us(b1, request));
+
+    if (slack < 0)
+    {
+        printf("timer slack.........: unknown\n");
+    }
+    else
+    {
+        printf("timer slack.........: %s\n", sleep_stats_us(b1, slack));
+    }
+
+    printf("wall elapsed mean...: %s\n",
+        sleep_stats_us(b1, (long)(st->wall / (int64_t)st->n)));
+    printf("mono elapsed mean...: %s\n",
+        sleep_stats_us(b1, (long)(st->mono / (int64_t)st->n)));
+    printf("overshoot mean......: %s\n",
+        sleep_stats_us(b1, (long)(st->over / (int64_t)st->n)));
+    printf("overshoot min.......: %s\n", sleep_stats_us(b1, st->min));
+    printf("overshoot p50.......: %s\n",
+        sleep_stats_us(b1, sleep_stats_percentile(st, 50)));
+    printf("overshoot p99.......: %s\n",
+        sleep_stats_us(b1, sleep_stats_percentile(st, 99)));
+    printf("overshoot max.......: %s\n", sleep_stats_us(b1, st->max));
+    printf("overshoot histogram:\n");
+
+    most = 0;
+    first = SLEEP_STATS_ROWS;
+    last = 0;
+
+    for (r = 0; r != SLEEP_STATS_ROWS; ++r)
+    {
+        if (st->rows[r] == 0)
+        {
+            continue;
+        }
+
+        first = first == SLEEP_STATS_ROWS ? r : first;
+        last = r;
+        most = st->rows[r] > most ? st->rows[r] : most;
+    }
+
+    for (r = first; r <= last; ++r)
+    {
+        bar = (int)((st->rows[r] * SLEEP_STATS_BAR + most - 1) / most);
+
+        if (r == 0)
+        {
+            printf("  %8s .. %-8s", "", sleep_stats_unit(b2, r));
+        }
+        else if (r == SLEEP_STATS_ROWS - 1)
+        {
+            printf("  %8s .. %-8s", sleep_stats_unit(b1, r - 1), "");
+        }
+        else
+        {
+            printf("  %8s .. %-8s", sleep_stats_unit(b1, r - 1),
+                sleep_stats_unit(b2, r));
+        }
+
+        printf(" |%-*.*s| %lu (%lu.%lu%%)\n", SLEEP_STATS_BAR, bar,
+            "########################################", st->rows[r],
+            st->rows[r] * 100 / st->n, st->rows[r] * 1000 / st->n % 10);
+    }
+
+    if (fflush(stdout) != 0)
+    {
+        perror("fwrite()");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Sleeps for 'request' time. When sleep is interrupted by signal, which
+    was handled, sleep continues for the time that was left.
+   ========================================================================== */
+
+
+static int sleep_relative
+(
+    struct timespec  *request  /* time to sleep, it's modified */
+)
+{
+    while (nanosleep(request, request) != 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("nanosleep()");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Sleeps for 'request' time, 'count' times, and measures how long each
+    sleep really took, on monotonic and realtime clocks. Then prints
+    report on how late sleeps were, see sleep_stats_print().
+   ========================================================================== */
+
+
+static int sleep_stats
+(
+    const struct timespec  *request,   /* time of single sleep */
+    unsigned long           count,     /* number of sleeps */
+    int                     precise    /* wake up with busy wait */
+)
+{
+    struct sleep_stats      st;        /* measured sleeps */
+    struct sleep_spin       spin;      /* precise sleep state */
+    struct timespec         deadline;  /* time to wake up at */
+    struct timespec         left;      /* time left to sleep */
+    struct timespec         mono[2];   /* monotonic time around sleep */
+    struct timespec         wall[2];   /* wall time around sleep */
+    unsigned long           i;         /* sample number */
+    long                    slack;     /* timer slack in effect */
+    long                    rns;       /* request in nanoseconds */
+    int                     ret;       /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (request->tv_sec >= 3600)
+    {
+        /* differences of times are capped to an hour
+         */
+
+        fprintf(stderr, "time is too long for stats\n");
+        return -1;
+    }
+
+    rns = (long)request->tv_sec * 1000000000l + request->tv_nsec;
+    memset(&st, 0, sizeof(st));
+    st.min = LONG_MAX;
+    st.max = LONG_MIN;
+
+    if (precise)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        sleep_ts_add(&deadline, rns);
+
+        if (sleep_spin_init(&spin, &deadline) != 0)
+        {
+            sleep_spin_cleanup(&spin);
+            return -1;
+        }
+    }
+
+    /* read it only now, precise sleep changes it
+     */
+
+    slack = sleep_slack();
+    ret = 0;
+
+    for (i = 0; i != count; ++i)
+    {
+        clock_gettime(CLOCK_REALTIME, &wall[0]);
+        clock_gettime(CLOCK_MONOTONIC, &mono[0]);
+
+        if (precise)
+        {
+            deadline = mono[0];
+            sleep_ts_add(&deadline, rns);
+            ret = sleep_deadline(&deadline, &spin);
+        }
+        else
+        {
+            left = *request;
+            ret = sleep_relative(&left);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &mono[1]);
+        clock_gettime(CLOCK_REALTIME, &wall[1]);
+
+        if (ret != 0)
+        {
+            break;
+        }
+
+        sleep_stats_add(&st, rns, sleep_ts_diff(&mono[1], &mono[0]),
+            sleep_ts_diff(&wall[1], &wall[0]));
+    }
+
+    if (precise)
+    {
+        sleep_spin_cleanup(&spin);
+    }
+
+    return ret == 0 ? sleep_stats_print(&st, rns, slack) : -1;
+}
+
+
+/* ==========================================================================
+    Returns current tick of wheel 'w', that is number of whole ticks since
+    wheel was initialized.
+   ========================================================================== */
+
+
+static uint64_t sleep_wheel_now
+(
+    const struct sleep_wheel  *w     /* wheel to get tick of */
+)
+{
+    struct timespec            now;  /* current time */
+    uint64_t                   ns;   /* nanoseconds since base */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (uint64_t)(now.tv_sec - w->base.tv_sec) * 1000000000u +
+        now.tv_nsec - w->base.tv_nsec;
+    return ns / SLEEP_WHEEL_TICK_NS;
+}
+
+
+/* ==========================================================================
+    Returns index of lowest set bit in 'x', which cannot be 0.
+   ========================================================================== */
+
+
+static unsigned sleep_ctz
+(
+    uint64_t  x   /* bits to look at */
+)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(x);
+#else
+    unsigned  n;  /* index of bit */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (n = 0; (x & 1) == 0; ++n)
+    {
+        x >>= 1;
+    }
+
+    return n;
+#endif
+}
+
+
+/* ==========================================================================
+    Finds tick of next event in wheel 'w' and stores it in 'next'. Event
+    is either expiry of level 0 slot, or start of higher level slot,
+    when its timers are moved to lower levels. Every level is rotated so
+    that slot of current tick is first, and first used slot is found with
+    single bit scan.
+
+    Returns 0 when there is next event, or -1 when wheel is empty.
+   ========================================================================== */
+
+
+static int sleep_wheel_next
+(
+    const struct sleep_wheel  *w,      /* wheel to look into */
+    uint64_t                  *next    /* tick of next event */
+)
+{
+    uint64_t                   first;  /* first slot not processed yet */
+    uint64_t                   used;   /* used slots, rotated */
+    uint64_t                   t;      /* tick of event on level */
+    unsigned                   shift;  /* bits in tick below level */
+    unsigned                   idx;    /* index of first slot */
+    int                        l;      /* level of wheel */
+    int                        found;  /* any event was found */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    found = 0;
+    *next = UINT64_MAX;
+
+    for (l = 0; l != SLEEP_WHEEL_LEVELS; ++l)
+    {
+        if (w->used[l] == 0)
+        {
+            continue;
+        }
+
+        shift = l * SLEEP_WHEEL_BITS;
+        first = (w->tick + ((uint64_t)1 << shift) - 1) >> shift;
+        idx = (unsigned)(first & (SLEEP_WHEEL_SLOTS - 1));
+        used = w->used[l] >> idx;
+        used |= idx ? w->used[l] << (SLEEP_WHEEL_SLOTS - idx) : 0;
+        t = (first + sleep_ctz(used)) << shift;
+        *next = t < *next ? t : *next;
+        found = 1;
+    }
+
+    return found ? 0 : -1;
+}
+
+
+/* ==========================================================================
+    Arms timerfd of wheel 'w' to next event, or disarms it when there
+    are no timers.
+   ========================================================================== */
+
+
+static int sleep_wheel_arm
+(
+    struct sleep_wheel  *w      /* wheel to arm timer of */
+)
+{
+#if HAVE_SYS_TIMERFD_H
+    struct itimerspec    its;   /* when timerfd should expire */
+    uint64_t             next;  /* tick of next event */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    memset(&its, 0, sizeof(its));
+    w->armed = UINT64_MAX;
+
+    if (sleep_wheel_next(w, &next) == 0)
+    {
+        its.it_value = w->base;
+        its.it_value.tv_sec += (time_t)(next / SLEEP_WHEEL_HZ);
+        sleep_ts_add(&its.it_value,
+            (long)(next % SLEEP_WHEEL_HZ) * SLEEP_WHEEL_TICK_NS);
+        w->armed = next;
+    }
+
+    return timerfd_settime(w->fd, TFD_TIMER_ABSTIME, &its, NULL);
+#else /* HAVE_SYS_TIMERFD_H */
+    (void)w;
+    return 0;
+#endif /* HAVE_SYS_TIMERFD_H */
+}
+
+
+/* ==========================================================================
+    Links timer 't' into slot of wheel 'w'. Level is chosen by how far
+    in future timer expires, so that slot covers expiry tick and is
+    processed (expired, or moved down a level) not later than that.
+   ========================================================================== */
+
+
+static void sleep_wheel_insert
+(
+    struct sleep_wheel  *w,       /* wheel to insert timer to */
+    struct sleep_timer  *t        /* timer to insert */
+)
+{
+    struct sleep_timer **head;    /* head of slot for timer */
+    uint64_t             target;  /* tick of slot for timer */
+    uint64_t             delta;   /* ticks left to target */
+    unsigned             shift;   /* bits in tick below level */
+    int                  l;       /* level of wheel */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    target = t->expires < w->tick ? w->tick : t->expires;
+
+    if (target - w->tick >= SLEEP_WHEEL_RANGE)
+    {
+        /* too far for whole wheel, it will get to the top level
+         * slot, and will be inserted again from there
+         */
+
+        target = w->tick + SLEEP_WHEEL_RANGE - 1;
+    }
+
+    delta = target - w->tick;
+
+    for (l = 0; l != SLEEP_WHEEL_LEVELS - 1; ++l)
+    {
+        if (delta < (uint64_t)1 << (SLEEP_WHEEL_BITS * (l + 1)))
+        {
+            break;
+        }
+    }
+
+    shift = l * SLEEP_WHEEL_BITS;
+    t->level = (unsigned char)l;
+    t->slot = (unsigned char)((target >> shift) & (SLEEP_WHEEL_SLOTS - 1));
+    head = &w->slots[l][t->slot];
+
+    t->next = *head;
+    t->pprev = head;
+
+    if (*head)
+    {
+        (*head)->pprev = &t->next;
+    }
+
+    *head = t;
+    w->used[l] |= (uint64_t)1 << t->slot;
+}
+
+
+/* ==========================================================================
+    Unlinks timer 't' from its slot of wheel 'w'.
+   ========================================================================== */
+
+
+static void sleep_wheel_remove
+(
+    struct sleep_wheel  *w,  /* wheel to remove timer from */
+    struct sleep_timer  *t   /* timer to remove */
+)
+{
+    *t->pprev = t->next;
+
+    if (t->next)
+    {
+        t->next->pprev = t->pprev;
+    }
+
+    if (w->slots[t->level][t->slot] == NULL)
+    {
+        w->used[t->level] &= ~((uint64_t)1 << t->slot);
+    }
+}
+
+
+/* ==========================================================================
+    Takes all timers from slot 'slot' of 'level' of wheel 'w'. Returned
+    list still can have timers removed from it, as first of them points
+    to 'list'.
+   ========================================================================== */
+
+
+static void sleep_wheel_take
+(
+    struct sleep_wheel   *w,      /* wheel to take timers from */
+    int                   level,  /* level of slot */
+    unsigned              slot,   /* slot to take timers from */
+    struct sleep_timer  **list    /* taken timers */
+)
+{
+    *list = w->slots[level][slot];
+    w->slots[level][slot] = NULL;
+    w->used[level] &= ~((uint64_t)1 << slot);
+
+    if (*list)
+    {
+        (*list)->pprev = list;
+    }
+}
+
+
+/* ==========================================================================
+    Processes event at tick 'tick' of wheel 'w'. Timers from higher
+    levels, whose slots start at this tick, are moved down, and then
+    timers of level 0 slot expire, and their functions are called.
+    Functions may add and cancel any timers.
+
+    Returns number of expired timers.
+   ========================================================================== */
+
+
+static int sleep_wheel_process
+(
+    struct sleep_wheel  *w,      /* wheel to process */
+    uint64_t             tick    /* tick of event */
+)
+{
+    struct sleep_timer  *list;   /* timers taken from slot */
+    struct sleep_timer  *t;      /* timer from list */
+    unsigned             shift;  /* bits in tick below level */
+    int                  l;      /* level of wheel */
+    int                  n;      /* number of expired timers */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    w->tick = tick;
+
+    for (l = SLEEP_WHEEL_LEVELS - 1; l != 0; --l)
+    {
+        shift = l * SLEEP_WHEEL_BITS;
+
+        if (tick & (((uint64_t)1 << shift) - 1))
+        {
+            /* not a start of slot on this level
+             */
+
+            continue;
+        }
+
+        sleep_wheel_take(w, l,
+            (unsigned)(tick >> shift) & (SLEEP_WHEEL_SLOTS - 1), &list);
+
+        while ((t = list) != NULL)
+        {
+            sleep_wheel_remove(w, t);
+            sleep_wheel_insert(w, t);
+        }
+    }
+
+    /* timers added by expiry functions must go to future ticks, not
+     * to slot that is being expired now
+     */
+
+    sleep_wheel_take(w, 0, (unsigned)tick & (SLEEP_WHEEL_SLOTS - 1), &list);
+    w->tick = tick + 1;
+    n = 0;
+
+    while ((t = list) != NULL)
+    {
+        sleep_wheel_remove(w, t);
+        t->pending = 0;
+        --w->count;
+        ++n;
+        t->fn((struct u3_timer *)t, t->arg);
+    }
+
+    return n;
+}
+
+
+#if TEST_RUN == 0
+
+/* ==========================================================================
+    Sleeps for 'request' time, and wakes up as close to deadline as
+    possible, see sleep_spin_init() for how.
+   ========================================================================== */
+
+
+static int sleep_precise
+(
+    struct timespec    *request   /* time to sleep */
+)
+{
+    struct sleep_spin   spin;     /* precise sleep state */
+    struct timespec     deadline; /* time to return at */
+    int                 ret;      /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    if (deadline.tv_sec > LONG_MAX - request->tv_sec - 1)
+    {
+        /* deadline does not fit in time_t, that's never going to
+         * wake up anyway
+         */
+
+        return sleep_relative(request);
+    }
+
+    deadline.tv_sec += request->tv_sec;
+    sleep_ts_add(&deadline, request->tv_nsec);
+
+    if ((ret = sleep_spin_init(&spin, &deadline)) == 0)
+    {
+        ret = sleep_deadline(&deadline, &spin);
+    }
+
+    sleep_spin_cleanup(&spin);
+    return ret;
+}
+
+#endif /* TEST_RUN == 0 */
+
+
+/* ==========================================================================
+                       __     __ _          ____
+        ____   __  __ / /_   / /(_)_____   / __/__  __ ____   _____ _____
+       / __ \ / / / // __ \ / // // ___/  / /_ / / / // __ \ / ___// ___/
+      / /_/ // /_/ // /_/ // // // /__   / __// /_/ // / / // /__ (__  )
+     / .___/ \__,_//_.___//_//_/ \___/  /_/   \__,_//_/ /_/ \___//____/
+    /_/
+   ========================================================================== */
+
+
+/* ==========================================================================
+    Parses 'duration' in "<seconds>[.<fraction>]" form, the same sleep
+    program takes, into 'ts'. Errors are printed to stderr, the same way
+    sleep program prints them.
+
+    Returns 0 on success, or -1 on error.
+
+    errno:
+            EINVAL      duration is NULL or is not a valid duration
+            ERANGE      seconds or fractions do not fit in long
+   ========================================================================== */
+
+
+int u3_sleep_parse
+(
+    const char       *duration,  /* duration to parse */
+    struct timespec  *ts         /* parsed duration */
+)
+{
+    char              buf[64];   /* copy of duration, it's modified */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (duration == NULL || ts == NULL || strlen(duration) >= sizeof(buf))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    strcpy(buf, duration);
+    return sleep_parse(buf, ts);
+}
+
+
+/* ==========================================================================
+    Initializes empty timer wheel 'timers'. Wheel has single timerfd,
+    which becomes readable when any timer expires, so it can be polled
+    with any other descriptors of host. Host then calls u3_timers_run(),
+    which calls functions of expired timers. Nothing is allocated, no
+    matter how many timers are added, and no threads are created.
+
+    Returns 0 on success, or -1 on error.
+
+    errno:
+            EINVAL      timers is NULL
+            ENOSYS      system has no timerfd
+            other       from timerfd_create()
+   ========================================================================== */
+
+
+int u3_timers_init
+(
+    struct u3_timers    *timers  /* wheel to initialize */
+)
+{
+    struct sleep_wheel  *w;      /* wheel inside of timers */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (timers == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w = (struct sleep_wheel *)timers->priv.data;
+    memset(w, 0, sizeof(*w));
+    w->armed = UINT64_MAX;
+    clock_gettime(CLOCK_MONOTONIC, &w->base);
+
+#if HAVE_SYS_TIMERFD_H
+    w->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return w->fd == -1 ? -1 : 0;
+#else /* HAVE_SYS_TIMERFD_H */
+    w->fd = -1;
+    errno = ENOSYS;
+    return -1;
+#endif /* HAVE_SYS_TIMERFD_H */
+}
+
+
+/* ==========================================================================
+    Returns file descriptor of 'timers', which becomes readable when it's
+    time to call u3_timers_run(). Descriptor is non-blocking, and it's
+    owned by wheel.
+   ========================================================================== */
+
+
+int u3_timers_fd
+(
+    struct u3_timers  *timers  /* wheel to get descriptor of */
+)
+{
+    return ((struct sleep_wheel *)timers->priv.data)->fd;
+}
+
+
+/* ==========================================================================
+    Closes descriptor of 'timers'. Pending timers are simply forgotten,
+    and their functions are never called.
+   ========================================================================== */
+
+
+void u3_timers_cleanup
+(
+    struct u3_timers    *timers  /* wheel to clean up */
+)
+{
+    struct sleep_wheel  *w;      /* wheel inside of timers */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    w = (struct sleep_wheel *)timers->priv.data;
+
+    if (w->fd != -1)
+    {
+        close(w->fd);
+        w->fd = -1;
+    }
+}
+
+
+/* ==========================================================================
+    Initializes 'timer', so it's not pending. It must be called once,
+    before timer is added for the first time, after that timer can be
+    added and cancelled any number of times. Pending timer must not be
+    initialized again. Nothing is allocated, so timer does not need to be
+    cleaned up.
+   ========================================================================== */
+
+
+void u3_timer_init
+(
+    struct u3_timer  *timer  /* timer to initialize */
+)
+{
+    memset(timer->priv.data, 0, sizeof(struct sleep_timer));
+}
+
+
+/* ==========================================================================
+    Adds 'timer' to 'timers', after 'delay' its 'fn' will be called with
+    'arg' from u3_timers_run(). Timers expire on ticks of 1ms, never
+    before delay passes. When timer is already pending, it's rescheduled.
+    It's O(1) operation, timer is just linked into one of wheel slots.
+    Timer can be added again from its own function. Timer must have been
+    initialized with u3_timer_init().
+
+    Returns 0 on success, or -1 on error.
+
+    errno:
+            EINVAL      any argument is NULL, or delay is invalid
+            other       from timerfd_settime()
+   ========================================================================== */
+
+
+int u3_timer_add
+(
+    struct u3_timers       *timers,  /* wheel to add timer to */
+    struct u3_timer        *timer,   /* timer to add */
+    const struct timespec  *delay,   /* time after which timer expires */
+    u3_timer_fn             fn,      /* function to call on expiry */
+    void                   *arg      /* argument for fn */
+)
+{
+    struct sleep_wheel     *w;       /* wheel inside of timers */
+    struct sleep_timer     *t;       /* timer inside of timer */
+    uint64_t                ticks;   /* delay in ticks */
+    uint64_t                now;     /* current tick */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (timers == NULL || timer == NULL || delay == NULL || fn == NULL ||
+        delay->tv_sec < 0 || delay->tv_nsec < 0 ||
+        delay->tv_nsec >= 1000000000l)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w = (struct sleep_wheel *)timers->priv.data;
+    t = (struct sleep_timer *)timer->priv.data;
+
+    if (t->pending)
+    {
+        sleep_wheel_remove(w, t);
+        --w->count;
+    }
+
+    /* round delay up, and since current tick has already started,
+     * add one more, so that timer never expires too early
+     */
+
+    now = sleep_wheel_now(w);
+    ticks = (uint64_t)delay->tv_sec < SLEEP_WHEEL_RANGE ?
+        (uint64_t)delay->tv_sec * SLEEP_WHEEL_HZ +
+        (delay->tv_nsec + SLEEP_WHEEL_TICK_NS - 1) / SLEEP_WHEEL_TICK_NS :
+        (uint64_t)1 << 62;
+
+    t->expires = now + ticks + (ticks != 0);
+    t->fn = fn;
+    t->arg = arg;
+    t->pending = 1;
+    sleep_wheel_insert(w, t);
+    ++w->count;
+
+    if (w->running == 0 && t->expires < w->armed)
+    {
+        return sleep_wheel_arm(w);
+    }
+
+    return 0;
+}
+
+
+/* ==========================================================================
+    Cancels pending 'timer' of 'timers', its function will not be called.
+    It's O(1) operation, timer is just unlinked from wheel slot. Timer
+    can be cancelled from function of any timer, including itself.
+
+    Returns 0 when timer was cancelled, or -1 when it was not pending.
+
+    errno:
+            EINVAL      timers or timer is NULL
+            ENOENT      timer is not pending, it has expired already
+   ========================================================================== */
+
+
+int u3_timer_cancel
+(
+    struct u3_timers    *timers,  /* wheel timer was added to */
+    struct u3_timer     *timer    /* timer to cancel */
+)
+{
+    struct sleep_wheel  *w;       /* wheel inside of timers */
+    struct sleep_timer  *t;       /* timer inside of timer */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (timers == NULL || timer == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w = (struct sleep_wheel *)timers->priv.data;
+    t = (struct sleep_timer *)timer->priv.data;
+
+    if (t->pending == 0)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    /* timerfd stays armed, it will wake host up for nothing at
+     * most once, that is cheaper than finding next event now
+     */
+
+    sleep_wheel_remove(w, t);
+    t->pending = 0;
+    --w->count;
+    return 0;
+}
+
+
+/* ==========================================================================
+    Expires all timers of 'timers', whose time has come, and calls their
+    functions. Then arms timerfd for next event. It should be called
+    when descriptor from u3_timers_fd() is readable, but it's fine to
+    call it at any time. Empty stretches of wheel are skipped, so it's
+    cheap no matter how long it was not called.
+
+    Returns number of expired timers, or -1 on error.
+
+    errno:
+            EINVAL      timers is NULL
+            other       from timerfd_settime()
+   ========================================================================== */
+
+
+int u3_timers_run
+(
+    struct u3_timers    *timers  /* wheel to run */
+)
+{
+    struct sleep_wheel  *w;      /* wheel inside of timers */
+    uint64_t             now;    /* current tick */
+    uint64_t             next;   /* tick of next event */
+    uint64_t             exp;    /* number of timerfd expirations */
+    int                  n;      /* number of expired timers */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (timers == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w = (struct sleep_wheel *)timers->priv.data;
+
+    /* clear readability of descriptor, we know what expired anyway
+     */
+
+    if (w->fd != -1 && read(w->fd, &exp, sizeof(exp)) < 0)
+    {
+        exp = 0;
+    }
+
+    w->running = 1;
+    now = sleep_wheel_now(w);
+    n = 0;
+
+    while (sleep_wheel_next(w, &next) == 0 && next <= now)
+    {
+        n += sleep_wheel_process(w, next);
+    }
+
+    if (w->tick <= now)
+    {
+        /* there are no events up to now, so wheel can skip these
+         * ticks at once
+         */
+
+        w->tick = now + 1;
+    }
+
+    w->running = 0;
+    return sleep_wheel_arm(w) == 0 ? n : -1;
+}
+
+
+/* ==========================================================================
+                                              _
+                           ____ ___   ____ _ (_)____
+                          / __ `__ \ / __ `// // __ \
+                         / / / / / // /_/ // // / / /
+                        /_/ /_/ /_/ \__,_//_//_/ /_/
+
+   ========================================================================== */
+
+
+#if U3_STANDALONE
+int main
+#else
+int u3_sleep_main
+#endif
+(
+    int              argc,
+    char            *argv[]
+)
+{
+    struct timespec  request;
+    char            *every;
+    char            *arg;
+    long             count;
+    int              precise;
+    int              stats;
+    int              i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    precise = 0;
+    stats = 0;
+    every = NULL;
+    count = 0;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+        {
+            precise = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = 1;
+            continue;
+        }
+
+        if (sleep_is_opt(argv[i], "--every"))
+        {
+            if ((every = sleep_optarg(argc, argv, &i)) == NULL)
+            {
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (sleep_is_opt(argv[i], "--count"))
+        {
+            if ((arg = sleep_optarg(argc, argv, &i)) == NULL ||
+                u3u_get_count(arg, &count) != 0)
+            {
+                return 1;
+            }
+
+            if (count <= 0)
+            {
+                fprintf(stderr, "count must be bigger than 0\n");
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (argv[i][1] == 'v')
+        {
+            /* '-v' passed, print version and exit
+            */
+
+            fprintf(stderr, "sleep " U3_SLEEP_VERSION "\n"
+                    "u3 " U3_VERSION "\n");
+            return 0;
+        }
+
+        if (argv[i][1] == 'h')
+        {
+            /* '-h' passed, print help and exit
+            */
+
+            print_help();
+            return 0;
+        }
+
+        /* minus encoutered without option, negative number?
+         * not likely!
+         */
+
+        fprintf(stderr, "negative seconds passed: '%s'\n", argv[i]);
+        return 1;
+    }
+
+    if (argc - i != (every ? 0 : 1))
+    {
+        fprintf(stderr, "wrong number of arguments passed\n");
+        print_help();
+        return 1;
+    }
+
+    if (count && every == NULL && stats == 0)
+    {
+        fprintf(stderr, "count can only be used with --every or --stats\n");
+        return 1;
+    }
+
+    if (stats && every)
+    {
+        fprintf(stderr, "stats cannot be used with --every\n");
+        return 1;
+    }
+
+    if (sleep_parse(every ? every : argv[i], &request) != 0)
+    {
+        return 1;
+    }
+
+    if (every)
+    {
+        /* ticks are really printed even in tests, intervals there
+         * are short
+         */
+
+        if (request.tv_sec == 0 && request.tv_nsec == 0)
+        {
+            fprintf(stderr, "interval cannot be 0\n");
+            return 1;
+        }
+
+        return sleep_every(&request, count, precise) == 0 ? 0 : 1;
+    }
+
+    if (stats)
+    {
+        /* there is nothing to measure without sleeping, so sleeps
+         * are real even in tests, times there are short
+         */
+
+        return sleep_stats(&request, count ? count : 1, precise) == 0 ? 0 : 1;
+    }
+
+    /* number parsed properly, now perform sleep
+     */
+
+#if TEST_RUN
+    /* when we are running tests, we don't want to sleep because
+     * tests would be long and it would be hard to calculate how
+     * long did we really sleep. Instead we just print value that
+     * we would have slept for in normal execution.
+     *
+     * time_t is hard to print, so it's cast to long
+     */
+
+    fprintf(stderr, "sleep for: %ld.%ld%s\n", (long)request.tv_sec,
+        request.tv_nsec, precise ? ", precise" : "");
+    return 0;
+#else
+    if ((precise ? sleep_precise(&request) : sleep_relative(&request)) != 0)
+    {
+        return 1;
+    }
+
+    return 0;
+#endif
+}
@@ -17,6 +17,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,6 +25,185 @@
 #include <u3.h>
 #include <u3defs.h>
 
+#include "utils.h"
+
+
+/* ==========================================================================
+                         __       ____ _
+                    ____/ /___   / __/(_)____   ___   _____
+                   / __  // _ \ / /_ / // __ \ / _ \ / ___/
+                  / /_/ //  __// __// // / / //  __/(__  )
+                  \__,_/ \___//_/  /_//_/ /_/ \___//____/
+
+   ========================================================================== */
+
+
+/* long has at most 19 significant digits, and any 19 digits fit in
+ * uint64_t, so number is accumulated without checking for overflow,
+ * and only more digits than that are out of range for sure
+ */
+
+#define U3U_DIGITS_MAX  19
+
+/* 8 bytes, all of them set to 'b'
+ */
+
+#define U3U_BYTES(b)    ((uint64_t)0x0101010101010101ull * (b))
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ==========================================================================
+                                   _                __
+                     ____   _____ (_)_   __ ____ _ / /_ ___
+                    / __ \ / ___// /| | / // __ `// __// _ \
+                   / /_/ // /   / / | |/ // /_/ // /_ /  __/
+                  / .___//_/   /_/  |___/ \__,_/ \__/ \___/
+                 /_/
+   ========================================================================== */
+
+
+/* ==========================================================================
+    Converts 8 characters at 's' into number, when all of them are
+    digits. Digits are checked and converted all at once, as single 64bit
+    word, first character goes to the least significant byte, no matter
+    the endianness. Converting is done by joining pairs of neighbouring
+    digits into 2 digit numbers, then pairs of these into 4 digit numbers
+    and so on, which takes 3 multiplications instead of 8.
+
+    Returns 0 when all characters are digits, -1 otherwise.
+   ========================================================================== */
+
+
+static int u3u_digits8
+(
+    const char     *s,   /* 8 characters to convert */
+    uint64_t       *v    /* converted number */
+)
+{
+    uint64_t        x;   /* characters as single word */
+    int             i;   /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    x = 0;
+
+    for (i = 7; i >= 0; --i)
+    {
+        x = x << 8 | (unsigned char)s[i];
+    }
+
+    /* every byte must be in 0x30..0x3f, and stay there after adding 6,
+     * that's exactly '0'..'9'. Bytes cannot carry into each other, as
+     * second check is done only when all of them are below 0x40
+     */
+
+    if ((x & U3U_BYTES(0xf0)) != U3U_BYTES(0x30) ||
+        ((x + U3U_BYTES(0x06)) & U3U_BYTES(0xf0)) != U3U_BYTES(0x30))
+    {
+        return -1;
+    }
+
+    x -= U3U_BYTES('0');
+    x = x * 10 + (x >> 8);
+    x = ((x & 0x000000ff000000ffull) * (100 + (1000000ull << 32)) +
+        ((x >> 16) & 0x000000ff000000ffull) * (1 + (10000ull << 32))) >> 32;
+    *v = x;
+    return 0;
+}
+
+
+/* ==========================================================================
+    Returns multiplier for suffix at 's' of 'len' characters, or 0 when
+    it's not a valid suffix. K, M, G and T are powers of 1000, and with
+    'i' after them (Ki, Mi, Gi, Ti) they are powers of 1024.
+   ========================================================================== */
+
+
+static uint64_t u3u_suffix
+(
+    const char         *s,        /* suffix to check */
+    size_t              len       /* length of suffix */
+)
+{
+    static const char   units[4] = { 'K', 'M', 'G', 'T' };
+    const char         *unit;     /* unit of suffix in units */
+    uint64_t            mult;     /* multiplier of suffix */
+    uint64_t            base;     /* 1000 or 1024 */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    if (len == 0 || len > 2 || (len == 2 && s[1] != 'i') ||
+        (unit = memchr(units, s[0], sizeof(units))) == NULL)
+    {
+        return 0;
+    }
+
+    base = len == 2 ? 1024 : 1000;
+
+    for (mult = base; unit != units; --unit)
+    {
+        mult *= base;
+    }
+
+    return mult;
+}
+
+
+/* ==========================================================================
+    Checks if 'c' is whitespace, that separates numbers.
+   ========================================================================== */
+
+
+static int u3u_is_space
+(
+    char  c   /* character to check */
+)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+/* ==========================================================================
+    Parses nul terminated 'num' with 'flags' into 'n', and prints error
+    to stderr when it's not a valid number.
+   ========================================================================== */
+
+
+static int u3u_get
+(
+    const char  *num,    /* string to convert to number */
+    int          flags,  /* U3U_NUM_* flags */
+    long        *n       /* converted num will be placed here */
+)
+{
+    switch (u3u_parse_number(num, strlen(num), flags, n))
+    {
+    case 0:
+        return 0;
+
+    case U3U_NUM_EMPTY:
+        fprintf(stderr, "e/number is an empty string\n");
+        errno = EINVAL;
+        return -1;
+
+    case U3U_NUM_RANGE:
+        fprintf(stderr, "e/number is out of range: '%s'\n", num);
+        errno = ERANGE;
+        return -1;
+
+    default:
+        fprintf(stderr, "e/invalid number passed: '%s'\n", num);
+        errno = EINVAL;
+        return -1;
+    }
+}
+
 
 /* ==========================================================================
                        __     __ _          ____
@@ -36,43 +216,240 @@
 
 
 /* ==========================================================================
-    Converts string number 'num' into number representation. Converted value
-    will be stored in address pointed by 'n'.
+    Parses 'len' characters at 's' as decimal number, and stores it in
+    'n'. Number is optional '-' or '+' sign followed by digits, and
+    with U3U_NUM_SUFFIX in 'flags', by optional multiplier suffix (K, M,
+    G, T, Ki, Mi, Gi or Ti). Whole 's' must be a number, no whitespace
+    is allowed. Any value of long can be parsed, overflow is detected
+    exactly. 's' does not have to be nul terminated. Nothing is printed,
+    errno is left alone, and 'n' is not touched on error.
+
+    Digits are converted 8 at a time, see u3u_digits8().
+
+    Returns 0 on success, or error code:
+
+            U3U_NUM_EMPTY       's' is empty
+            U3U_NUM_INVALID     's' is not a number
+            U3U_NUM_RANGE       number does not fit in long
    ========================================================================== */
 
 
-int u3u_get_number
+int u3u_parse_number
 (
-    const char  *num,  /* string to convert to number */
-    long        *n     /* converted num will be placed here */
+    const char  *s,       /* string to convert to number */
+    size_t       len,     /* length of s */
+    int          flags,   /* U3U_NUM_* flags */
+    long        *n        /* converted s will be placed here */
 )
 {
-    const char  *ep;   /* endptr for strtol function */
+    uint64_t     acc;     /* absolute value of number */
+    uint64_t     v;       /* 8 digits converted at once */
+    uint64_t     limit;   /* biggest absolute value of number */
+    uint64_t     mult;    /* multiplier of suffix */
+    size_t       i;       /* position in s */
+    size_t       start;   /* position of first digit */
+    size_t       nd;      /* number of significant digits */
+    int          neg;     /* number is negative */
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 
-    if (*num == '\0')
+    if (len == 0)
     {
-        fprintf(stderr, "e/number is an empty string\n");
-        errno = EINVAL;
-        return -1;
+        return U3U_NUM_EMPTY;
+    }
+
+    i = 0;
+    neg = s[0] == '-';
+    i += s[0] == '-' || s[0] == '+';
+    start = i;
+
+    /* leading zeros are not significant, and they would take
+     * space of real digits
+     */
+
+    while (i != len && s[i] == '0')
+    {
+        ++i;
     }
 
-    *n = strtol(num, (char **)&ep, 10);
+    acc = 0;
+    nd = 0;
 
-    if (*ep != '\0')
+    while (len - i >= 8 && nd + 8 <= U3U_DIGITS_MAX &&
+        u3u_digits8(s + i, &v) == 0)
     {
-        fprintf(stderr, "e/invalid number passed: '%s'\n", num);
-        errno = EINVAL;
-        return -1;
+        acc = acc * 100000000u + v;
+        nd += 8;
+        i += 8;
     }
 
-    if (*n == LONG_MAX || *n == LONG_MIN)
+    for (; i != len && s[i] >= '0' && s[i] <= '9'; ++i, ++nd)
     {
-        fprintf(stderr, "e/number is out of range: '%s'\n", num);
-        errno = ERANGE;
-        return -1;
+        /* keep going after too many digits, so that garbage after
+         * them is still reported as invalid number
+         */
+
+        if (nd < U3U_DIGITS_MAX)
+        {
+            acc = acc * 10 + (uint64_t)(s[i] - '0');
+        }
     }
 
+    if (i == start)
+    {
+        /* no digits at all, only sign or garbage
+         */
+
+        return U3U_NUM_INVALID;
+    }
+
+    mult = 1;
+
+    if (i != len && (flags & U3U_NUM_SUFFIX))
+    {
+        if ((mult = u3u_suffix(s + i, len - i)) == 0)
+        {
+            return U3U_NUM_INVALID;
+        }
+
+        i = len;
+    }
+
+    if (i != len)
+    {
+        return U3U_NUM_INVALID;
+    }
+
+    /* negative numbers go one further than positive ones
+     */
+
+    limit = (uint64_t)LONG_MAX + neg;
+
+    if (nd > U3U_DIGITS_MAX || acc > limit / mult)
+    {
+        return U3U_NUM_RANGE;
+    }
+
+    acc *= mult;
+    *n = neg && acc ? -(long)(acc - 1) - 1 : (long)acc;
     return 0;
 }
+
+
+/* ==========================================================================
+    Parses numbers from 'buf' of 'size' bytes, separated with any
+    whitespace, and stores up to '*nnums' of them in 'nums'. Numbers are
+    parsed with u3u_parse_number(), with the same 'flags'.
+
+    When U3U_NUM_PARTIAL is in 'flags', number that ends exactly at the
+    end of 'buf' is not parsed, as it may continue in the next chunk of
+    stream. Caller should move it to the beginning of the next buffer.
+
+    On return, '*nnums' is number of parsed numbers, and '*end' is the
+    offset in 'buf' where parsing stopped, and can continue from. On
+    error it's the offset of invalid number.
+
+    Returns 0 on success, or error code of u3u_parse_number() for
+    invalid number.
+   ========================================================================== */
+
+
+int u3u_parse_numbers
+(
+    const char  *buf,     /* numbers to parse */
+    size_t       size,    /* size of buf */
+    int          flags,   /* U3U_NUM_* flags */
+    long        *nums,    /* parsed numbers will be placed here */
+    size_t      *nnums,   /* in: size of nums, out: parsed numbers */
+    size_t      *end      /* position in buf where parsing stopped */
+)
+{
+    size_t       max;     /* size of nums */
+    size_t       n;       /* parsed numbers */
+    size_t       i;       /* position in buf */
+    size_t       start;   /* start of current number */
+    int          ret;     /* return code */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    max = *nnums;
+    ret = 0;
+    *end = 0;
+
+    for (i = 0, n = 0; n != max; ++n)
+    {
+        while (i != size && u3u_is_space(buf[i]))
+        {
+            ++i;
+        }
+
+        /* whitespace is consumed, even if there is no number after
+         * it, so stream does not pile it up
+         */
+
+        *end = i;
+
+        if (i == size)
+        {
+            break;
+        }
+
+        for (start = i; i != size && !u3u_is_space(buf[i]); ++i)
+        {
+            continue;
+        }
+
+        if (i == size && (flags & U3U_NUM_PARTIAL))
+        {
+            break;
+        }
+
+        if ((ret = u3u_parse_number(buf + start, i - start, flags,
+            nums + n)) != 0)
+        {
+            *end = start;
+            break;
+        }
+
+        *end = i;
+    }
+
+    *nnums = n;
+    return ret;
+}
+
+
+/* ==========================================================================
+    Converts string number 'num' into number representation. Converted value
+    will be stored in address pointed by 'n'. Errors are printed to stderr.
+
+    errno:
+            EINVAL      num is empty or is not a number
+            ERANGE      num does not fit in long
+   ========================================================================== */
+
+
+int u3u_get_number
+(
+    const char  *num,  /* string to convert to number */
+    long        *n     /* converted num will be placed here */
+)
+{
+    return u3u_get(num, 0, n);
+}
+
+
+/* ==========================================================================
+    Same as u3u_get_number(), but 'num' can have multiplier suffix, like
+    "10K" or "4Mi", for things that are counted.
+   ========================================================================== */
+
+
+int u3u_get_count
+(
+    const char  *num,  /* string to convert to number */
+    long        *n     /* converted num will be placed here */
+)
+{
+    return u3u_get(num, U3U_NUM_SUFFIX, n);
+}
@@ -6,6 +6,19 @@
 #ifndef U3_UTILS_H
 #define U3_UTILS_H 1
 
+#include <stddef.h>
+
+#define U3U_NUM_SUFFIX   0x01  /* accept K, M, G, T, Ki, Mi, Gi, Ti */
+#define U3U_NUM_PARTIAL  0x02  /* number at the end of buffer is cut */
+
+#define U3U_NUM_EMPTY    -1
+#define U3U_NUM_INVALID  -2
+#define U3U_NUM_RANGE    -3
+
+int u3u_parse_number(const char *s, size_t len, int flags, long *n);
+int u3u_parse_numbers(const char *buf, size_t size, int flags, long *nums,
+    size_t *nnums, size_t *end);
 int u3u_get_number(const char *num, long *n);
+int u3u_get_count(const char *num, long *n);
 
 #endif
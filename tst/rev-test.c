@@ -18,11 +18,13 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "memrev.h"
 #include "mtest.h"
 #include "std-redirects.h"
 #include "u3.h"
@@ -42,6 +44,9 @@
 mt_defs();
 
 #define REV_TEST_FILE "./rev-test-file"
+#define REV_TEST_FILE2 "./rev-test-file2"
+#define REV_TEST_INPLACE_FILE "./rev-test-inplace-file"
+#define REV_TEST_JOURNAL REV_TEST_INPLACE_FILE ".rev-journal"
 #define REV_TEST_STDOUT "./rev-test-stdout"
 #define REV_TEST_STDERR "./rev-test-stderr"
 #define REV_TEST_STDIN "./rev-test-stdin"
@@ -75,6 +80,9 @@ static void cleanup_test(void)
 {
     restore_stdout();
     unlink(REV_TEST_FILE);
+    unlink(REV_TEST_FILE2);
+    unlink(REV_TEST_INPLACE_FILE);
+    unlink(REV_TEST_JOURNAL);
     unlink(REV_TEST_STDOUT);
     unlink(REV_TEST_STDERR);
     unlink(REV_TEST_STDIN);
@@ -191,6 +199,56 @@ static int rev_gen_data
 }
 
 
+/* ==========================================================================
+    Generates 'size' bytes of lines of different lengths (up to 'maxlen')
+    into 'data' and their reversed version into 'expected', which must be
+    one byte bigger, for '\0' terminator. Last line is without new line
+    character.
+   ========================================================================== */
+
+
+static void rev_gen_lines
+(
+    char    *data,      /* generated lines */
+    char    *expected,  /* reversed lines */
+    size_t   size,      /* number of bytes to generate */
+    size_t   maxlen     /* max length of a single line */
+)
+{
+    size_t   pos;       /* current position in data */
+    size_t   len;       /* length of current line */
+    size_t   i;         /* iterator */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (pos = 0, len = 0; pos != size; len = (len * 7 + 3) % maxlen)
+    {
+        for (i = 0; i != len && pos + i != size; ++i)
+        {
+            data[pos + i] = 'a' + (pos + i) % 26;
+        }
+
+        len = i;
+
+        for (i = 0; i != len; ++i)
+        {
+            expected[pos + i] = data[pos + len - 1 - i];
+        }
+
+        pos += len;
+
+        if (pos != size)
+        {
+            data[pos] = '\n';
+            expected[pos] = '\n';
+            ++pos;
+        }
+    }
+
+    expected[size] = '\0';
+}
+
+
 /* ==========================================================================
                            __               __
                           / /_ ___   _____ / /_ _____
@@ -335,28 +393,11 @@ static void rev_lib_single_overflow_line(void)
 
     rev_gen_data(n, 1, REV_TEST_FILE, expected);
 
-#if ENABLE_MALLOC
-
     mt_fok(u3_rev_main(argc, argv));
     rewind_stdout_file();
     read_stdout_file(buf, sizeof(buf));
     mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
     mt_fail(buf[strlen(buf) - 1] == '\n');
-
-#else /* ENABLE_MALLOC */
-
-    stderr_to_file(REV_TEST_STDERR);
-    mt_ferr(u3_rev_main(argc, argv), ENOBUFS);
-    mt_fail(read_stdout_file(buf, sizeof(buf)) == 0);
-    mt_fail(buf[0] == '\0');
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    sprintf(expected, "e/line is longer than %d, aborting\n",
-        U3_REV_LINE_MAX);
-    mt_fail(strcmp(buf, expected) == 0);
-    restore_stderr();
-
-#endif /* ENABLE_MALLOC */
 }
 
 
@@ -445,28 +486,11 @@ static void rev_lib_single_overflow_line_no_nl(void)
 
     rev_gen_data(n, 0, REV_TEST_FILE, expected);
 
-#if ENABLE_MALLOC
-
     mt_fok(u3_rev_main(argc, argv));
     rewind_stdout_file();
     read_stdout_file(buf, sizeof(buf));
     mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
     mt_fail(buf[strlen(buf) - 1] != '\n');
-
-#else /* ENABLE_MALLOC */
-
-    stderr_to_file(REV_TEST_STDERR);
-    mt_ferr(u3_rev_main(argc, argv), ENOBUFS);
-    mt_fail(read_stdout_file(buf, sizeof(buf)) == 0);
-    mt_fail(buf[0] == '\0');
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    sprintf(expected, "e/line is longer than %d, aborting\n",
-        U3_REV_LINE_MAX);
-    mt_fail(strcmp(buf, expected) == 0);
-    restore_stderr();
-
-#endif /* ENABLE_MALLOC */
 }
 
 
@@ -557,28 +581,11 @@ static void rev_lib_multi_overflow_line(void)
 
     rev_gen_data(n, 1, REV_TEST_FILE, expected);
 
-#if ENABLE_MALLOC
-
     mt_fok(u3_rev_main(argc, argv));
     rewind_stdout_file();
     read_stdout_file(buf, sizeof(buf));
     mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
     mt_fail(buf[strlen(buf) - 1] == '\n');
-
-#else /* ENABLE_MALLOC */
-
-    stderr_to_file(REV_TEST_STDERR);
-    mt_ferr(u3_rev_main(argc, argv), ENOBUFS);
-    mt_fail(read_stdout_file(buf, sizeof(buf)) == 0);
-    mt_fail(buf[0] == '\0');
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    sprintf(expected, "e/line is longer than %d, aborting\n",
-        U3_REV_LINE_MAX);
-    mt_fail(strcmp(buf, expected) == 0);
-    restore_stderr();
-
-#endif /* ENABLE_MALLOC */
 }
 
 
@@ -668,28 +675,734 @@ static void rev_lib_multi_overflow_line_no_nl(void)
 
     rev_gen_data(n, 0, REV_TEST_FILE, expected);
 
-#if ENABLE_MALLOC
-
     mt_fok(u3_rev_main(argc, argv));
     rewind_stdout_file();
     read_stdout_file(buf, sizeof(buf));
     mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
     mt_fail(buf[strlen(buf) - 1] != '\n');
+}
+
+
+/* ==========================================================================
+    Line that is longer than output buffer, has to be reversed in pieces
+   ========================================================================== */
+
+
+static void rev_lib_huge_line(void)
+{
+    int    argc = 2;
+    char  *argv[] = { "rev", REV_TEST_FILE, NULL };
+    char  *buf;
+    char  *expected;
+    size_t size;
+    int    n[] = { 3, 3 * U3_REV_BUF_SIZE + 7, 5, INT_MAX };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 3 * U3_REV_BUF_SIZE + 7 + 3 + 5 + 3 + 1;
+    buf = calloc(1, size);
+    expected = calloc(1, size);
+
+    rev_gen_data(n, 1, REV_TEST_FILE, expected);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size) == (ssize_t)strlen(expected));
+    mt_fail(strcmp(buf, expected) == 0);
+
+    free(buf);
+    free(expected);
+}
+
+
+/* ==========================================================================
+    Lots of short lines on stdin, so they cross boundaries of blocks read
+    from input
+   ========================================================================== */
+
+
+static void rev_lib_stdin_multi_block(void)
+{
+    int     argc = 1;
+    char   *argv[] = { "rev", NULL };
+    char   *data;
+    char   *buf;
+    char   *expected;
+    size_t  size;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 3 * U3_REV_BUF_SIZE + 13;
+    data = malloc(size);
+    buf = calloc(1, size + 1);
+    expected = malloc(size + 1);
+
+    rev_gen_lines(data, expected, size, 97);
+
+    stdin_from_file(REV_TEST_STDIN);
+    write_stdin_file(data, size);
+    rewind_stdin_file();
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size + 1) == (ssize_t)size);
+    mt_fail(strcmp(buf, expected) == 0);
+    restore_stdin();
+
+    free(data);
+    free(buf);
+    free(expected);
+}
+
+
+/* ==========================================================================
+    File big enough to be split between threads, with lines longer than
+    single chunk
+   ========================================================================== */
+
+
+static void rev_lib_jobs(void)
+{
+    int     argc = 4;
+    char   *argv[] = { "rev", "-j", "3", REV_TEST_FILE, NULL };
+    char   *data;
+    char   *buf;
+    char   *expected;
+    size_t  size;
+    FILE   *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 3 * U3_REV_CHUNK_SIZE + 13;
+    data = malloc(size);
+    buf = calloc(1, size + 1);
+    expected = malloc(size + 1);
+
+    rev_gen_lines(data, expected, size, U3_REV_CHUNK_SIZE * 3 / 2);
+    f = fopen(REV_TEST_FILE, "w");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size + 1) == (ssize_t)size);
+    mt_fail(strcmp(buf, expected) == 0);
+
+    /* absurd number of jobs is clamped to number of chunks
+     */
+
+    restore_stdout();
+    stdout_to_file(REV_TEST_STDOUT);
+    memset(buf, 0, size + 1);
+    argv[2] = "9223372036854775807";
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size + 1) == (ssize_t)size);
+    mt_fail(strcmp(buf, expected) == 0);
+
+    free(data);
+    free(buf);
+    free(expected);
+}
+
+
+/* ==========================================================================
+    File split between threads, with line longer than U3_REV_BUF_MAX in
+    the middle, which is not buffered, but reversed straight to output
+   ========================================================================== */
+
+
+static void rev_lib_jobs_giant_line(void)
+{
+    int     argc = 4;
+    char   *argv[] = { "rev", "-j", "3", REV_TEST_FILE, NULL };
+    char   *data;
+    char   *buf;
+    char   *expected;
+    size_t  size;
+    size_t  head;
+    size_t  giant;
+    size_t  i;
+    FILE   *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    head = U3_REV_CHUNK_SIZE / 2;
+    giant = U3_REV_BUF_MAX + U3_REV_CHUNK_SIZE;
+    size = head + 1 + giant + 1 + 2 * U3_REV_CHUNK_SIZE;
+    data = malloc(size);
+    buf = calloc(1, size + 1);
+    expected = malloc(size + 1);
+
+    /* short lines, giant line, and short lines again
+     */
+
+    rev_gen_lines(data, expected, head, 1000);
+    data[head] = expected[head] = '\n';
+
+    for (i = 0; i != giant; ++i)
+    {
+        data[head + 1 + i] = 'a' + i % 26;
+        expected[head + giant - i] = 'a' + i % 26;
+    }
+
+    data[head + 1 + giant] = expected[head + 1 + giant] = '\n';
+    rev_gen_lines(data + head + giant + 2, expected + head + giant + 2,
+        2 * U3_REV_CHUNK_SIZE, 1000);
+
+    f = fopen(REV_TEST_FILE, "w");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size + 1) == (ssize_t)size);
+    mt_fail(strcmp(buf, expected) == 0);
+
+    free(data);
+    free(buf);
+    free(expected);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_jobs_invalid(void)
+{
+    int   argc = 3;
+    char *argv[] = { "rev", "-j0", REV_TEST_FILE, NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-#else /* ENABLE_MALLOC */
 
     stderr_to_file(REV_TEST_STDERR);
-    mt_ferr(u3_rev_main(argc, argv), ENOBUFS);
-    mt_fail(read_stdout_file(buf, sizeof(buf)) == 0);
-    mt_fail(buf[0] == '\0');
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    sprintf(expected, "e/line is longer than %d, aborting\n",
-        U3_REV_LINE_MAX);
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    argc = 2;
+    argv[1] = "-j";
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    restore_stderr();
+}
+
+
+static void rev_lib_zero_copy_check
+(
+    char   *opt,
+    size_t  size,
+    size_t  maxlen
+)
+{
+    int     argc = 4;
+    char   *argv[] = { "rev", "-z", opt, REV_TEST_FILE, NULL };
+    char   *data;
+    char   *buf;
+    char   *expected;
+    FILE   *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    data = malloc(size);
+    buf = calloc(1, size + 1);
+    expected = malloc(size + 1);
+
+    rev_gen_lines(data, expected, size, maxlen);
+    f = fopen(REV_TEST_FILE, "w");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size + 1) == (ssize_t)size);
+    mt_fail(strcmp(buf, expected) == 0);
+
+    free(data);
+    free(buf);
+    free(expected);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_zero_copy(void)
+{
+    /* more data than there is in gather ring, so blocks get reused
+     */
+
+    rev_lib_zero_copy_check("-u", 40 * U3_REV_BUF_SIZE + 7,
+        U3_REV_BUF_SIZE * 3);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_zero_copy_jobs(void)
+{
+    rev_lib_zero_copy_check("-j2", 3 * U3_REV_CHUNK_SIZE + 13,
+        U3_REV_CHUNK_SIZE / 2);
+}
+
+
+/* ==========================================================================
+    Reverses REV_TEST_INPLACE_FILE with data 'data' in place, with 'opt'
+    option if it's not NULL, and checks if file contains 'expected'
+    afterwards, and that journal is gone. If 'jlen' is not -1, journal is
+    created before that, saying rev crashed while it was reversing window
+    at 'joff' of 'jlen' bytes, with original window 'jdata'. When 'jsum'
+    is 0 proper checksum of 'jdata' is stored in journal.
+   ========================================================================== */
+
+
+static void rev_lib_inplace_check
+(
+    const char  *opt,
+    const char  *data,
+    const char  *expected,
+    uint64_t     joff,
+    uint64_t     jlen,
+    uint64_t     jsum,
+    const char  *jdata
+)
+{
+    int          argc = 4;
+    char        *argv[] = { "rev", "-i", NULL, REV_TEST_INPLACE_FILE, NULL };
+    char         buf[256] = {0};
+    uint64_t     j[5] = {0};
+    size_t       i;
+    FILE        *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    argv[2] = (char *)opt;
+
+    if (opt == NULL)
+    {
+        argv[2] = REV_TEST_INPLACE_FILE;
+        argc = 3;
+    }
+
+    f = fopen(REV_TEST_INPLACE_FILE, "w");
+    fputs(data, f);
+    fclose(f);
+
+    if (jlen != (uint64_t)-1)
+    {
+        /* journal header is: magic, off, len, sum, mode
+         */
+
+        memcpy(j, "u3revj1", 8);
+        j[1] = joff;
+        j[2] = jlen;
+        j[3] = 14695981039346656037ULL;
+
+        for (i = 0; i != jlen; ++i)
+        {
+            j[3] = (j[3] ^ (unsigned char)jdata[i]) * 1099511628211ULL;
+        }
+
+        j[3] = jsum ? jsum : j[3];
+        f = fopen(REV_TEST_JOURNAL, "w");
+        fwrite(j, sizeof(j), 1, f);
+        fwrite(jdata, 1, jlen, f);
+        fclose(f);
+    }
+
+    mt_fok(u3_rev_main(argc, argv));
+    f = fopen(REV_TEST_INPLACE_FILE, "r");
+    fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
     mt_fail(strcmp(buf, expected) == 0);
+    mt_fail(access(REV_TEST_JOURNAL, F_OK) != 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_inplace(void)
+{
+    int     argc = 3;
+    char   *argv[] = { "rev", "-i", REV_TEST_INPLACE_FILE, NULL };
+    char   *data;
+    char   *expected;
+    size_t  size;
+    FILE   *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 2 * U3_REV_CHUNK_SIZE + 13;
+    data = malloc(size + 1);
+    expected = malloc(size + 1);
+
+    rev_gen_lines(data, expected, size, U3_REV_CHUNK_SIZE / 3);
+    f = fopen(REV_TEST_INPLACE_FILE, "w");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    f = fopen(REV_TEST_INPLACE_FILE, "r");
+    mt_fail(fread(data, 1, size + 1, f) == size);
+    fclose(f);
+    mt_fail(memcmp(data, expected, size) == 0);
+    mt_fail(access(REV_TEST_JOURNAL, F_OK) != 0);
+
+    free(data);
+    free(expected);
+}
+
+
+/* ==========================================================================
+    Line longer than U3_REV_BUF_MAX is not reversed in the mapping, but
+    swapped on disk, block by block
+   ========================================================================== */
+
+
+static void rev_lib_inplace_giant_line(void)
+{
+    int     argc = 3;
+    char   *argv[] = { "rev", "-i", REV_TEST_INPLACE_FILE, NULL };
+    char   *data;
+    char   *expected;
+    size_t  size;
+    size_t  head;
+    size_t  giant;
+    size_t  i;
+    FILE   *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    head = U3_REV_CHUNK_SIZE / 2;
+    giant = U3_REV_BUF_MAX + U3_REV_CHUNK_SIZE;
+    size = head + 1 + giant + 1 + U3_REV_CHUNK_SIZE;
+    data = malloc(size + 1);
+    expected = malloc(size + 1);
+
+    /* short lines, giant line, and short lines again
+     */
+
+    rev_gen_lines(data, expected, head, 1000);
+    data[head] = expected[head] = '\n';
+
+    for (i = 0; i != giant; ++i)
+    {
+        data[head + 1 + i] = 'a' + i % 26;
+        expected[head + giant - i] = 'a' + i % 26;
+    }
+
+    data[head + 1 + giant] = expected[head + 1 + giant] = '\n';
+    rev_gen_lines(data + head + giant + 2, expected + head + giant + 2,
+        U3_REV_CHUNK_SIZE, 1000);
+
+    f = fopen(REV_TEST_INPLACE_FILE, "w");
+    fwrite(data, 1, size, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    f = fopen(REV_TEST_INPLACE_FILE, "r");
+    mt_fail(fread(data, 1, size + 1, f) == size);
+    fclose(f);
+    mt_fail(memcmp(data, expected, size) == 0);
+    mt_fail(access(REV_TEST_JOURNAL, F_OK) != 0);
+
+    free(data);
+    free(expected);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_inplace_utf8(void)
+{
+    rev_lib_inplace_check(NULL, "abc\n\xc5\xbc\xc3\xb3\xc5\x82w",
+        "cba\nw\x82\xc5\xb3\xc3\xbc\xc5", 0, -1, 0, NULL);
+    rev_lib_inplace_check("-u", "abc\n\xc5\xbc\xc3\xb3\xc5\x82w\n",
+        "cba\nw\xc5\x82\xc3\xb3\xc5\xbc\n", 0, -1, 0, NULL);
+    rev_lib_inplace_check("-g", "e\xcc\x81" "a\n\xc5\xbc\xc3\xb3\n",
+        "ae\xcc\x81\n\xc3\xb3\xc5\xbc\n", 0, -1, 0, NULL);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_inplace_resume(void)
+{
+    /* crashed after first line was done, and second was being
+     * worked on, it's restored from journal and reversed again
+     */
+
+    rev_lib_inplace_check(NULL, "cba\nfXd\nghi\n", "cba\nfed\nihg\n",
+        4, 4, 0, "def\n");
+
+    /* crashed right after second line was done
+     */
+
+    rev_lib_inplace_check(NULL, "cba\nfed\nghi\n", "cba\nfed\nihg\n",
+        8, 0, 0, "");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_inplace_resume_torn(void)
+{
+    /* crashed before window was fully saved, checksum does not
+     * match, so file could not have been touched yet
+     */
+
+    rev_lib_inplace_check(NULL, "cba\ndef\nghi\n", "cba\nfed\nihg\n",
+        4, 4, 1, "dXf\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_inplace_no_file(void)
+{
+    int   argc = 2;
+    char *argv[] = { "rev", "-i", NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(REV_TEST_STDERR);
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
     restore_stderr();
+}
+
+
+/* ==========================================================================
+    Checks memrev kernel 'k' against plain byte-by-byte reverse, for
+    different lengths and alignments, both copy and in place reverse
+   ========================================================================== */
+
+
+static void rev_memrev_kernel
+(
+    const struct u3u_memrev_kernel  *k
+)
+{
+    unsigned char   src[512 + 8];
+    unsigned char   dst[512 + 8];
+    unsigned char   expected[512];
+    size_t          n;
+    size_t          off;
+    size_t          i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(src); ++i)
+    {
+        src[i] = (unsigned char)(i * 7 + 3);
+    }
+
+    for (off = 0; off != 8; ++off)
+    {
+        for (n = 0; n != 512; ++n)
+        {
+            for (i = 0; i != n; ++i)
+            {
+                expected[i] = src[off + n - 1 - i];
+            }
+
+            memset(dst, 0xa5, sizeof(dst));
+            k->fn(dst + (7 - off), src + off, n);
+            mt_fail(memcmp(dst + (7 - off), expected, n) == 0);
+
+            /* check if nothing was written past the buffer
+             */
+
+            mt_fail(dst[7 - off + n] == 0xa5);
+            mt_fail(off == 7 || dst[6 - off] == 0xa5);
 
-#endif /* ENABLE_MALLOC */
+            /* and now in place reverse
+             */
+
+            memcpy(dst + off, src + off, n);
+            k->fn(dst + off, dst + off, n);
+            mt_fail(memcmp(dst + off, expected, n) == 0);
+        }
+    }
+}
+
+
+/* ==========================================================================
+    Reverses 'data' with 'opt' option and checks if output is 'expected'
+   ========================================================================== */
+
+
+static void rev_lib_utf8_check
+(
+    const char  *opt,
+    const char  *data,
+    const char  *expected
+)
+{
+    int          argc = 3;
+    char        *argv[] = { "rev", NULL, REV_TEST_FILE, NULL };
+    char         buf[256] = {0};
+    FILE        *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    argv[1] = (char *)opt;
+    f = fopen(REV_TEST_FILE, "w");
+    fputs(data, f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    read_stdout_file(buf, sizeof(buf));
+    mt_fail(strcmp(buf, expected) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_utf8_codepoint(void)
+{
+    /* multibyte characters, ascii blocks longer than 16 bytes, and
+     * invalid sequence (lone 0xff and truncated 3 byte sequence)
+     */
+
+    rev_lib_utf8_check("-u",
+        "h\xc3\xa9llo w\xc3\xb6rld\n"
+        "\xe6\x97\xa5\xe6\x9c\xac abcdefghijklmnopqrstuvwxyz\n"
+        "ab\xff" "cd\xe6\x97\n"
+        "plain ascii line\n"
+        "\xf0\x9f\x98\x80x",
+
+        "dlr\xc3\xb6w oll\xc3\xa9h\n"
+        "zyxwvutsrqponmlkjihgfedcba \xe6\x9c\xac\xe6\x97\xa5\n"
+        "\x97\xe6" "dc\xff" "ba\n"
+        "enil iicsa nialp\n"
+        "x\xf0\x9f\x98\x80");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_utf8_grapheme(void)
+{
+    /* combining acute accent stays with 'e', two flags made of
+     * regional indicators, and two emojis joined with zwj
+     */
+
+    rev_lib_utf8_check("-g",
+        "e\xcc\x81" "a\n"
+        "\xf0\x9f\x87\xb5\xf0\x9f\x87\xb1\xf0\x9f\x87\xa9\xf0\x9f\x87\xaa x\n"
+        "\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9 abc\n",
+
+        "ae\xcc\x81\n"
+        "x \xf0\x9f\x87\xa9\xf0\x9f\x87\xaa\xf0\x9f\x87\xb5\xf0\x9f\x87\xb1\n"
+        "cba \xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_utf8_codepoint_combining(void)
+{
+    /* without -g, combining accent is separated from its base
+     */
+
+    rev_lib_utf8_check("-u",
+        "e\xcc\x81" "a\n",
+        "a\xcc\x81" "e\n");
+}
+
+
+/* ==========================================================================
+    Reverses 'in' with u3_rev() into separate buffer and in place, and
+    checks if both results are equal to 'expected'.
+   ========================================================================== */
+
+
+static void rev_lib_buf_check
+(
+    const char  *in,        /* data to reverse */
+    int          flags,     /* flags to pass to u3_rev() */
+    const char  *expected   /* expected result */
+)
+{
+    char         buf[128];  /* reversed data */
+    size_t       len;       /* length of in */
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    len = strlen(in);
+    memset(buf, 'X', sizeof(buf));
+    mt_fok(u3_rev(in, len, buf, flags));
+    mt_fail(memcmp(buf, expected, len) == 0);
+    mt_fail(buf[len] == 'X');
+
+    memcpy(buf, in, len);
+    mt_fok(u3_rev(buf, len, buf, flags));
+    mt_fail(memcmp(buf, expected, len) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_buf(void)
+{
+    rev_lib_buf_check("", 0, "");
+    rev_lib_buf_check("\n\n", 0, "\n\n");
+    rev_lib_buf_check("abc\n12345\nxyz", 0, "cba\n54321\nzyx");
+    rev_lib_buf_check("abc\n12345\n", 0, "cba\n54321\n");
+    rev_lib_buf_check("0123456789abcdefghijklmnopqrstuvwxyz\n", 0,
+        "zyxwvutsrqponmlkjihgfedcba9876543210\n");
+    rev_lib_buf_check("\xc5\xbc\xc3\xb3\n", 0, "\xb3\xc3\xbc\xc5\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_buf_utf8(void)
+{
+    rev_lib_buf_check("abc\n\xc5\xbc\xc3\xb3\xc5\x82w\n", U3_REV_UTF8,
+        "cba\nw\xc5\x82\xc3\xb3\xc5\xbc\n");
+    rev_lib_buf_check("a\xcc\x81" "e", U3_REV_UTF8, "e\xcc\x81" "a");
+    rev_lib_buf_check("a\xcc\x81" "e", U3_REV_GRAPHEME, "ea\xcc\x81");
+    rev_lib_buf_check("e\xcc\x81" "a\n\xc5\xbc\xc3\xb3", U3_REV_GRAPHEME,
+        "ae\xcc\x81\n\xc3\xb3\xc5\xbc");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_buf_invalid(void)
+{
+    char  buf[4];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mt_ferr(u3_rev(NULL, 3, buf, 0), EINVAL);
+    mt_ferr(u3_rev("abc", 3, NULL, 0), EINVAL);
+    mt_ferr(u3_rev("abc", 3, buf, 0x04), EINVAL);
+    mt_ferr(u3_rev("abc", 3, buf, U3_REV_UTF8 | U3_REV_GRAPHEME), EINVAL);
+    mt_fok(u3_rev(NULL, 0, NULL, 0));
 }
 
 
@@ -749,20 +1462,61 @@ static void rev_lib_one_arg(void)
    ========================================================================== */
 
 
-static void rev_lib_three_args(void)
+static void rev_lib_multi_file(void)
 {
-    int   argc = 3;
-    char *argv[] = { "", "", "", NULL };
+    int   argc = 4;
+    char *argv[] = { "rev", REV_TEST_FILE, REV_TEST_FILE2, REV_TEST_FILE,
+        NULL };
     char  buf[128] = {0};
-    char  *expected = "usage: rev [ -v | -h | <file> ]\n";
+    char  *expected = "cba\nfed\n321\n54cba\nfed\n";
+    FILE  *f;
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
+    f = fopen(REV_TEST_FILE, "w");
+    fputs("abc\ndef\n", f);
+    fclose(f);
+    f = fopen(REV_TEST_FILE2, "w");
+    fputs("123\n45", f);
+    fclose(f);
+
+    mt_fok(u3_rev_main(argc, argv));
+    rewind_stdout_file();
+    read_stdout_file(buf, sizeof(buf));
+    mt_fail(strcmp(buf, expected) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_multi_file_missing(void)
+{
+    int   argc = 4;
+    char *argv[] = { "rev", REV_TEST_FILE, "/i/dont/exist", REV_TEST_FILE2,
+        NULL };
+    char  buf[128] = {0};
+    char  *expected = "cba\n321\n";
+    char  *expected_err = "e/fopen(): ";
+    FILE  *f;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+    f = fopen(REV_TEST_FILE, "w");
+    fputs("abc\n", f);
+    fclose(f);
+    f = fopen(REV_TEST_FILE2, "w");
+    fputs("123\n", f);
+    fclose(f);
+
     stderr_to_file(REV_TEST_STDERR);
-    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    mt_ferr(u3_rev_main(argc, argv), ENOENT);
+    rewind_stdout_file();
+    read_stdout_file(buf, sizeof(buf));
+    mt_fail(strcmp(buf, expected) == 0);
     rewind_stderr_file();
-    mt_fail(read_stdout_file(buf, sizeof(buf)) == 0);
+    memset(buf, 0, sizeof(buf));
     read_stderr_file(buf, sizeof(buf));
-    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    mt_fail(strncmp(buf, expected_err, strlen(expected_err)) == 0);
     restore_stderr();
 }
 
@@ -839,6 +1593,32 @@ static void rev_lib_invalid_arg(void)
 }
 
 
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void rev_lib_grouped_arg(void)
+{
+    int   argc = 3;
+    char *argv[] = { "rev", "-iu", REV_TEST_FILE, NULL };
+    char  buf[128] = {0};
+    char  *expected = "e/invalid option -iu\n";
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+    stderr_to_file(REV_TEST_STDERR);
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    argc = 2;
+    argv[1] = "-zzq";
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    argv[1] = "-vx";
+    mt_ferr(u3_rev_main(argc, argv), EINVAL);
+    rewind_stderr_file();
+    read_stderr_file(buf, sizeof(buf));
+    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    restore_stderr();
+}
+
+
 /* ==========================================================================
    ========================================================================== */
 
@@ -865,7 +1645,7 @@ static void rev_lib_stdout_error(void)
     read_stderr_file(buf, sizeof(buf));
     restore_stderr();
     unlink(REV_TEST_STDOUT);
-    mt_fail(strncmp(buf, "e/fputs()", 9) == 0);
+    mt_fail(strncmp(buf, "e/fwrite()", 10) == 0);
 }
 
 #endif /* HAVE_MUTABLE_STDOUT */
@@ -914,6 +1694,22 @@ static void rev_lib_stdout_error_no_nl(void)
 
 int main(void)
 {
+    const struct u3u_memrev_kernel  *k;
+    char                             tname[64];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (k = u3u_memrev_kernels; k->name != NULL; ++k)
+    {
+        if (k->supported() == 0)
+        {
+            continue;
+        }
+
+        sprintf(tname, "rev_memrev_kernel %s", k->name);
+        mt_run_param_named(rev_memrev_kernel, k, tname);
+    }
+
 #if HAVE_MUTABLE_STDOUT
 
     mt_run(rev_lib_stdout_error);
@@ -942,10 +1738,31 @@ int main(void)
     mt_run(rev_lib_multi_line_no_nl);
     mt_run(rev_lib_multi_full_line_no_nl);
     mt_run(rev_lib_multi_overflow_line_no_nl);
+    mt_run(rev_lib_huge_line);
+    mt_run(rev_lib_stdin_multi_block);
+    mt_run(rev_lib_jobs);
+    mt_run(rev_lib_jobs_giant_line);
+    mt_run(rev_lib_jobs_invalid);
+    mt_run(rev_lib_zero_copy);
+    mt_run(rev_lib_zero_copy_jobs);
+    mt_run(rev_lib_inplace);
+    mt_run(rev_lib_inplace_giant_line);
+    mt_run(rev_lib_inplace_utf8);
+    mt_run(rev_lib_inplace_resume);
+    mt_run(rev_lib_inplace_resume_torn);
+    mt_run(rev_lib_inplace_no_file);
+    mt_run(rev_lib_utf8_codepoint);
+    mt_run(rev_lib_utf8_grapheme);
+    mt_run(rev_lib_utf8_codepoint_combining);
+    mt_run(rev_lib_buf);
+    mt_run(rev_lib_buf_utf8);
+    mt_run(rev_lib_buf_invalid);
     mt_run(rev_lib_zero_arg);
     mt_run(rev_lib_one_arg);
-    mt_run(rev_lib_three_args);
+    mt_run(rev_lib_multi_file);
+    mt_run(rev_lib_multi_file_missing);
     mt_run(rev_lib_invalid_arg);
+    mt_run(rev_lib_grouped_arg);
     mt_run(rev_lib_file_not_found);
     mt_run(rev_lib_permision_denied);
 
@@ -7,14 +7,14 @@
 . ./mtest.sh
 
 rev="../src/rev"
-rev_test_file="rev-test-file"
-rev_test_data="rev-test-data"
-rev_expected_data="rev-expected-data"
+rev_test_file="rev-test-sh-file"
+rev_test_data="rev-test-sh-data"
+rev_expected_data="rev-test-sh-expected"
 
 rev_line_max=$(cat ../config.h | grep U3_REV_LINE_MAX | cut -f3 -d' ')
-enable_malloc=$(cat ../config.h | grep ENABLE_MALLOC | cut -f3 -d' ')
+rev_buf_max=$(cat ../config.h | grep U3_REV_BUF_MAX | cut -f3 -d' ')
 
-stderr=rev-test-stderr
+stderr=rev-test-sh-stderr
 
 ## ==========================================================================
 #              ____                     __   _
@@ -114,6 +114,38 @@ gen_data()
 }
 
 
+## ==========================================================================
+#   generates line longer than rev can keep in memory, $1 is opts to
+#   pass to rev. Result of reversing it from pipe, from seekable stdin
+#   and in place is compared against reversing of mapped file.
+## ==========================================================================
+
+
+giant_line()
+{
+    {
+        echo "first line"
+        yes "abcdefghijżółć" | head -n $(( ${rev_buf_max} / 18 + 300 )) | \
+            tr -d '\n'
+        echo
+        echo "last line"
+    } > "${rev_test_data}"
+
+    ${rev} ${1} "${rev_test_data}" > "${rev_expected_data}"
+    mt_fail "[ ${?} -eq 0 ]"
+
+    cat "${rev_test_data}" | ${rev} ${1} > "${rev_test_file}"
+    mt_fail "cmp -s \"${rev_test_file}\" \"${rev_expected_data}\""
+
+    ${rev} ${1} < "${rev_test_data}" > "${rev_test_file}"
+    mt_fail "cmp -s \"${rev_test_file}\" \"${rev_expected_data}\""
+
+    cp "${rev_test_data}" "${rev_test_file}"
+    ${rev} -i ${1} "${rev_test_file}"
+    mt_fail "cmp -s \"${rev_test_file}\" \"${rev_expected_data}\""
+}
+
+
 ## ==========================================================================
 #                          __               __
 #                         / /_ ___   _____ / /_ _____
@@ -181,14 +213,8 @@ rev_sh_pipe_single_overflow_line()
     out="$(cat "${rev_test_data}" | ${rev} 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -238,14 +264,8 @@ rev_sh_pipe_single_overflow_line_no_nl()
     out="$(cat "${rev_test_data}" | ${rev} 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -295,14 +315,8 @@ rev_sh_pipe_multi_overflow_line()
     out="$(cat "${rev_test_data}" | ${rev} 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -353,14 +367,8 @@ rev_sh_pipe_multi_overflow_line_no_nl()
     out="$(cat "${rev_test_data}" | ${rev} 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -412,14 +420,8 @@ rev_sh_file_single_overflow_line()
     out="$(${rev} "${rev_test_data}" 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -471,14 +473,8 @@ rev_sh_file_single_overflow_line_no_nl()
     out="$(${rev} "${rev_test_data}" 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -528,14 +524,8 @@ rev_sh_file_multi_overflow_line()
     out="$(${rev} "${rev_test_data}" 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -586,14 +576,8 @@ rev_sh_file_multi_overflow_line_no_nl()
     out="$(${rev} "${rev_test_data}" 2>${stderr})"
     empty=
 
-    if [ "${enable_malloc}" = "1" ]
-    then
-        mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
-        mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
-    else
-        mt_fail "strcmp \"$(cat ${stderr})\" \"e/line is longer than\""
-        mt_fail "[ \"${out}\" = \"${empty}\" ]"
-    fi
+    mt_fail "[ \"${out}\" = \"$(cat ${rev_expected_data})\" ]"
+    mt_fail "[ \"$(cat ${stderr})\" = \"${empty}\" ]"
 }
 
 
@@ -601,10 +585,91 @@ rev_sh_file_multi_overflow_line_no_nl()
 ## ==========================================================================
 
 
-rev_sh_three_args()
+rev_sh_zero_copy_pipe()
 {
-    ${rev} file1 file2 2>${stderr}
-    mt_fail "strcmp \"$(cat ${stderr})\" \"usage: rev [ -v | -h | <file> ]\""
+    # rev writes to pipe here, so vmsplice() is used if it's available,
+    # data must be way bigger than the pipe, so gather blocks are reused
+
+    od -An -tx1 /dev/urandom | head -n 100000 > "${rev_test_data}"
+    ${rev} "${rev_test_data}" > "${rev_expected_data}"
+    ${rev} -z "${rev_test_data}" | cat > "${rev_test_file}"
+    mt_fail "cmp \"${rev_test_file}\" \"${rev_expected_data}\""
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_zero_copy_slow_reader()
+{
+    # reader starts only after pipe is full, pages it gets must still
+    # hold what was spliced, not data of blocks written after that
+
+    od -An -tx1 /dev/urandom | head -n 100000 > "${rev_test_data}"
+    ${rev} "${rev_test_data}" > "${rev_expected_data}"
+    ${rev} -z "${rev_test_data}" | { sleep 1; cat; } > "${rev_test_file}"
+    mt_fail "cmp \"${rev_test_file}\" \"${rev_expected_data}\""
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_inplace()
+{
+    printf "abc\n12345\nxyz" > "${rev_test_file}"
+    ${rev} -i "${rev_test_file}"
+    mt_fail "[ \"$(cat ${rev_test_file})\" = \"$(printf "cba\n54321\nzyx")\" ]"
+    mt_fail "[ ! -e \"${rev_test_file}.rev-journal\" ]"
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_giant_line()
+{
+    giant_line
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_giant_line_utf8()
+{
+    giant_line -u
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_multi_file()
+{
+    printf "abc\n12345\n" > "${rev_test_data}"
+    printf "xyz\n" > "${rev_test_file}"
+    out="$(${rev} "${rev_test_data}" "${rev_test_file}" "${rev_test_data}")"
+    mt_fail "[ \"${out}\" = \"$(printf "cba\n54321\nzyx\ncba\n54321")\" ]"
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
+rev_sh_multi_file_missing()
+{
+    printf "abc\n" > "${rev_test_data}"
+    out="$(${rev} "${rev_test_data}" "/i/dont/exist" 2>${stderr})"
+    mt_fail "[ ${?} -ne 0 ]"
+    mt_fail "[ \"${out}\" = \"cba\" ]"
+    mt_fail "strcmp \"$(cat ${stderr})\" \"e/fopen(): \""
 }
 
 
@@ -623,6 +688,17 @@ rev_sh_invalid_arg()
 ## ==========================================================================
 
 
+rev_sh_grouped_arg()
+{
+    ${rev} -iu "${rev_test_file}" 2>${stderr}
+    mt_fail "strcmp \"$(cat ${stderr})\" \"e/invalid option -iu\""
+}
+
+
+## ==========================================================================
+## ==========================================================================
+
+
 rev_sh_file_not_found()
 {
     ${rev} "/i/dont/exist" 2>${stderr}
@@ -686,8 +762,15 @@ mt_run rev_sh_file_multi_empty_line_no_nl
 mt_run rev_sh_file_multi_line_no_nl
 mt_run rev_sh_file_multi_full_line_no_nl
 mt_run rev_sh_file_multi_overflow_line_no_nl
-mt_run rev_sh_three_args
+mt_run rev_sh_zero_copy_pipe
+mt_run rev_sh_zero_copy_slow_reader
+mt_run rev_sh_inplace
+mt_run rev_sh_giant_line
+mt_run rev_sh_giant_line_utf8
+mt_run rev_sh_multi_file
+mt_run rev_sh_multi_file_missing
 mt_run rev_sh_invalid_arg
+mt_run rev_sh_grouped_arg
 mt_run rev_sh_file_not_found
 mt_run rev_sh_permision_denied
 
@@ -18,8 +18,10 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -43,6 +45,7 @@ mt_defs();
 #define EXPECTED_DIR TEST_DATA_DIR"/seq"
 #define SEQ_TEST_STDOUT "./seq-test-stdout"
 #define SEQ_TEST_STDERR "./seq-test-stderr"
+#define SEQ_TEST_OUT "./seq-test-out"
 
 
 /* ==========================================================================
@@ -63,6 +66,24 @@ struct valid_params
 };
 
 
+struct format_params
+{
+    char                 *opts[8];  /* options for seq, NULL terminated */
+    const char           *pfmt;     /* printf() format of single number */
+    const char           *sep;      /* separator between numbers */
+    const char           *out;      /* file seq writes to, or NULL */
+    struct valid_params   p;        /* numbers to print */
+};
+
+
+struct binary_params
+{
+    char                 *type;     /* type of binary numbers */
+    char                 *opt;      /* additional option, or NULL */
+    struct valid_params   p;        /* numbers to print */
+};
+
+
 struct invalid_params
 {
     char  *first;
@@ -115,6 +136,7 @@ static void cleanup_test(void)
     restore_stdout();
     unlink(SEQ_TEST_STDOUT);
     unlink(SEQ_TEST_STDERR);
+    unlink(SEQ_TEST_OUT);
 }
 
 
@@ -600,27 +622,137 @@ static void invalid_tests(void)
 
 
 /* ==========================================================================
+    Runs seq with options 'opts' (NULL terminated) and numbers from 'p',
+    and compares output with numbers printed with printf() 'pfmt' and
+    separated with 'sep', useful for ranges too big to keep expected
+    output in 'data/seq'. Output is read from 'out' file, or from stdout,
+    when 'out' is NULL. When 'query' is set, only size and count of
+    output are expected.
    ========================================================================== */
 
 
-static void seq_print_help(void)
+static void seq_printf_check
+(
+    struct valid_params  *p,
+    char                 *opts[],
+    const char           *out,
+    int                   query,
+    const char           *pfmt,
+    const char           *sep
+)
 {
-    int    argc = 2;
-    char  *argv[] = { "seq", "-h", NULL };
-    char   buf[128] = {0};
-    char  *expected =
-        "usage: seq <last>\n"
-        "       seq <first> <last>\n"
-        "       seq <first> <increment> <last>\n";
+    char                 *argv[16];
+    int                   argc;
+    char                  first_s[32];
+    char                  increment_s[32];
+    char                  last_s[32];
+    char                 *expected;
+    char                 *buf;
+    size_t                size;
+    size_t                len;
+    ssize_t               r;
+    unsigned long         count;
+    long                  n;
+    int                   fd;
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-    stderr_to_file(SEQ_TEST_STDERR);
+
+    argv[0] = "seq";
+
+    for (argc = 1; *opts; ++argc)
+    {
+        argv[argc] = *opts++;
+    }
+
+    sprintf(first_s, "%ld", p->first);
+    sprintf(increment_s, "%ld", p->increment);
+    sprintf(last_s, "%ld", p->last);
+    argv[argc++] = "--";
+    argv[argc++] = first_s;
+    argv[argc++] = increment_s;
+    argv[argc++] = last_s;
+    argv[argc] = NULL;
+
+    size = 8 * 1024 * 1024;
+    expected = malloc(size);
+    buf = malloc(size);
+    len = 0;
+    count = 0;
+
+    for (n = p->first;; n += p->increment)
+    {
+        if (p->increment > 0 ? n > p->last : n < p->last)
+        {
+            break;
+        }
+
+        if (len < size)
+        {
+            len += snprintf(expected + len, size - len, pfmt, n);
+        }
+
+        if (len < size)
+        {
+            len += snprintf(expected + len, size - len, "%s", sep);
+        }
+
+        if (len >= size)
+        {
+            /* test data must be kept small enough for expected
+             * output to fit in buffer
+             */
+
+            mt_fail(len < size);
+            free(expected);
+            free(buf);
+            return;
+        }
+
+        ++count;
+
+        if ((p->increment > 0 && n > p->last - p->increment) ||
+            (p->increment < 0 && n < p->last - p->increment))
+        {
+            /* next step would overflow
+             */
+
+            break;
+        }
+    }
+
+    if (count)
+    {
+        /* last number is followed by new line, not separator
+         */
+
+        len -= strlen(sep);
+        expected[len++] = '\n';
+    }
+
+    if (query)
+    {
+        len = sprintf(expected, "%lu\n%lu\n", (unsigned long)len, count);
+    }
+
     mt_fok(u3_seq_main(argc, argv));
 
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
-    restore_stderr();
+    if (out)
+    {
+        fd = open(out, O_RDONLY);
+        r = read_all(fd, buf, size);
+        close(fd);
+    }
+    else
+    {
+        rewind_stdout_file();
+        r = read_stdout_file(buf, size);
+    }
+
+    mt_fail(r == (ssize_t)len);
+    mt_fail(memcmp(buf, expected, len) == 0);
+
+    free(expected);
+    free(buf);
 }
 
 
@@ -628,77 +760,1293 @@ static void seq_print_help(void)
    ========================================================================== */
 
 
-static void seq_print_version(void)
+static void seq_printf_test
+(
+    struct valid_params  *p
+)
 {
-    int    argc = 2;
-    char  *argv[] = { "seq", "-v", NULL };
-    char   buf[128] = {0};
-    char  *expected = "seq v";
+    char                 *opts[] = { NULL };
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
 
-    stderr_to_file(SEQ_TEST_STDERR);
+    seq_printf_check(p, opts, NULL, 0, "%ld", "\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_jobs_test
+(
+    struct valid_params  *p
+)
+{
+    char                 *opts[] = { "-j", "4", NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    seq_printf_check(p, opts, NULL, 0, "%ld", "\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_file_test
+(
+    struct valid_params  *p
+)
+{
+    char                 *opts[] = { "-o", SEQ_TEST_OUT, NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    seq_printf_check(p, opts, SEQ_TEST_OUT, 0, "%ld", "\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_file_jobs_test
+(
+    struct valid_params  *p
+)
+{
+    char                 *opts[] = { "-j3", "-o", SEQ_TEST_OUT, NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    seq_printf_check(p, opts, SEQ_TEST_OUT, 0, "%ld", "\n");
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_query_test
+(
+    struct valid_params  *p
+)
+{
+    char                 *opts[] = { "--bytes", "--count", NULL };
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    seq_printf_check(p, opts, NULL, 1, "%ld", "\n");
+}
+
+
+/* ==========================================================================
+    Checks ranges where digits are carried or borrowed over many places,
+    sign changes, or numbers are close to limits, and that size of output
+    is computed exactly. Ranges longer than single chunk are checked with
+    multiple threads and with output to file.
+   ========================================================================== */
+
+
+static void printf_tests(void)
+{
+    struct valid_params  p[] =
+    {
+        { 1, 1, 10000 },
+        { 10000, -1, 1 },
+        { 0, 7, 20000 },
+        { -20000, 13, 20000 },
+        { 20000, -13, -20000 },
+        { -9999, 1, 9999 },
+        { 99, 901, 100000 },
+        { 100000, -901, -99 },
+        { 95, 1, 100500 },
+        { -95, -1, -100500 },
+        { 100500, -1, 95 },
+        { 5, -5, -5 },
+        { -5, 5, 5 },
+        { -1, 1, 1 },
+        { 1, -1, -1 },
+        { LONG_MAX - 5000, 1, LONG_MAX - 1 },
+        { LONG_MAX - 1, -999999999999999, 0 },
+        { -LONG_MAX + 1, 1, -LONG_MAX + 5000 },
+        { -LONG_MAX + 1, 999999999999999, LONG_MAX - 1 },
+        { -LONG_MAX + 1, LONG_MAX - 1, LONG_MAX - 1 },
+        { LONG_MAX - 1, -LONG_MAX + 1, -LONG_MAX + 1 }
+    };
+    struct valid_params  pj[] =
+    {
+        { 1, 1, 300000 },
+        { -150000, 1, 150000 },
+        { 150000, -1, -150000 },
+        { 1, 1, 10 },
+        { -LONG_MAX + 1, 99999999999999, LONG_MAX - 1 }
+    };
+    char                  tname[256];
+    size_t                i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(p) / sizeof(*p); ++i)
+    {
+        sprintf(tname, "seq_printf_test %ld %ld %ld",
+            p[i].first, p[i].increment, p[i].last);
+        mt_run_param_named(seq_printf_test, &p[i], tname);
+    }
+
+    for (i = 0; i != sizeof(p) / sizeof(*p); ++i)
+    {
+        sprintf(tname, "seq_query_test %ld %ld %ld",
+            p[i].first, p[i].increment, p[i].last);
+        mt_run_param_named(seq_query_test, &p[i], tname);
+    }
+
+    for (i = 0; i != sizeof(pj) / sizeof(*pj); ++i)
+    {
+        sprintf(tname, "seq_jobs_test %ld %ld %ld",
+            pj[i].first, pj[i].increment, pj[i].last);
+        mt_run_param_named(seq_jobs_test, &pj[i], tname);
+        sprintf(tname, "seq_file_test %ld %ld %ld",
+            pj[i].first, pj[i].increment, pj[i].last);
+        mt_run_param_named(seq_file_test, &pj[i], tname);
+        sprintf(tname, "seq_file_jobs_test %ld %ld %ld",
+            pj[i].first, pj[i].increment, pj[i].last);
+        mt_run_param_named(seq_file_jobs_test, &pj[i], tname);
+    }
+}
+
+
+/* ==========================================================================
+    Query only tells what would be printed, output file passed with -o
+    must be left as it is.
+   ========================================================================== */
+
+
+static void seq_query_keeps_output(void)
+{
+    int    argc = 7;
+    char  *argv[] = { "seq", "--bytes", "--count", "-o", SEQ_TEST_OUT,
+        "1", "10", NULL };
+    char   buf[64] = {0};
+    int    fd;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    fd = open(SEQ_TEST_OUT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    mt_fail(write(fd, "hello", 5) == 5);
+    close(fd);
+
     mt_fok(u3_seq_main(argc, argv));
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, sizeof(buf)) == 6);
+    mt_fail(memcmp(buf, "21\n10\n", 6) == 0);
 
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
-    restore_stderr();
+    fd = open(SEQ_TEST_OUT, O_RDONLY);
+    mt_fail(read_all(fd, buf, sizeof(buf)) == 5);
+    close(fd);
+    mt_fail(memcmp(buf, "hello", 5) == 0);
 }
 
 
 /* ==========================================================================
+    Runs seq with format options from 'f', and then checks if size of
+    output is computed properly for them.
    ========================================================================== */
 
 
-#if HAVE_MUTABLE_STDOUT
+static void seq_format_test
+(
+    struct format_params  *f
+)
+{
+    char                  *opts[16];
+    int                    i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-static void seq_stdout_error(void)
+
+    seq_printf_check(&f->p, f->opts, f->out, 0, f->pfmt, f->sep);
+
+    opts[0] = "--bytes";
+    opts[1] = "--count";
+
+    for (i = 0; f->opts[i]; ++i)
+    {
+        opts[i + 2] = f->opts[i];
+    }
+
+    opts[i + 2] = NULL;
+    restore_stdout();
+    stdout_to_file(SEQ_TEST_STDOUT);
+    seq_printf_check(&f->p, opts, NULL, 1, f->pfmt, f->sep);
+}
+
+
+/* ==========================================================================
+    Checks numbers printed with custom format, separator and with equal
+    width, on paths where numbers are printed one by one, in blocks, in
+    multiple threads and directly to file.
+   ========================================================================== */
+
+
+static void format_tests(void)
 {
-    int    argc = 2;
-    char  *argv[] = { "seq", "5" };
-    char   buf[128] = {0};
-    char  *expected = "e/printf()";
+    struct format_params  f[] =
+    {
+        { { "-w", NULL }, "%06ld", "\n", NULL, { 95, 1, 100500 } },
+        { { "-w", NULL }, "%07ld", "\n", NULL, { -100500, 1, -95 } },
+        { { "-w", NULL }, "%03ld", "\n", NULL, { -10, 3, 11 } },
+        { { "-w", NULL }, "%03ld", "\n", NULL, { 1, 3, 100 } },
+        { { "-s", ",", NULL }, "%ld", ",", NULL, { 1, 1, 10000 } },
+        { { "-s", "", NULL }, "%ld", "", NULL, { -150, 1, 150 } },
+        { { "-s", ",", NULL }, "%ld", ",", NULL, { 1, 1, 100 } },
+        { { "-s", ",", NULL }, "%ld", ",", NULL, { 1, 1, 0 } },
+        { { "-f", "%+05d;", "-s", " | ", NULL }, "%+05ld;", " | ", NULL,
+            { -20000, 13, 20000 } },
+        { { "-f", "%-8i|", NULL }, "%-8ld|", "\n", NULL, { 1, 1, 150000 } },
+        { { "-f", "% 10ld", "-s", ", ", NULL }, "% 10ld", ", ", NULL,
+            { 100500, -1, 95 } },
+        { { "-f", "100%% [%d]", NULL }, "100%% [%ld]", "\n", NULL,
+            { 1, 1, 1000 } },
+        { { "-f", "%020d", NULL }, "%020ld", "\n", NULL,
+            { -LONG_MAX + 1, 999999999999999, LONG_MAX - 1 } },
+        { { "-j", "4", "-w", "-s", ", ", NULL }, "%07ld", ", ", NULL,
+            { -150000, 1, 150000 } },
+        { { "-j3", "-f", "<%12d>", "-o", SEQ_TEST_OUT, NULL }, "<%12ld>",
+            "\n", SEQ_TEST_OUT, { 1, 1, 300000 } },
+        { { "-f", "%d", "-s", ":", "-o", SEQ_TEST_OUT, NULL }, "%ld", ":",
+            SEQ_TEST_OUT, { 300000, -7, -300000 } },
+        { { "--radix=16", NULL }, "%lx", "\n", NULL, { 1, 1, 300000 } },
+        { { "--radix", "8", NULL }, "%lo", "\n", NULL, { 300000, -1, 0 } },
+        { { "--radix=16", "-w", NULL }, "%05lx", "\n", NULL,
+            { 0, 17, 1000000 } },
+        { { "-f", "0x%08X", "-s", " ", NULL }, "0x%08lX", " ", NULL,
+            { 65000, 1, 70000 } },
+        { { "-f", "%o", NULL }, "%lo", "\n", NULL,
+            { 0, 999999999999999, LONG_MAX - 1 } },
+        { { "-f", "%lx", NULL }, "%lx", "\n", NULL,
+            { LONG_MAX - 5000, 1, LONG_MAX - 1 } },
+        { { "-j3", "--radix=16", NULL }, "%lx", "\n", NULL,
+            { 0, 1, 300000 } },
+        { { "-j3", "--radix=8", "-w", "-o", SEQ_TEST_OUT, NULL }, "%07lo",
+            "\n", SEQ_TEST_OUT, { 1, 1, 300000 } },
+        { { "-j", "9223372036854775807", NULL }, "%ld", "\n", NULL,
+            { 1, 1, 300000 } },
+        { { "-j", "2305843009213693953", "-o", SEQ_TEST_OUT, NULL }, "%ld",
+            "\n", SEQ_TEST_OUT, { 1, 1, 300000 } }
+    };
+    char                   tname[256];
+    size_t                 i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(f) / sizeof(*f); ++i)
+    {
+        sprintf(tname, "seq_format_test '%s' %ld %ld %ld", f[i].pfmt,
+            f[i].p.first, f[i].p.increment, f[i].p.last);
+        mt_run_param_named(seq_format_test, &f[i], tname);
+    }
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_format_invalid(void)
+{
+    char  *formats[] = { "%f", "%d%d", "abc", "%5", "%", "%#d", "%.3d",
+                         "%65d" };
+    char  *argv[] = { "seq", "-f", NULL, "5", NULL };
+    char  *wargv[] = { "seq", "-w", "-f", "%d", "5", NULL };
+    char   buf = '\0';
+    size_t i;
     /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
+
     stderr_to_file(SEQ_TEST_STDERR);
-    stdout_sabotage(SEQ_TEST_STDOUT);
-    mt_fail(u3_seq_main(argc, argv) == -1);
-    stdout_recover();
 
-    rewind_stderr_file();
-    read_stderr_file(buf, sizeof(buf));
-    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    for (i = 0; i != sizeof(formats) / sizeof(*formats); ++i)
+    {
+        argv[2] = formats[i];
+        mt_ferr(u3_seq_main(4, argv), EINVAL);
+    }
+
+    mt_ferr(u3_seq_main(5, wargv), EINVAL);
+    mt_ferr(u3_seq_main(2, argv), EINVAL);
     restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
 }
 
-#endif /* HAVE_MUTABLE_STDOUT */
-
 
 /* ==========================================================================
-                                              _
-                           ____ ___   ____ _ (_)____
-                          / __ `__ \ / __ `// // __ \
-                         / / / / / // /_/ // // / / /
-                        /_/ /_/ /_/ \__,_//_//_/ /_/
-
+    Runs seq with binary type and option from 'b', and compares output
+    with numbers stored byte by byte. Then checks if size of output is
+    computed properly.
    ========================================================================== */
 
 
-int main(void)
+static void seq_binary_test
+(
+    struct binary_params  *b
+)
 {
-#if HAVE_MUTABLE_STDOUT
+    char                  *argv[16];
+    int                    argc;
+    char                   type[32];
+    char                   first_s[32];
+    char                   increment_s[32];
+    char                   last_s[32];
+    unsigned char         *expected;
+    unsigned char         *buf;
+    unsigned long          x;
+    size_t                 bsize;
+    size_t                 size;
+    size_t                 len;
+    size_t                 i;
+    ssize_t                r;
+    long                   n;
+    int                    be;
+    int                    fd;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
 
-    mt_run(seq_stdout_error);
 
-#endif /* HAVE_MUTABLE_STDOUT */
+    sprintf(type, "--binary=%s", b->type);
+    sprintf(first_s, "%ld", b->p.first);
+    sprintf(increment_s, "%ld", b->p.increment);
+    sprintf(last_s, "%ld", b->p.last);
+    argc = 0;
+    argv[argc++] = "seq";
+    argv[argc++] = type;
 
-    mt_prepare_test = prepare_test;
-    mt_cleanup_test = cleanup_test;
+    if (b->opt)
+    {
+        argv[argc++] = b->opt;
+    }
 
-    valid_tests();
-    invalid_tests();
+    if (b->opt && strcmp(b->opt, "-o") == 0)
+    {
+        argv[argc++] = SEQ_TEST_OUT;
+    }
+
+    argv[argc++] = "--";
+    argv[argc++] = first_s;
+    argv[argc++] = increment_s;
+    argv[argc++] = last_s;
+    argv[argc] = NULL;
 
+    bsize = strstr(b->type, "32") ? 4 : 8;
+    be = strstr(b->type, "be") != NULL;
+    size = 8 * 1024 * 1024;
+    expected = malloc(size);
+    buf = malloc(size);
+    len = 0;
+
+    for (n = b->p.first;; n += b->p.increment)
+    {
+        if (b->p.increment > 0 ? n > b->p.last : n < b->p.last)
+        {
+            break;
+        }
+
+        x = (unsigned long)n;
+
+        for (i = 0; i != bsize; ++i)
+        {
+            expected[len + (be ? bsize - 1 - i : i)] = (x >> (8 * i)) & 0xff;
+        }
+
+        len += bsize;
+
+        if ((b->p.increment > 0 && n > b->p.last - b->p.increment) ||
+            (b->p.increment < 0 && n < b->p.last - b->p.increment))
+        {
+            /* next step would overflow
+             */
+
+            break;
+        }
+    }
+
+    mt_fok(u3_seq_main(argc, argv));
+
+    if (b->opt && strcmp(b->opt, "-o") == 0)
+    {
+        fd = open(SEQ_TEST_OUT, O_RDONLY);
+        r = read_all(fd, buf, size);
+        close(fd);
+    }
+    else
+    {
+        rewind_stdout_file();
+        r = read_stdout_file(buf, size);
+    }
+
+    mt_fail(r == (ssize_t)len);
+    mt_fail(memcmp(buf, expected, len) == 0);
+
+    /* and now only size of output
+     */
+
+    restore_stdout();
+    stdout_to_file(SEQ_TEST_STDOUT);
+    argv[1] = "--bytes";
+    argv[2] = type;
+    argv[3] = "--";
+    argv[4] = first_s;
+    argv[5] = increment_s;
+    argv[6] = last_s;
+    argv[7] = NULL;
+    mt_fok(u3_seq_main(7, argv));
+    len = sprintf((char *)expected, "%lu\n", (unsigned long)len);
+    rewind_stdout_file();
+    r = read_stdout_file(buf, size);
+    mt_fail(r == (ssize_t)len);
+    mt_fail(memcmp(buf, expected, len) == 0);
+
+    free(expected);
+    free(buf);
+}
+
+
+/* ==========================================================================
+    Checks all binary types, with numbers close to limits of type, with
+    multiple threads and with output to file.
+   ========================================================================== */
+
+
+static void binary_tests(void)
+{
+    struct binary_params  b[] =
+    {
+        { "i32le", NULL, { -1000, 7, 1000 } },
+        { "i32be", NULL, { 1000, -7, -1000 } },
+        { "u32le", NULL, { 0, 1, 1000 } },
+        { "u32be", NULL, { 1000, -1, 0 } },
+        { "i64le", NULL, { -1000, 7, 1000 } },
+        { "i64be", NULL, { 1000, -7, -1000 } },
+        { "i32le", NULL, { 2147483647, -1, 2147483000 } },
+        { "i32be", NULL, { -2147483647 - 1, 1, -2147483000 } },
+        { "u32le", NULL, { 4294967295, -65537, 0 } },
+        { "i64be", NULL, { -LONG_MAX + 1, 999999999999999, LONG_MAX - 1 } },
+        { "i64le", "-j4", { -150000, 1, 150000 } },
+        { "u32be", "-j4", { 1, 3, 900000 } },
+        { "i64be", "-o", { 1, 1, 300000 } },
+        { "i32le", "-j3", { 1, 1, 0 } }
+    };
+    char                  tname[256];
+    size_t                i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(b) / sizeof(*b); ++i)
+    {
+        sprintf(tname, "seq_binary_test %s %s %ld %ld %ld", b[i].type,
+            b[i].opt ? b[i].opt : "", b[i].p.first, b[i].p.increment,
+            b[i].p.last);
+        mt_run_param_named(seq_binary_test, &b[i], tname);
+    }
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_binary_invalid(void)
+{
+    char  *argv[] = { "seq", "--binary", NULL, "--", NULL, "1", NULL,
+                      NULL };
+    char  *sargv[] = { "seq", "--binary=i32le", "-s", ",", "5", NULL };
+    char  *fargv[] = { "seq", "--binary=i32le", "-f", "%d", "5", NULL };
+    char  *wargv[] = { "seq", "--binary=i32le", "-w", "5", NULL };
+    char   buf = '\0';
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+
+    argv[2] = "i16le";
+    argv[4] = "1";
+    argv[6] = "5";
+    mt_ferr(u3_seq_main(7, argv), EINVAL);
+
+    argv[2] = "u32le";
+    argv[4] = "-1";
+    mt_ferr(u3_seq_main(7, argv), ERANGE);
+
+    argv[4] = "0";
+    argv[6] = "4294967296";
+    mt_ferr(u3_seq_main(7, argv), ERANGE);
+
+    argv[2] = "i32be";
+    argv[4] = "-2147483649";
+    argv[6] = "-2147483600";
+    mt_ferr(u3_seq_main(7, argv), ERANGE);
+
+    mt_ferr(u3_seq_main(2, argv), EINVAL);
+
+    mt_ferr(u3_seq_main(5, sargv), EINVAL);
+    mt_ferr(u3_seq_main(5, fargv), EINVAL);
+    mt_ferr(u3_seq_main(4, wargv), EINVAL);
+
+    restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
+}
+
+
+/* ==========================================================================
+    Runs seq with 'argc' arguments from 'argv', and reads its output into
+    'buf' of 'size' bytes. When 'out' is not NULL, output is read from
+    there, and not from stdout. Returns number of bytes read.
+   ========================================================================== */
+
+
+static ssize_t seq_run
+(
+    int          argc,
+    char        *argv[],
+    const char  *out,
+    char        *buf,
+    size_t       size
+)
+{
+    ssize_t      r;
+    int          fd;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    restore_stdout();
+    stdout_to_file(SEQ_TEST_STDOUT);
+    mt_fok(u3_seq_main(argc, argv));
+
+    if (out)
+    {
+        fd = open(out, O_RDONLY);
+        r = read_all(fd, buf, size);
+        close(fd);
+        return r;
+    }
+
+    rewind_stdout_file();
+    return read_stdout_file(buf, size);
+}
+
+
+/* ==========================================================================
+    Checks numbers in radix 2, and negative numbers in other radixes,
+    these are printed as sign and magnitude, which printf() cannot do.
+   ========================================================================== */
+
+
+static void seq_radix_test(void)
+{
+    char        *argv[] = { "seq", NULL, NULL, NULL, NULL, NULL };
+    char         buf[1024];
+    const char  *e;
+    ssize_t      r;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    argv[1] = "--radix=2";
+    argv[2] = "-w";
+    argv[3] = "-3";
+    argv[4] = "5";
+    e = "-11\n-10\n-01\n000\n001\n010\n011\n100\n101\n";
+    r = seq_run(5, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+
+    argv[1] = "-f";
+    argv[2] = "[%+x]";
+    argv[3] = "-20";
+    argv[4] = "-14";
+    e = "[-14]\n[-13]\n[-12]\n[-11]\n[-10]\n[-f]\n[-e]\n";
+    r = seq_run(5, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+
+    argv[1] = "--radix=8";
+    argv[2] = "--";
+    argv[3] = "-9";
+    argv[4] = "-7";
+    e = "-11\n-10\n-7\n";
+    r = seq_run(5, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+
+    argv[1] = "-f";
+    argv[2] = "%b";
+    argv[3] = "126";
+    argv[4] = "130";
+    e = "1111110\n1111111\n10000000\n10000001\n10000010\n";
+    r = seq_run(5, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_radix_invalid(void)
+{
+    char  *radixes[] = { "7", "1", "0", "-16", "36", "x" };
+    char  *argv[] = { "seq", "--radix", NULL, "5", NULL };
+    char  *fargv[] = { "seq", "--radix=16", "-f", "%x", "5", NULL };
+    char   buf = '\0';
+    size_t i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+
+    for (i = 0; i != sizeof(radixes) / sizeof(*radixes); ++i)
+    {
+        argv[2] = radixes[i];
+        mt_ferr(u3_seq_main(4, argv), EINVAL);
+    }
+
+    mt_ferr(u3_seq_main(5, fargv), EINVAL);
+    mt_ferr(u3_seq_main(2, argv), EINVAL);
+    restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_suffix_test(void)
+{
+    char        *argv[] = { "seq", NULL, NULL, NULL, NULL };
+    char         buf[1024];
+    const char  *e;
+    ssize_t      r;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    argv[1] = "1Ki";
+    argv[2] = "1Ki";
+    argv[3] = "3Ki";
+    e = "1024\n2048\n3072\n";
+    r = seq_run(4, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+
+    argv[1] = "-2K";
+    argv[2] = "1K";
+    argv[3] = "-1K";
+    e = "-2000\n-1000\n";
+    r = seq_run(4, argv, NULL, buf, sizeof(buf));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+
+    argv[1] = "-1M";
+    argv[2] = "1G";
+    argv[3] = "1T";
+    e = "-1000000\n999000000\n1999000000\n";
+    r = seq_run(4, argv, NULL, buf, strlen(e));
+    mt_fail(r == (ssize_t)strlen(e) && memcmp(buf, e, r) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_suffix_invalid(void)
+{
+    char    *nums[] = { "1k", "1KiB", "K", "1i", "1Kb", "1 K" };
+    char    *ranges[] = { "8388608Ti", "-8388608Ti", "9223372036854775807",
+        "-9223372036854775808", "9223372036854775808" };
+    char    *argv[] = { "seq", NULL, NULL };
+    char     buf = '\0';
+    size_t   i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+
+    for (i = 0; i != sizeof(nums) / sizeof(*nums); ++i)
+    {
+        argv[1] = nums[i];
+        mt_ferr(u3_seq_main(2, argv), EINVAL);
+    }
+
+    for (i = 0; i != sizeof(ranges) / sizeof(*ranges); ++i)
+    {
+        argv[1] = ranges[i];
+        mt_ferr(u3_seq_main(2, argv), ERANGE);
+    }
+
+    restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
+}
+
+
+/* ==========================================================================
+    Checks if shuffled output contains every number of sequence exactly
+    once, and if it's the same for the same seed, no matter if it's
+    printed by threads, to file or in shards.
+   ========================================================================== */
+
+
+static void seq_shuffle_test(void)
+{
+    char           *argv[] = { "seq", "--shuffle=42", NULL, NULL, NULL,
+                               "--", "-500000", "7", "500000", NULL };
+    char           *expected;
+    char           *buf;
+    char           *seen;
+    char           *p;
+    char            shard[32];
+    size_t          size;
+    ssize_t         len;
+    ssize_t         r;
+    unsigned long   count;
+    unsigned long   inplace;
+    long            n;
+    int             k;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 8 * 1024 * 1024;
+    expected = malloc(size);
+    buf = malloc(size);
+    seen = calloc(1000000 / 7 + 1, 1);
+    argv[2] = argv[3] = argv[4] = "-j1";
+
+    len = seq_run(9, argv, NULL, expected, size);
+    mt_fail(len > 0);
+    expected[len] = '\0';
+    count = 0;
+    inplace = 0;
+
+    for (p = expected; *p; ++p)
+    {
+        n = strtol(p, &p, 10);
+        mt_fail((n + 500000) % 7 == 0);
+        mt_fail(seen[(n + 500000) / 7] == 0);
+        seen[(n + 500000) / 7] = 1;
+        inplace += n == -500000 + 7 * (long)count;
+        ++count;
+    }
+
+    mt_fail(count == 1000000 / 7 + 1);
+    mt_fail(inplace < 100);
+
+    /* same seed gives the same order
+     */
+
+    r = seq_run(9, argv, NULL, buf, size);
+    mt_fail(r == len && memcmp(buf, expected, len) == 0);
+
+    argv[2] = "-j4";
+    r = seq_run(9, argv, NULL, buf, size);
+    mt_fail(r == len && memcmp(buf, expected, len) == 0);
+
+    argv[3] = "-o";
+    argv[4] = SEQ_TEST_OUT;
+    r = seq_run(9, argv, SEQ_TEST_OUT, buf, size);
+    mt_fail(r == len && memcmp(buf, expected, len) == 0);
+
+    /* shards put together give whole output
+     */
+
+    argv[2] = "--shard";
+    argv[3] = shard;
+    argv[4] = "-j1";
+    r = 0;
+
+    for (k = 1; k <= 5; ++k)
+    {
+        sprintf(shard, "%d/5", k);
+        r += seq_run(9, argv, NULL, buf + r, size - r);
+    }
+
+    mt_fail(r == len && memcmp(buf, expected, len) == 0);
+
+    /* and different seed gives different order
+     */
+
+    argv[1] = "--shuffle=43";
+    argv[2] = argv[3] = "-j1";
+    r = seq_run(9, argv, NULL, buf, size);
+    mt_fail(r == len && memcmp(buf, expected, len) != 0);
+
+    free(expected);
+    free(buf);
+    free(seen);
+}
+
+
+/* ==========================================================================
+    Shuffles small sequences in binary, every number must be there.
+   ========================================================================== */
+
+
+static void seq_shuffle_binary_test(void)
+{
+    char           *argv[] = { "seq", "--binary=i32le", NULL, "1", NULL,
+                               NULL };
+    char            buf[64 * 4];
+    char            last[32];
+    char            seed[32];
+    unsigned char   seen[64];
+    unsigned long   x;
+    ssize_t         r;
+    int             n;
+    int             i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    argv[2] = seed;
+    argv[4] = last;
+
+    for (n = 1; n <= 64; ++n)
+    {
+        sprintf(seed, "--shuffle=%d", n);
+        sprintf(last, "%d", n);
+        r = seq_run(5, argv, NULL, buf, sizeof(buf));
+        mt_fail(r == n * 4);
+        memset(seen, 0, sizeof(seen));
+
+        for (i = 0; i != n; ++i)
+        {
+            x = (unsigned char)buf[i * 4] |
+                (unsigned long)(unsigned char)buf[i * 4 + 1] << 8;
+            mt_fail(x >= 1 && x <= (unsigned long)n && seen[x - 1] == 0);
+            seen[(x - 1) % 64] = 1;
+        }
+    }
+}
+
+
+/* ==========================================================================
+    Prints all shards of sequence one after another, output of all of
+    them should be the same as output of whole sequence. Then checks if
+    shards are of similar size.
+   ========================================================================== */
+
+
+static void seq_shard_test(void)
+{
+    char           *argv[] = { "seq", "--shard", NULL, "-500000", "7",
+                               "500000", NULL };
+    char           *qargv[] = { "seq", "--bytes", "--shard", NULL,
+                                "-500000", "7", "500000", NULL };
+    char           *expected;
+    char           *buf;
+    char           *p;
+    char            shard[32];
+    size_t          size;
+    size_t          len;
+    unsigned long   bytes;
+    unsigned long   min;
+    unsigned long   max;
+    long            n;
+    int             k;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    size = 8 * 1024 * 1024;
+    expected = malloc(size);
+    buf = malloc(size);
+    len = 0;
+
+    for (n = -500000; n <= 500000; n += 7)
+    {
+        len += sprintf(expected + len, "%ld\n", n);
+    }
+
+    argv[2] = shard;
+
+    for (k = 1; k <= 7; ++k)
+    {
+        sprintf(shard, "%d/7", k);
+        mt_fok(u3_seq_main(6, argv));
+    }
+
+    rewind_stdout_file();
+    mt_fail(read_stdout_file(buf, size) == (ssize_t)len);
+    mt_fail(memcmp(buf, expected, len) == 0);
+
+    /* now only size of each shard is printed, they must sum up to
+     * size of whole sequence, and differ by no more than length of
+     * longest number
+     */
+
+    qargv[3] = shard;
+    restore_stdout();
+    stdout_to_file(SEQ_TEST_STDOUT);
+
+    for (k = 1; k <= 7; ++k)
+    {
+        sprintf(shard, "%d/7", k);
+        mt_fok(u3_seq_main(7, qargv));
+    }
+
+    rewind_stdout_file();
+    memset(buf, 0, size);
+    read_stdout_file(buf, size);
+    min = ULONG_MAX;
+    max = 0;
+    p = buf;
+
+    for (k = 1; k <= 7; ++k)
+    {
+        bytes = strtoul(p, &p, 10);
+        min = bytes < min ? bytes : min;
+        max = bytes > max ? bytes : max;
+        len -= bytes;
+    }
+
+    mt_fail(len == 0);
+    mt_fail(max - min <= 8);
+
+    free(expected);
+    free(buf);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_shard_invalid(void)
+{
+    char  *argv[] = { "seq", "--shard", NULL, "5", NULL };
+    char  *shards[] = { "0/3", "4/3", "3", "1/0", "a/3", "1/a", "-1/3" };
+    char   buf = '\0';
+    size_t i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+
+    for (i = 0; i != sizeof(shards) / sizeof(*shards); ++i)
+    {
+        argv[2] = shards[i];
+        mt_ferr(u3_seq_main(4, argv), EINVAL);
+    }
+
+    mt_ferr(u3_seq_main(2, argv), EINVAL);
+    restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
+}
+
+
+/* ==========================================================================
+    Takes all numbers of 'p' from iterator, with buffers of different
+    sizes, and compares them with numbers printed by printf(). Every
+    buffer must end with whole number, and iterator copied in the middle
+    must continue where original stopped.
+   ========================================================================== */
+
+
+static void seq_lib_fill_test
+(
+    struct valid_params  *p
+)
+{
+    size_t                sizes[] = { U3_SEQ_NUM_MAX, 37, 4096, 65536 };
+    struct u3_seq        *seq;
+    struct u3_seq        *copy;
+    struct u3_seq        *it;
+    char                 *expected;
+    char                 *buf;
+    size_t                bsize;
+    size_t                len;
+    size_t                off;
+    ssize_t               n;
+    size_t                i;
+    long                  v;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    bsize = 8 * 1024 * 1024;
+    expected = malloc(bsize);
+    buf = malloc(bsize);
+    seq = malloc(sizeof(*seq));
+    copy = malloc(sizeof(*copy));
+    len = 0;
+
+    for (v = p->first;; v += p->increment)
+    {
+        if (p->increment > 0 ? v > p->last : v < p->last)
+        {
+            break;
+        }
+
+        len += sprintf(expected + len, "%ld\n", v);
+
+        if ((p->increment > 0 && v > p->last - p->increment) ||
+            (p->increment < 0 && v < p->last - p->increment))
+        {
+            break;
+        }
+    }
+
+    for (i = 0; i != sizeof(sizes) / sizeof(*sizes); ++i)
+    {
+        mt_fok(u3_seq_init(seq, p->first, p->increment, p->last));
+        it = seq;
+        off = 0;
+
+        while ((n = u3_seq_fill(it, buf + off, sizes[i])) > 0)
+        {
+            mt_fail((size_t)n <= sizes[i]);
+            mt_fail(buf[off + n - 1] == '\n');
+            off += n;
+
+            if (off > len / 2 && it == seq)
+            {
+                /* continue with copy of iterator, while original
+                 * is trashed
+                 */
+
+                memcpy(copy, seq, sizeof(*seq));
+                memset(seq, 0xaa, sizeof(*seq));
+                it = copy;
+            }
+        }
+
+        mt_fail(n == 0);
+        mt_fail(off == len);
+        mt_fail(memcmp(buf, expected, len) == 0);
+        mt_fail(u3_seq_fill(it, buf, sizes[i]) == 0);
+    }
+
+    free(expected);
+    free(buf);
+    free(seq);
+    free(copy);
+}
+
+
+/* ==========================================================================
+    Checks iterator on ranges where output changes length, crosses zero,
+    or is close to limits.
+   ========================================================================== */
+
+
+static void lib_tests(void)
+{
+    struct valid_params  p[] =
+    {
+        { 1, 1, 100000 },
+        { 100000, -1, 1 },
+        { -20000, 13, 20000 },
+        { 95, 1, 100500 },
+        { 5, -5, -5 },
+        { 1, 1, 1 },
+        { 1, 1, 0 },
+        { LONG_MAX - 5000, 1, LONG_MAX - 1 },
+        { -LONG_MAX + 1, 999999999999999, LONG_MAX - 1 }
+    };
+    char                  tname[256];
+    size_t                i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    for (i = 0; i != sizeof(p) / sizeof(*p); ++i)
+    {
+        sprintf(tname, "seq_lib_fill_test %ld %ld %ld",
+            p[i].first, p[i].increment, p[i].last);
+        mt_run_param_named(seq_lib_fill_test, &p[i], tname);
+    }
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_lib_invalid(void)
+{
+    struct u3_seq  seq;
+    char           buf[U3_SEQ_NUM_MAX];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mt_ferr(u3_seq_init(NULL, 1, 1, 5), EINVAL);
+    mt_ferr(u3_seq_init(&seq, 1, 0, 5), EINVAL);
+    mt_ferr(u3_seq_init(&seq, LONG_MIN, 1, 5), ERANGE);
+    mt_ferr(u3_seq_init(&seq, 1, LONG_MAX, 5), ERANGE);
+    mt_ferr(u3_seq_init(&seq, 1, 1, LONG_MAX), ERANGE);
+
+    mt_fok(u3_seq_init(&seq, 1, 1, 5));
+    mt_ferr(u3_seq_fill(NULL, buf, sizeof(buf)), EINVAL);
+    mt_ferr(u3_seq_fill(&seq, NULL, sizeof(buf)), EINVAL);
+    mt_ferr(u3_seq_fill(&seq, buf, 1), ENOBUFS);
+
+    /* failed calls did not take any number, and buffer is filled
+     * with as many numbers as fit
+     */
+
+    mt_fail(u3_seq_fill(&seq, buf, 7) == 6);
+    mt_fail(memcmp(buf, "1\n2\n3\n", 6) == 0);
+    mt_fail(u3_seq_fill(&seq, buf, sizeof(buf)) == 4);
+    mt_fail(memcmp(buf, "4\n5\n", 4) == 0);
+
+    mt_fok(u3_seq_init(&seq, -LONG_MAX + 1, 1, -LONG_MAX + 1));
+    mt_ferr(u3_seq_fill(&seq, buf, sizeof(buf) - 1), ENOBUFS);
+    mt_fail(u3_seq_fill(&seq, buf, sizeof(buf)) == (ssize_t)sizeof(buf));
+    mt_fail(u3_seq_fill(&seq, buf, sizeof(buf)) == 0);
+    mt_fail(u3_seq_fill(&seq, NULL, 0) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_jobs_invalid(void)
+{
+    int    argc = 3;
+    char  *argv[] = { "seq", "-j0", "5", NULL };
+    char   buf = '\0';
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+    mt_ferr(u3_seq_main(argc, argv), EINVAL);
+    argc = 2;
+    argv[1] = "-j";
+    mt_ferr(u3_seq_main(argc, argv), EINVAL);
+    argv[1] = "-x";
+    mt_ferr(u3_seq_main(argc, argv), EINVAL);
+    restore_stderr();
+    rewind_stdout_file();
+    read_stdout_file(&buf, 1);
+    mt_fail(buf == '\0');
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_print_help(void)
+{
+    int    argc = 2;
+    char  *argv[] = { "seq", "-h", NULL };
+    char   buf[128] = {0};
+    char  *expected =
+        "usage: seq <last>\n"
+        "       seq <first> <last>\n"
+        "       seq <first> <increment> <last>\n";
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+    stderr_to_file(SEQ_TEST_STDERR);
+    mt_fok(u3_seq_main(argc, argv));
+
+    rewind_stderr_file();
+    read_stderr_file(buf, sizeof(buf));
+    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    restore_stderr();
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void seq_print_version(void)
+{
+    int    argc = 2;
+    char  *argv[] = { "seq", "-v", NULL };
+    char   buf[128] = {0};
+    char  *expected = "seq v";
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(SEQ_TEST_STDERR);
+    mt_fok(u3_seq_main(argc, argv));
+
+    rewind_stderr_file();
+    read_stderr_file(buf, sizeof(buf));
+    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    restore_stderr();
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+#if HAVE_MUTABLE_STDOUT
+
+static void seq_stdout_error(void)
+{
+    int    argc = 2;
+    char  *argv[] = { "seq", "5" };
+    char   buf[128] = {0};
+    char  *expected = "e/fwrite()";
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+    stderr_to_file(SEQ_TEST_STDERR);
+    stdout_sabotage(SEQ_TEST_STDOUT);
+    mt_fail(u3_seq_main(argc, argv) == -1);
+    stdout_recover();
+
+    rewind_stderr_file();
+    read_stderr_file(buf, sizeof(buf));
+    mt_fail(strncmp(buf, expected, strlen(expected)) == 0);
+    restore_stderr();
+}
+
+#endif /* HAVE_MUTABLE_STDOUT */
+
+
+/* ==========================================================================
+                                              _
+                           ____ ___   ____ _ (_)____
+                          / __ `__ \ / __ `// // __ \
+                         / / / / / // /_/ // // / / /
+                        /_/ /_/ /_/ \__,_//_//_/ /_/
+
+   ========================================================================== */
+
+
+int main(void)
+{
+#if HAVE_MUTABLE_STDOUT
+
+    mt_run(seq_stdout_error);
+
+#endif /* HAVE_MUTABLE_STDOUT */
+
+    mt_prepare_test = prepare_test;
+    mt_cleanup_test = cleanup_test;
+
+    valid_tests();
+    invalid_tests();
+    printf_tests();
+    mt_run(seq_query_keeps_output);
+
+    format_tests();
+    mt_run(seq_format_invalid);
+    mt_run(seq_radix_test);
+    mt_run(seq_radix_invalid);
+    mt_run(seq_suffix_test);
+    mt_run(seq_suffix_invalid);
+    binary_tests();
+    mt_run(seq_binary_invalid);
+    mt_run(seq_shuffle_test);
+    mt_run(seq_shuffle_binary_test);
+    mt_run(seq_shard_test);
+    mt_run(seq_shard_invalid);
+    lib_tests();
+    mt_run(seq_lib_invalid);
+    mt_run(seq_jobs_invalid);
     mt_run(seq_print_help);
     mt_run(seq_print_version);
     mt_return();
@@ -0,0 +1,608 @@
+/* ==========================================================================
+    Licensed under BSD 2clause license See LICENSE file for more information
+    Author: Michał Łyszczek <michal.lyszczek@bofc.pl>
+   ========================================================================== */
+
+
+/* ==========================================================================
+                   _               __            __
+                  (_)____   _____ / /__  __ ____/ /___   _____
+                 / // __ \ / ___// // / / // __  // _ \ / ___/
+                / // / / // /__ / // /_/ // /_/ //  __/(__  )
+               /_//_/ /_/ \___//_/ \__,_/ \__,_/ \___//____/
+
+   ========================================================================== */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mtest.h"
+#include "u3.h"
+
+
+/* ==========================================================================
+                         __       ____ _
+                    ____/ /___   / __/(_)____   ___   _____
+                   / __  // _ \ / /_ / // __ \ / _ \ / ___/
+                  / /_/ //  __// __// // / / //  __/(__  )
+                  \__,_/ \___//_/  /_//_/ /_/ \___//____/
+
+   ========================================================================== */
+
+
+mt_defs();
+
+#define SLEEP_TEST_MANY 10000
+
+
+/* ==========================================================================
+          __             __                     __   _
+     ____/ /___   _____ / /____ _ _____ ____ _ / /_ (_)____   ____   _____
+    / __  // _ \ / ___// // __ `// ___// __ `// __// // __ \ / __ \ / ___/
+   / /_/ //  __// /__ / // /_/ // /   / /_/ // /_ / // /_/ // / / /(__  )
+   \__,_/ \___/ \___//_/ \__,_//_/    \__,_/ \__//_/ \____//_/ /_//____/
+
+   ========================================================================== */
+
+
+#if HAVE_SYS_TIMERFD_H
+
+struct sleep_test_timer
+{
+    struct u3_timer          timer;    /* timer added to wheel */
+    struct u3_timers        *timers;   /* wheel timer is added to */
+    struct sleep_test_timer *cancel;   /* timer to cancel on expiry */
+    long                     delay;    /* delay of timer in ms */
+    long                     added;    /* time timer was added at in us */
+    long                     fired;    /* time timer expired at in us */
+    int                      nfired;   /* number of expiries */
+    int                      readd;    /* times to add timer again */
+    int                      order;    /* order of expiry */
+};
+
+static struct u3_timers  timers;
+static int               nfired;
+
+#endif /* HAVE_SYS_TIMERFD_H */
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ========================================================================== */
+
+
+#if HAVE_SYS_TIMERFD_H
+
+/* ==========================================================================
+    Returns monotonic time in microseconds.
+   ========================================================================== */
+
+
+static long now_us(void)
+{
+    struct timespec  ts;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000l + ts.tv_nsec / 1000;
+}
+
+
+/* ==========================================================================
+    Expiry function of all test timers, records when timer expired, and
+    adds it again or cancels other timer when asked to.
+   ========================================================================== */
+
+
+static void timer_fn
+(
+    struct u3_timer          *timer,
+    void                     *arg
+)
+{
+    struct sleep_test_timer  *t;
+    struct timespec           delay;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    t = arg;
+    mt_fail(timer == &t->timer);
+    t->fired = now_us();
+    t->order = nfired++;
+    ++t->nfired;
+
+    if (t->cancel)
+    {
+        mt_fok(u3_timer_cancel(t->timers, &t->cancel->timer));
+    }
+
+    if (t->readd)
+    {
+        --t->readd;
+        t->added = now_us();
+        delay.tv_sec = t->delay / 1000;
+        delay.tv_nsec = t->delay % 1000 * 1000000l;
+        mt_fok(u3_timer_add(t->timers, &t->timer, &delay, timer_fn, t));
+    }
+}
+
+
+/* ==========================================================================
+    Clears 'n' test timers 't', and initializes their u3 timers. These are
+    filled with garbage first, so nothing relies on them being zeroed.
+   ========================================================================== */
+
+
+static void timer_init
+(
+    struct sleep_test_timer  *t,
+    int                       n
+)
+{
+    int                       i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    memset(t, 0, n * sizeof(*t));
+
+    for (i = 0; i != n; ++i)
+    {
+        memset(&t[i].timer, 0xaa, sizeof(t[i].timer));
+        u3_timer_init(&t[i].timer);
+    }
+}
+
+
+/* ==========================================================================
+    Adds timer 't' to wheel with 'delay_ms' delay.
+   ========================================================================== */
+
+
+static int timer_add
+(
+    struct sleep_test_timer  *t,
+    long                      delay_ms
+)
+{
+    struct timespec           delay;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    t->timers = &timers;
+    t->delay = delay_ms;
+    t->added = now_us();
+    delay.tv_sec = delay_ms / 1000;
+    delay.tv_nsec = delay_ms % 1000 * 1000000l;
+    return u3_timer_add(&timers, &t->timer, &delay, timer_fn, t);
+}
+
+
+/* ==========================================================================
+    Polls descriptor of wheel and runs it, until 'n' timers have expired
+    in total, or 'timeout_ms' passes. Returns number of expired timers.
+   ========================================================================== */
+
+
+static int timers_wait
+(
+    int            n,
+    long           timeout_ms
+)
+{
+    struct pollfd  pfd;
+    long           end;
+    int            ret;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    end = now_us() + timeout_ms * 1000;
+    pfd.fd = u3_timers_fd(&timers);
+    pfd.events = POLLIN;
+
+    while (nfired < n && now_us() < end)
+    {
+        ret = poll(&pfd, 1, (int)((end - now_us()) / 1000) + 1);
+        mt_fail(ret >= 0);
+
+        if (ret == 1)
+        {
+            mt_fail(u3_timers_run(&timers) >= 0);
+        }
+    }
+
+    return nfired;
+}
+
+
+/* ==========================================================================
+    Checks that timer 't' expired once, not before its delay passed.
+   ========================================================================== */
+
+
+static void timer_check
+(
+    struct sleep_test_timer  *t
+)
+{
+    mt_fail(t->nfired == 1);
+    mt_fail(t->fired - t->added >= t->delay * 1000);
+}
+
+
+/* ==========================================================================
+    Prepares empty wheel for each test.
+   ========================================================================== */
+
+
+static void prepare_test(void)
+{
+    nfired = 0;
+    mt_fok(u3_timers_init(&timers));
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void cleanup_test(void)
+{
+    u3_timers_cleanup(&timers);
+}
+
+#endif /* HAVE_SYS_TIMERFD_H */
+
+
+/* ==========================================================================
+                           __               __
+                          / /_ ___   _____ / /_ _____
+                         / __// _ \ / ___// __// ___/
+                        / /_ /  __/(__  )/ /_ (__  )
+                        \__/ \___//____/ \__//____/
+
+   ========================================================================== */
+
+
+static void sleep_lib_parse(void)
+{
+    struct timespec  ts;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mt_fok(u3_sleep_parse("1.5", &ts));
+    mt_fail(ts.tv_sec == 1 && ts.tv_nsec == 500000000l);
+    mt_fok(u3_sleep_parse("0.000000001", &ts));
+    mt_fail(ts.tv_sec == 0 && ts.tv_nsec == 1);
+    mt_fok(u3_sleep_parse("3", &ts));
+    mt_fail(ts.tv_sec == 3 && ts.tv_nsec == 0);
+
+    mt_ferr(u3_sleep_parse(NULL, &ts), EINVAL);
+    mt_ferr(u3_sleep_parse("1", NULL), EINVAL);
+    mt_ferr(u3_sleep_parse("-1", &ts), EINVAL);
+    mt_ferr(u3_sleep_parse("1.-5", &ts), EINVAL);
+    mt_ferr(u3_sleep_parse("1.0000000001", &ts), EINVAL);
+    mt_fail(u3_sleep_parse("1.a", &ts) == -1);
+    mt_fail(u3_sleep_parse("a", &ts) == -1);
+    mt_ferr(u3_sleep_parse(
+        "1000000000000000000000000000000000000000000000000000000000000000000",
+        &ts), EINVAL);
+}
+
+
+#if HAVE_SYS_TIMERFD_H
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_invalid(void)
+{
+    struct sleep_test_timer  t;
+    struct timespec          delay;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(&t, 1);
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000;
+
+    mt_ferr(u3_timers_init(NULL), EINVAL);
+    mt_ferr(u3_timers_run(NULL), EINVAL);
+    mt_ferr(u3_timer_add(NULL, &t.timer, &delay, timer_fn, &t), EINVAL);
+    mt_ferr(u3_timer_add(&timers, NULL, &delay, timer_fn, &t), EINVAL);
+    mt_ferr(u3_timer_add(&timers, &t.timer, NULL, timer_fn, &t), EINVAL);
+    mt_ferr(u3_timer_add(&timers, &t.timer, &delay, NULL, &t), EINVAL);
+    delay.tv_sec = -1;
+    mt_ferr(u3_timer_add(&timers, &t.timer, &delay, timer_fn, &t), EINVAL);
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000000000l;
+    mt_ferr(u3_timer_add(&timers, &t.timer, &delay, timer_fn, &t), EINVAL);
+    mt_ferr(u3_timer_cancel(NULL, &t.timer), EINVAL);
+    mt_ferr(u3_timer_cancel(&timers, NULL), EINVAL);
+    mt_ferr(u3_timer_cancel(&timers, &t.timer), ENOENT);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_order(void)
+{
+    struct sleep_test_timer  t[5];
+    static const long        delays[5] = { 30, 10, 0, 20, 10 };
+    int                      i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(t, 5);
+
+    for (i = 0; i != 5; ++i)
+    {
+        mt_fok(timer_add(&t[i], delays[i]));
+    }
+
+    mt_fail(timers_wait(5, 1000) == 5);
+
+    for (i = 0; i != 5; ++i)
+    {
+        timer_check(&t[i]);
+    }
+
+    mt_fail(t[2].order == 0);
+    mt_fail(t[1].order < t[3].order);
+    mt_fail(t[4].order < t[3].order);
+    mt_fail(t[3].order < t[0].order);
+
+    /* nothing left, run does not expire anything
+     */
+
+    mt_fail(u3_timers_run(&timers) == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_cancel(void)
+{
+    struct sleep_test_timer  t[3];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(t, 3);
+    mt_fok(timer_add(&t[0], 5));
+    mt_fok(timer_add(&t[1], 10));
+    mt_fok(timer_add(&t[2], 15));
+    mt_fok(u3_timer_cancel(&timers, &t[1].timer));
+    mt_ferr(u3_timer_cancel(&timers, &t[1].timer), ENOENT);
+
+    mt_fail(timers_wait(2, 1000) == 2);
+    timer_check(&t[0]);
+    timer_check(&t[2]);
+    mt_fail(t[1].nfired == 0);
+
+    /* expired timer is not pending anymore
+     */
+
+    mt_ferr(u3_timer_cancel(&timers, &t[0].timer), ENOENT);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_reschedule(void)
+{
+    struct sleep_test_timer  t;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(&t, 1);
+    mt_fok(timer_add(&t, 3600 * 1000l));
+    mt_fok(timer_add(&t, 5));
+    mt_fail(timers_wait(1, 1000) == 1);
+    timer_check(&t);
+
+    /* make sure timer did not stay in wheel with old delay
+     */
+
+    mt_ferr(u3_timer_cancel(&timers, &t.timer), ENOENT);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_readd(void)
+{
+    struct sleep_test_timer  t;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(&t, 1);
+    t.readd = 4;
+    mt_fok(timer_add(&t, 2));
+    mt_fail(timers_wait(5, 1000) == 5);
+    mt_fail(t.nfired == 5);
+    mt_fail(t.readd == 0);
+    mt_ferr(u3_timer_cancel(&timers, &t.timer), ENOENT);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_cancel_from_fn(void)
+{
+    struct sleep_test_timer  t[3];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* all timers expire in the same tick, first of two cancels the
+     * other, which by then is already taken out of the wheel, and
+     * third one adds itself again
+     */
+
+    timer_init(t, 3);
+    mt_fok(timer_add(&t[1], 5));
+    mt_fok(timer_add(&t[0], 5));
+    mt_fok(timer_add(&t[2], 5));
+    t[0].cancel = &t[1];
+    t[1].cancel = &t[0];
+    t[2].readd = 1;
+
+    mt_fail(timers_wait(4, 100) == 3);
+    mt_fail(t[0].nfired + t[1].nfired == 1);
+    mt_fail(t[2].nfired == 2);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_cascade(void)
+{
+    struct sleep_test_timer  t[3];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* timers longer than 64 ticks start on higher levels, and are
+     * moved down, they still must not expire too early
+     */
+
+    timer_init(t, 3);
+    mt_fok(timer_add(&t[0], 70));
+    mt_fok(timer_add(&t[1], 130));
+    mt_fok(timer_add(&t[2], 64));
+    mt_fail(timers_wait(3, 2000) == 3);
+    timer_check(&t[0]);
+    timer_check(&t[1]);
+    timer_check(&t[2]);
+    mt_fail(t[2].order == 0);
+    mt_fail(t[0].order == 1);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_far(void)
+{
+    struct sleep_test_timer  t[2];
+    struct timespec          delay;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    timer_init(t, 2);
+    mt_fok(timer_add(&t[0], 3600 * 1000l));
+    delay.tv_sec = 1000000000l;
+    delay.tv_nsec = 0;
+    mt_fok(u3_timer_add(&timers, &t[1].timer, &delay, timer_fn, &t[1]));
+    mt_fail(u3_timers_run(&timers) == 0);
+    mt_fok(u3_timer_cancel(&timers, &t[0].timer));
+    mt_fok(u3_timer_cancel(&timers, &t[1].timer));
+    mt_fail(u3_timers_run(&timers) == 0);
+    mt_fail(nfired == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void sleep_lib_timers_many(void)
+{
+    struct sleep_test_timer  *t;
+    int                       i;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    t = malloc(SLEEP_TEST_MANY * sizeof(*t));
+    mt_assert(t != NULL);
+    timer_init(t, SLEEP_TEST_MANY);
+
+    for (i = 0; i != SLEEP_TEST_MANY; ++i)
+    {
+        mt_fok(timer_add(&t[i], (i * 7919l) % 100));
+    }
+
+    /* cancel every third timer, none of them can expire
+     */
+
+    for (i = 0; i < SLEEP_TEST_MANY; i += 3)
+    {
+        mt_fok(u3_timer_cancel(&timers, &t[i].timer));
+    }
+
+    mt_fail(timers_wait(SLEEP_TEST_MANY - (SLEEP_TEST_MANY + 2) / 3, 2000) ==
+        SLEEP_TEST_MANY - (SLEEP_TEST_MANY + 2) / 3);
+
+    for (i = 0; i != SLEEP_TEST_MANY; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            mt_fail(t[i].nfired == 0);
+            continue;
+        }
+
+        timer_check(&t[i]);
+    }
+
+    free(t);
+}
+
+#endif /* HAVE_SYS_TIMERFD_H */
+
+
+/* ==========================================================================
+                                              _
+                           ____ ___   ____ _ (_)____
+                          / __ `__ \ / __ `// // __ \
+                         / / / / / // /_/ // // / / /
+                        /_/ /_/ /_/ \__,_//_//_/ /_/
+
+   ========================================================================== */
+
+
+int main(void)
+{
+    mt_run(sleep_lib_parse);
+
+#if HAVE_SYS_TIMERFD_H
+
+    mt_prepare_test = prepare_test;
+    mt_cleanup_test = cleanup_test;
+
+    mt_run(sleep_lib_timers_invalid);
+    mt_run(sleep_lib_timers_order);
+    mt_run(sleep_lib_timers_cancel);
+    mt_run(sleep_lib_timers_reschedule);
+    mt_run(sleep_lib_timers_readd);
+    mt_run(sleep_lib_timers_cancel_from_fn);
+    mt_run(sleep_lib_timers_cascade);
+    mt_run(sleep_lib_timers_far);
+    mt_run(sleep_lib_timers_many);
+
+#endif /* HAVE_SYS_TIMERFD_H */
+
+    mt_return();
+}
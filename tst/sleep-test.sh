@@ -9,6 +9,7 @@
 
 sleep="../src/sleep"
 stderr=sleep-test-stderr
+stdout=sleep-test-stdout
 
 
 ## ==========================================================================
@@ -24,6 +25,7 @@ stderr=sleep-test-stderr
 mt_cleanup_test()
 {
     rm -f ${stderr}
+    rm -f ${stdout}
 }
 
 
@@ -163,6 +165,120 @@ sleep_sh_fract_max()
     ${sleep} 1234.999999999 2>${stderr}
     mt_fail "grep \"sleep for: 1234.999999999\" ${stderr} >/dev/null 2>&1"
 }
+sleep_sh_precise()
+{
+    ${sleep} -p 2.4 2>${stderr}
+    mt_fail "grep \"sleep for: 2.400000000, precise\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_precise_no_time()
+{
+    ${sleep} -p 2>${stderr}
+    mt_fail "grep \"wrong number of arguments passed\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_precise_after_time()
+{
+    ${sleep} 5 -p 2>${stderr}
+    mt_fail "grep \"wrong number of arguments passed\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_precise_negative_number()
+{
+    ${sleep} -p -5 2>${stderr}
+    mt_fail "grep \"negative seconds passed: '-5'\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_every()
+{
+    ${sleep} --every 0.05 --count 5 >${stdout} 2>${stderr}
+    mt_fail "[ \"$(cat ${stdout} | tr '\n' ' ')\" = \"1 2 3 4 5 \" ]"
+}
+sleep_sh_every_precise()
+{
+    ${sleep} -p --every=0.05 --count=3 >${stdout} 2>${stderr}
+    mt_fail "[ \"$(cat ${stdout} | tr '\n' ' ')\" = \"1 2 3 \" ]"
+}
+sleep_sh_every_missed()
+{
+    ${sleep} --every 0.01 --count 30 >${stdout} 2>${stderr} &
+    pid=$!
+    sleep 0.05
+    kill -STOP ${pid}
+    sleep 0.1
+    kill -CONT ${pid}
+    wait ${pid}
+    mt_fail "grep \"missed [0-9]* ticks\" ${stderr} >/dev/null 2>&1"
+    mt_fail "[ \"$(tail -n1 ${stdout})\" = \"30\" ]"
+    mt_fail "[ $(wc -l < ${stdout}) -lt 30 ]"
+}
+sleep_sh_every_zero()
+{
+    ${sleep} --every 0.0 2>${stderr}
+    mt_fail "grep \"interval cannot be 0\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_every_no_interval()
+{
+    ${sleep} --every 2>${stderr}
+    mt_fail "grep \"option --every requires an argument\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_every_with_time()
+{
+    ${sleep} --every 1 5 2>${stderr}
+    mt_fail "grep \"wrong number of arguments passed\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_every_invalid_interval()
+{
+    ${sleep} --every 1.five 2>${stderr}
+    mt_fail "grep \"error parsing fractions of seconds part of argument\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_count_without_every()
+{
+    ${sleep} --count 3 5 2>${stderr}
+    mt_fail "grep \"count can only be used with --every\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_count_zero()
+{
+    ${sleep} --every 1 --count 0 2>${stderr}
+    mt_fail "grep \"count must be bigger than 0\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_count_not_a_number()
+{
+    ${sleep} --every 1 --count three 2>${stderr}
+    mt_fail "grep \"invalid number passed: 'three'\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_stats()
+{
+    ${sleep} --stats --count 20 0.001 >${stdout} 2>${stderr}
+    mt_fail "grep \"samples.............: 20\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"requested...........: 1000.000 us\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"timer slack.........: \" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"overshoot p50.......: [0-9]*\\.[0-9]* us\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"overshoot p99.......: [0-9]*\\.[0-9]* us\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"overshoot max.......: [0-9]*\\.[0-9]* us\" ${stdout} >/dev/null 2>&1"
+    total=$(sed -n 's/.*| \([0-9]*\) (.*/\1/p' ${stdout} | \
+        awk '{ s += $1 } END { print s }')
+    mt_fail "[ \"${total}\" = \"20\" ]"
+}
+sleep_sh_stats_precise()
+{
+    ${sleep} -p --stats --count=5 0.002 >${stdout} 2>${stderr}
+    mt_fail "grep \"samples.............: 5\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"requested...........: 2000.000 us\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"overshoot min.......: [0-9]\" ${stdout} >/dev/null 2>&1"
+}
+sleep_sh_stats_default_count()
+{
+    ${sleep} --stats 0.001 >${stdout} 2>${stderr}
+    mt_fail "grep \"samples.............: 1\\$\" ${stdout} >/dev/null 2>&1"
+    mt_fail "grep \"| 1 (100.0%)\" ${stdout} >/dev/null 2>&1"
+}
+sleep_sh_stats_with_every()
+{
+    ${sleep} --stats --every 1 2>${stderr}
+    mt_fail "grep \"stats cannot be used with --every\" ${stderr} >/dev/null 2>&1"
+}
+sleep_sh_stats_too_long()
+{
+    ${sleep} --stats 3600 2>${stderr}
+    mt_fail "grep \"time is too long for stats\" ${stderr} >/dev/null 2>&1"
+}
 
 ## ==========================================================================
 #                __               __
@@ -193,4 +309,23 @@ mt_run sleep_sh_fract_missing
 mt_run sleep_sh_fract_one
 mt_run sleep_sh_fract_five
 mt_run sleep_sh_fract_max
+mt_run sleep_sh_precise
+mt_run sleep_sh_precise_no_time
+mt_run sleep_sh_precise_after_time
+mt_run sleep_sh_precise_negative_number
+mt_run sleep_sh_every
+mt_run sleep_sh_every_precise
+mt_run sleep_sh_every_missed
+mt_run sleep_sh_every_zero
+mt_run sleep_sh_every_no_interval
+mt_run sleep_sh_every_with_time
+mt_run sleep_sh_every_invalid_interval
+mt_run sleep_sh_count_without_every
+mt_run sleep_sh_count_zero
+mt_run sleep_sh_count_not_a_number
+mt_run sleep_sh_stats
+mt_run sleep_sh_stats_precise
+mt_run sleep_sh_stats_default_count
+mt_run sleep_sh_stats_with_every
+mt_run sleep_sh_stats_too_long
 mt_return
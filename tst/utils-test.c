@@ -0,0 +1,382 @@
+/* ==========================================================================
+    Licensed under BSD 2clause license See LICENSE file for more information
+    Author: Michał Łyszczek <michal.lyszczek@bofc.pl>
+   ========================================================================== */
+
+
+/* ==========================================================================
+                   _               __            __
+                  (_)____   _____ / /__  __ ____/ /___   _____
+                 / // __ \ / ___// // / / // __  // _ \ / ___/
+                / // / / // /__ / // /_/ // /_/ //  __/(__  )
+               /_//_/ /_/ \___//_/ \__,_/ \__,_/ \___//____/
+
+   ========================================================================== */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mtest.h"
+#include "std-redirects.h"
+#include "utils.h"
+
+
+/* ==========================================================================
+                         __       ____ _
+                    ____/ /___   / __/(_)____   ___   _____
+                   / __  // _ \ / /_ / // __ \ / _ \ / ___/
+                  / /_/ //  __// __// // / / //  __/(__  )
+                  \__,_/ \___//_/  /_//_/ /_/ \___//____/
+
+   ========================================================================== */
+
+
+mt_defs();
+
+#define UTILS_TEST_STDERR "./utils-test-stderr"
+
+
+/* ==========================================================================
+               ____                     __   _
+              / __/__  __ ____   _____ / /_ (_)____   ____   _____
+             / /_ / / / // __ \ / ___// __// // __ \ / __ \ / ___/
+            / __// /_/ // / / // /__ / /_ / // /_/ // / / /(__  )
+           /_/   \__,_//_/ /_/ \___/ \__//_/ \____//_/ /_//____/
+
+   ========================================================================== */
+
+
+/* ==========================================================================
+    Parses nul terminated 's' with 'flags', returns what parser returned.
+   ========================================================================== */
+
+
+static int parse
+(
+    const char  *s,
+    int          flags,
+    long        *n
+)
+{
+    return u3u_parse_number(s, strlen(s), flags, n);
+}
+
+
+/* ==========================================================================
+                           __               __
+                          / /_ ___   _____ / /_ _____
+                         / __// _ \ / ___// __// ___/
+                        / /_ /  __/(__  )/ /_ (__  )
+                        \__/ \___//____/ \__//____/
+
+   ========================================================================== */
+
+
+static void utils_parse_digits(void)
+{
+    const char  *digits = "9876543210987654321";
+    char         s[32];
+    long         n;
+    long         e;
+    size_t       len;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* every length, so numbers go through 8 digit kernel and scalar
+     * tail in all combinations
+     */
+
+    for (len = 1, e = 0; len != 20 && e <= (LONG_MAX - 9) / 10; ++len)
+    {
+        e = e * 10 + (digits[len - 1] - '0');
+        memcpy(s, digits, len);
+        s[len] = '\0';
+        mt_fok(parse(s, 0, &n));
+        mt_fail(n == e);
+
+        s[0] = '-';
+        memcpy(s + 1, digits, len);
+        s[len + 1] = '\0';
+        mt_fok(parse(s, 0, &n));
+        mt_fail(n == -e);
+
+        s[0] = '+';
+        mt_fok(parse(s, 0, &n));
+        mt_fail(n == e);
+    }
+
+    mt_fok(parse("0", 0, &n));
+    mt_fail(n == 0);
+    mt_fok(parse("-0", 0, &n));
+    mt_fail(n == 0);
+    mt_fok(parse("00000000000000000000000000000042", 0, &n));
+    mt_fail(n == 42);
+    mt_fok(parse("10000000", 0, &n));
+    mt_fail(n == 10000000);
+    mt_fok(parse("99999999", 0, &n));
+    mt_fail(n == 99999999);
+
+    /* string does not have to end where number ends
+     */
+
+    mt_fok(u3u_parse_number("1234567890", 9, 0, &n));
+    mt_fail(n == 123456789);
+    mt_fok(u3u_parse_number("12x", 2, 0, &n));
+    mt_fail(n == 12);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void utils_parse_limits(void)
+{
+    char  s[32];
+    long  n;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    /* both limits are valid numbers, and end with 7 and 8, so one
+     * beyond them is easy to make
+     */
+
+    sprintf(s, "%ld", LONG_MAX);
+    mt_fok(parse(s, 0, &n));
+    mt_fail(n == LONG_MAX);
+    s[strlen(s) - 1] = '8';
+    mt_fail(parse(s, 0, &n) == U3U_NUM_RANGE);
+
+    sprintf(s, "%ld", LONG_MIN);
+    mt_fok(parse(s, 0, &n));
+    mt_fail(n == LONG_MIN);
+    s[strlen(s) - 1] = '9';
+    mt_fail(parse(s, 0, &n) == U3U_NUM_RANGE);
+
+    mt_fail(parse("18446744073709551616", 0, &n) == U3U_NUM_RANGE);
+    mt_fail(parse("99999999999999999999", 0, &n) == U3U_NUM_RANGE);
+    mt_fail(parse("-547839265897234789569236454659234538942658758", 0, &n) ==
+        U3U_NUM_RANGE);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void utils_parse_invalid(void)
+{
+    long  n;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    n = 7;
+    mt_fail(parse("", 0, &n) == U3U_NUM_EMPTY);
+    mt_fail(parse("-", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("+", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("--1", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("five", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("5O2", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse(" 5", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("5 ", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1234567x", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("12345678x", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1234567:9", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1234567/9", 0, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1K", 0, &n) == U3U_NUM_INVALID);
+
+    /* garbage wins over range, like it does for strtol()
+     */
+
+    mt_fail(parse("99999999999999999999999x", 0, &n) == U3U_NUM_INVALID);
+
+    /* number is not touched on error
+     */
+
+    mt_fail(n == 7);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void utils_parse_suffix(void)
+{
+    long  n;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    mt_fok(parse("1K", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 1000l);
+    mt_fok(parse("2M", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 2000000l);
+    mt_fok(parse("-2G", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == -2000000000l);
+    mt_fok(parse("3Ki", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 3072l);
+    mt_fok(parse("4Mi", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 4l * 1024 * 1024);
+    mt_fok(parse("0Gi", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 0);
+    mt_fok(parse("17", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 17);
+
+#if LONG_MAX > 0x7fffffffl
+    mt_fok(parse("5T", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 5000000000000l);
+    mt_fok(parse("8388607Ti", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == 8388607l << 40);
+    mt_fok(parse("-8388608Ti", U3U_NUM_SUFFIX, &n));
+    mt_fail(n == LONG_MIN);
+    mt_fail(parse("8388608Ti", U3U_NUM_SUFFIX, &n) == U3U_NUM_RANGE);
+    mt_fail(parse("9223372036854776K", U3U_NUM_SUFFIX, &n) == U3U_NUM_RANGE);
+#else
+    mt_fail(parse("5T", U3U_NUM_SUFFIX, &n) == U3U_NUM_RANGE);
+    mt_fail(parse("2Gi", U3U_NUM_SUFFIX, &n) == U3U_NUM_RANGE);
+#endif
+
+    mt_fail(parse("1k", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1KiB", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1Kb", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1i", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("K", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("-Ki", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+    mt_fail(parse("1P", U3U_NUM_SUFFIX, &n) == U3U_NUM_INVALID);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void utils_parse_numbers(void)
+{
+    const char  *buf = "  1 22\n333\t-4\r\n5K \f\v 66";
+    long         nums[8];
+    size_t       nnums;
+    size_t       end;
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    nnums = 8;
+    mt_fok(u3u_parse_numbers(buf, strlen(buf), U3U_NUM_SUFFIX, nums,
+        &nnums, &end));
+    mt_fail(nnums == 6);
+    mt_fail(end == strlen(buf));
+    mt_fail(nums[0] == 1 && nums[1] == 22 && nums[2] == 333);
+    mt_fail(nums[3] == -4 && nums[4] == 5000 && nums[5] == 66);
+
+    /* last number can continue in next chunk of stream
+     */
+
+    nnums = 8;
+    mt_fok(u3u_parse_numbers(buf, strlen(buf),
+        U3U_NUM_SUFFIX | U3U_NUM_PARTIAL, nums, &nnums, &end));
+    mt_fail(nnums == 5);
+    mt_fail(strcmp(buf + end, "66") == 0);
+
+    /* no more space for numbers, the rest can be parsed later
+     */
+
+    nnums = 2;
+    mt_fok(u3u_parse_numbers(buf, strlen(buf), U3U_NUM_SUFFIX, nums,
+        &nnums, &end));
+    mt_fail(nnums == 2);
+    mt_fail(nums[0] == 1 && nums[1] == 22);
+    nnums = 8;
+    mt_fok(u3u_parse_numbers(buf + end, strlen(buf + end), U3U_NUM_SUFFIX,
+        nums, &nnums, &end));
+    mt_fail(nnums == 4);
+    mt_fail(nums[0] == 333 && nums[3] == 66);
+
+    /* invalid number stops parsing at it
+     */
+
+    nnums = 8;
+    mt_fail(u3u_parse_numbers(buf, strlen(buf), 0, nums, &nnums, &end) ==
+        U3U_NUM_INVALID);
+    mt_fail(nnums == 4);
+    mt_fail(strncmp(buf + end, "5K", 2) == 0);
+
+    nnums = 8;
+    mt_fail(u3u_parse_numbers("1 99999999999999999999 3", 24, 0, nums,
+        &nnums, &end) == U3U_NUM_RANGE);
+    mt_fail(nnums == 1 && end == 2);
+
+    /* whitespace alone is consumed, there are no numbers in it
+     */
+
+    nnums = 8;
+    mt_fok(u3u_parse_numbers(" \n\t ", 4, U3U_NUM_PARTIAL, nums, &nnums,
+        &end));
+    mt_fail(nnums == 0 && end == 4);
+    nnums = 8;
+    mt_fok(u3u_parse_numbers("", 0, 0, nums, &nnums, &end));
+    mt_fail(nnums == 0 && end == 0);
+}
+
+
+/* ==========================================================================
+   ========================================================================== */
+
+
+static void utils_get_number(void)
+{
+    long  n;
+    char  s[32];
+    /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+
+
+    stderr_to_file(UTILS_TEST_STDERR);
+
+    /* limits are no longer mistaken for overflow
+     */
+
+    sprintf(s, "%ld", LONG_MAX);
+    mt_fok(u3u_get_number(s, &n));
+    mt_fail(n == LONG_MAX);
+    sprintf(s, "%ld", LONG_MIN);
+    mt_fok(u3u_get_number(s, &n));
+    mt_fail(n == LONG_MIN);
+
+    mt_ferr(u3u_get_number("", &n), EINVAL);
+    mt_ferr(u3u_get_number("five", &n), EINVAL);
+    mt_ferr(u3u_get_number("1K", &n), EINVAL);
+    mt_ferr(u3u_get_number("99999999999999999999", &n), ERANGE);
+
+    mt_fok(u3u_get_count("1K", &n));
+    mt_fail(n == 1000);
+    mt_ferr(u3u_get_count("1k", &n), EINVAL);
+
+    restore_stderr();
+    remove(UTILS_TEST_STDERR);
+}
+
+
+/* ==========================================================================
+                                              _
+                           ____ ___   ____ _ (_)____
+                          / __ `__ \ / __ `// // __ \
+                         / / / / / // /_/ // // / / /
+                        /_/ /_/ /_/ \__,_//_//_/ /_/
+
+   ========================================================================== */
+
+
+int main(void)
+{
+    mt_run(utils_parse_digits);
+    mt_run(utils_parse_limits);
+    mt_run(utils_parse_invalid);
+    mt_run(utils_parse_suffix);
+    mt_run(utils_parse_numbers);
+    mt_run(utils_get_number);
+
+    mt_return();
+}